@@ -183,11 +183,9 @@ void AudioEngine::queueAudioFloat(gsl::span<const float> data)
 		if (tmpShort.size() < numSamples) {
 			tmpShort.resize(numSamples);
 		}
-		for (size_t i = 0; i < data.size(); ++i) {
-			tmpShort[i] = static_cast<short>(data[i] * 32768.0f);
-		}
-
-		queueAudioBytes(gsl::as_bytes(gsl::span<short>(tmpShort)));
+		const auto dst = gsl::span<short>(tmpShort).subspan(0, numSamples);
+		mixer->convertToInt16(data, dst);
+		queueAudioBytes(gsl::as_bytes(dst));
 	}
 
 	// Int32
@@ -195,11 +193,9 @@ void AudioEngine::queueAudioFloat(gsl::span<const float> data)
 		if (tmpInt.size() < numSamples) {
 			tmpInt.resize(numSamples);
 		}
-		for (size_t i = 0; i < data.size(); ++i) {
-			tmpInt[i] = static_cast<int>(data[i] * 2147483648.0f);
-		}
-
-		queueAudioBytes(gsl::as_bytes(gsl::span<int>(tmpInt)));
+		const auto dst = gsl::span<int>(tmpInt).subspan(0, numSamples);
+		mixer->convertToInt32(data, dst);
+		queueAudioBytes(gsl::as_bytes(dst));
 	}
 }
 
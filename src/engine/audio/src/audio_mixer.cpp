@@ -2,6 +2,7 @@
 #include "halley/utils/utils.h"
 #include "audio_mixer_sse.h"
 #include "audio_mixer_avx.h"
+#include "audio_mixer_neon.h"
 
 using namespace Halley;
 
@@ -66,73 +67,75 @@ void AudioMixer::compressRange(gsl::span<AudioSamplePack> buffer)
 	}
 }
 
-#ifdef HAS_SSE
-
-#ifdef _MSC_VER
-
-#include <intrin.h>
-
-#else
+void AudioMixer::convertToInt16(gsl::span<const float> src, gsl::span<short> dst)
+{
+	Expects(dst.size() >= src.size());
+	for (size_t i = 0; i < src.size(); ++i) {
+		dst[i] = static_cast<short>(clamp(src[i] * 32768.0f, -32768.0f, 32767.0f));
+	}
+}
 
-#include <cpuid.h>
-static inline unsigned long long _xgetbv(unsigned int index){
-	unsigned int eax, edx;
-	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
-	return ((unsigned long long)edx << 32) | eax;
+void AudioMixer::convertToInt32(gsl::span<const float> src, gsl::span<int> dst)
+{
+	Expects(dst.size() >= src.size());
+	for (size_t i = 0; i < src.size(); ++i) {
+		// 2147483520 is the largest float below 2^31
+		dst[i] = static_cast<int>(clamp(src[i] * 2147483648.0f, -2147483648.0f, 2147483520.0f));
+	}
 }
-#define _XCR_XFEATURE_ENABLED_MASK 0
 
-#endif
+#ifdef HAS_AVX
 
+#ifdef _MSC_VER
+#include <intrin.h>
 #endif
 
-#ifdef HAS_AVX
-static bool hasAVX()
+static bool hasAVX2()
 {
-#ifndef _MSC_VER
-    // It's crashing on Linux :(
-    return false;
-#endif
-
-#ifdef HAS_SSE
+#ifdef _MSC_VER
 	int regs[4];
-	int i = 1;
-
-#ifdef _WIN32
-	__cpuid(regs, i);
-#else
-	asm volatile
-	("cpuid" : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
-	: "a" (i), "c" (0));
-	// ECX is set to zero for CPUID function 4
-#endif
-
-	bool osUsesXSAVE_XRSTORE = regs[2] & (1 << 27) || false;
-	bool cpuAVXSuport = regs[2] & (1 << 28) || false;
+	__cpuid(regs, 1);
+	const bool osUsesXSAVE_XRSTORE = (regs[2] & (1 << 27)) != 0;
+	const bool cpuAVXSupport = (regs[2] & (1 << 28)) != 0;
+	if (!osUsesXSAVE_XRSTORE || !cpuAVXSupport) {
+		return false;
+	}
 
-	if (osUsesXSAVE_XRSTORE && cpuAVXSuport) {
-		unsigned long long xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
-		return (xcrFeatureMask & 0x6) == 0x6;
-	} else {
+	// The OS has to save the YMM registers on context switches too
+	if ((_xgetbv(0) & 0x6) != 0x6) {
 		return false;
 	}
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
 #else
-	return false;
+	// Also checks that the OS saves the YMM registers
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
 #endif
 }
 #endif
 
 std::unique_ptr<AudioMixer> AudioMixer::makeMixer()
 {
+	auto mixers = makeAllSupportedMixers();
+	return std::move(mixers.back());
+}
+
+Vector<std::unique_ptr<AudioMixer>> AudioMixer::makeAllSupportedMixers()
+{
+	Vector<std::unique_ptr<AudioMixer>> result;
+	result.push_back(std::make_unique<AudioMixer>());
+#ifdef HAS_SSE
+	result.push_back(std::make_unique<AudioMixerSSE>());
+#endif
 #ifdef HAS_AVX
-	if (hasAVX()) {
-		return std::make_unique<AudioMixerAVX>();
-	} else {
-		return std::make_unique<AudioMixerSSE>();
+	if (hasAVX2()) {
+		result.push_back(std::make_unique<AudioMixerAVX2>());
 	}
-#elif HAS_SEE
-	return std::make_unique<AudioMixerSSE>();
-#else
-	return std::make_unique<AudioMixer>();
 #endif
+#ifdef HAS_NEON
+	result.push_back(std::make_unique<AudioMixerNEON>());
+#endif
+	return result;
 }
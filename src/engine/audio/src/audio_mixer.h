@@ -1,22 +1,28 @@
 #pragma once
 #include <gsl/span>
 #include "halley/core/api/audio_api.h"
+#include "halley/data_structures/vector.h"
 #include "audio_buffer.h"
 
+// These only say which kernels can be compiled for this architecture; whether the CPU running the game
+// supports them is checked at runtime by AudioMixer::makeMixer
 #if defined(_M_X64) || defined(__x86_64__)
 #define HAS_SSE
-#if !defined(__linux__)
 #define HAS_AVX
 #endif
-#endif
 
 #if defined(_M_IX86) || defined(__i386)
 // Might not be available, but do we really care about such old processors?
 #define HAS_SSE
 #endif
 
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define HAS_NEON
+#endif
+
 namespace Halley
 {
+	// The base class is the scalar reference implementation, the SIMD mixers override it and must produce the same results
 	class AudioMixer
 	{
 	public:
@@ -26,6 +32,17 @@ namespace Halley
 		virtual void interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> srcs);
 		virtual void concatenateChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> srcs);
 		virtual void compressRange(gsl::span<AudioSamplePack> buffer);
+
+		// Converts [-1, 1] samples to integers, saturating anything out of range. dst must be at least as long as src
+		virtual void convertToInt16(gsl::span<const float> src, gsl::span<short> dst);
+		virtual void convertToInt32(gsl::span<const float> src, gsl::span<int> dst);
+
+		virtual const char* getName() const { return "Scalar"; }
+
+		// Picks the fastest mixer supported by the CPU it's running on
 		static std::unique_ptr<AudioMixer> makeMixer();
+
+		// Every mixer the CPU supports, starting with the scalar reference
+		static Vector<std::unique_ptr<AudioMixer>> makeAllSupportedMixers();
 	};
 }
@@ -1,61 +1,128 @@
 #include "audio_mixer_avx.h"
 
 #ifdef HAS_AVX
-#include <xmmintrin.h>
-
-#ifdef __clang__
 #include <immintrin.h>
-#endif
 
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+// The kernels are compiled for AVX2 per function rather than building this file with -mavx2, as that would also
+// let inline functions from shared headers be emitted with AVX instructions, and crash on CPUs without it
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#else
+#define AVX2_KERNEL
+#endif
+
 using namespace Halley;
 
-void AudioMixerAVX::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw, float gain0, float gain1)
-{
-	gsl::span<const __m256> src(reinterpret_cast<const __m256*>(srcRaw.data()), srcRaw.size() * 2);
-	gsl::span<__m256> dst(reinterpret_cast<__m256*>(dstRaw.data()), dstRaw.size() * 2);
-	const size_t nSamples = size_t(src.size());
-
-	if (gain0 == gain1) {
-		__m256 gain = _mm256_broadcast_ss(&gain0);
-		for (size_t i = 0; i < nSamples; i += 2) {
-			dst[i] = _mm256_add_ps(dst[i], _mm256_mul_ps(src[i], gain));
-			dst[i + 1] = _mm256_add_ps(dst[i + 1], _mm256_mul_ps(src[i + 1], gain));
+namespace {
+	AVX2_KERNEL void mixAudioAVX2(const float* src, float* dst, size_t nSamples, float gain0, float gain1, float scale)
+	{
+		if (gain0 == gain1) {
+			const __m256 gain = _mm256_set1_ps(gain0);
+			for (size_t i = 0; i < nSamples; i += 16) {
+				_mm256_store_ps(dst + i, _mm256_add_ps(_mm256_load_ps(dst + i), _mm256_mul_ps(_mm256_load_ps(src + i), gain)));
+				_mm256_store_ps(dst + i + 8, _mm256_add_ps(_mm256_load_ps(dst + i + 8), _mm256_mul_ps(_mm256_load_ps(src + i + 8), gain)));
+			}
+		} else {
+			const __m256 gain0p = _mm256_set1_ps(gain0);
+			const __m256 gain1p = _mm256_set1_ps(gain1 - gain0);
+			const __m256 scalep = _mm256_set1_ps(scale);
+			const __m256 inc = _mm256_set1_ps(8.0f);
+			__m256 offset = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			for (size_t i = 0; i < nSamples; i += 8) {
+				const __m256 t = _mm256_mul_ps(offset, scalep);
+				const __m256 gain = _mm256_add_ps(gain0p, _mm256_mul_ps(gain1p, t));
+				offset = _mm256_add_ps(offset, inc);
+				_mm256_store_ps(dst + i, _mm256_add_ps(_mm256_load_ps(dst + i), _mm256_mul_ps(_mm256_load_ps(src + i), gain)));
+			}
 		}
-	} else {
-		const float sc = 1.0f / (dst.size() * 16);
-		const float gainDiff = gain1 - gain0;
-		const float eight = 8.0f;
-
-		__m256 gain0p = _mm256_broadcast_ss(&gain0);
-		__m256 gain1p = _mm256_broadcast_ss(&gainDiff);
-		__m256 scale = _mm256_broadcast_ss(&sc);
-		__m256 inc = _mm256_broadcast_ss(&eight);
-		__m256 offset = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
-		for (size_t i = 0; i < nSamples; ++i) {
-			__m256 t = _mm256_mul_ps(offset, scale);
-			__m256 gain = _mm256_add_ps(gain0p, _mm256_mul_ps(gain1p, t));
-			offset = _mm256_add_ps(offset, inc);
-			dst[i] = _mm256_add_ps(dst[i], _mm256_mul_ps(src[i], gain));
+	}
+
+	AVX2_KERNEL void interleaveAVX2(const float* left, const float* right, float* dst, size_t nSamples)
+	{
+		for (size_t i = 0; i < nSamples; i += 8) {
+			const __m256 l = _mm256_load_ps(left + i);
+			const __m256 r = _mm256_load_ps(right + i);
+
+			// Unpacks work within each 128-bit lane, so the lanes need swapping back into order afterwards
+			const __m256 lo = _mm256_unpacklo_ps(l, r);
+			const __m256 hi = _mm256_unpackhi_ps(l, r);
+			_mm256_store_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_store_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+	}
+
+	AVX2_KERNEL void compressRangeAVX2(float* dst, size_t nSamples)
+	{
+		const __m256 minVal = _mm256_set1_ps(-0.99995f);
+		const __m256 maxVal = _mm256_set1_ps(0.99995f);
+		for (size_t i = 0; i < nSamples; i += 8) {
+			_mm256_store_ps(dst + i, _mm256_max_ps(minVal, _mm256_min_ps(_mm256_load_ps(dst + i), maxVal)));
+		}
+	}
+
+	AVX2_KERNEL void convertToInt16AVX2(const float* src, short* dst, size_t n)
+	{
+		const __m256 scale = _mm256_set1_ps(32768.0f);
+		const __m256 minVal = _mm256_set1_ps(-32768.0f);
+		const __m256 maxVal = _mm256_set1_ps(32767.0f);
+		for (size_t i = 0; i < n; i += 16) {
+			const __m256i a = _mm256_cvttps_epi32(_mm256_max_ps(minVal, _mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), maxVal)));
+			const __m256i b = _mm256_cvttps_epi32(_mm256_max_ps(minVal, _mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), maxVal)));
+
+			// Packing is also per lane, giving a0 b0 a1 b1 in 64-bit blocks
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+		}
+	}
+
+	AVX2_KERNEL void convertToInt32AVX2(const float* src, int* dst, size_t n)
+	{
+		const __m256 scale = _mm256_set1_ps(2147483648.0f);
+		const __m256 minVal = _mm256_set1_ps(-2147483648.0f);
+		const __m256 maxVal = _mm256_set1_ps(2147483520.0f);
+		for (size_t i = 0; i < n; i += 8) {
+			const __m256 v = _mm256_max_ps(minVal, _mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), maxVal));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvttps_epi32(v));
 		}
 	}
 }
 
-void AudioMixerAVX::compressRange(gsl::span<AudioSamplePack> buffer)
+void AudioMixerAVX2::mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gain0, float gain1)
 {
-	gsl::span<__m256> dst(reinterpret_cast<__m256*>(buffer.data()), buffer.size() * 2);
-	const size_t nSamples = size_t(dst.size());
+	const float scale = 1.0f / (dst.size() * AudioSamplePack::NumSamples);
+	mixAudioAVX2(reinterpret_cast<const float*>(src.data()), reinterpret_cast<float*>(dst.data()), size_t(src.size()) * AudioSamplePack::NumSamples, gain0, gain1, scale);
+}
 
-	float val = 0.99995f;
-	__m256 minVal = { -val, -val, -val, -val, -val, -val, -val, -val };
-	__m256 maxVal = { val, val, val, val, val, val, val, val };
+void AudioMixerAVX2::interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> srcs)
+{
+	Expects(srcs.size() == 2);
+	const size_t nSamples = size_t(dst.size()) * AudioSamplePack::NumSamples / 2;
+	interleaveAVX2(reinterpret_cast<const float*>(srcs[0]->packs.data()), reinterpret_cast<const float*>(srcs[1]->packs.data()), reinterpret_cast<float*>(dst.data()), nSamples);
+}
 
-	for (size_t i = 0; i < nSamples; ++i) {
-		dst[i] = _mm256_max_ps(minVal, _mm256_min_ps(dst[i], maxVal));
-	}
+void AudioMixerAVX2::compressRange(gsl::span<AudioSamplePack> buffer)
+{
+	compressRangeAVX2(reinterpret_cast<float*>(buffer.data()), size_t(buffer.size()) * AudioSamplePack::NumSamples);
+}
+
+void AudioMixerAVX2::convertToInt16(gsl::span<const float> src, gsl::span<short> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t nVec = size_t(src.size()) & ~size_t(15);
+	convertToInt16AVX2(src.data(), dst.data(), nVec);
+	AudioMixer::convertToInt16(src.subspan(nVec), dst.subspan(nVec));
+}
+
+void AudioMixerAVX2::convertToInt32(gsl::span<const float> src, gsl::span<int> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t nVec = size_t(src.size()) & ~size_t(7);
+	convertToInt32AVX2(src.data(), dst.data(), nVec);
+	AudioMixer::convertToInt32(src.subspan(nVec), dst.subspan(nVec));
 }
 
 #endif
@@ -0,0 +1,99 @@
+#include "audio_mixer_neon.h"
+
+#ifdef HAS_NEON
+#include <arm_neon.h>
+
+using namespace Halley;
+
+void AudioMixerNEON::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw, float gain0, float gain1)
+{
+	const float* src = reinterpret_cast<const float*>(srcRaw.data());
+	float* dst = reinterpret_cast<float*>(dstRaw.data());
+	const size_t nSamples = size_t(srcRaw.size()) * AudioSamplePack::NumSamples;
+
+	// Multiply and add separately rather than with vmla/vfma, to round the same way as the scalar version
+	if (gain0 == gain1) {
+		const float32x4_t gain = vdupq_n_f32(gain0);
+		for (size_t i = 0; i < nSamples; i += 4) {
+			vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vld1q_f32(src + i), gain)));
+		}
+	} else {
+		const float32x4_t gain0p = vdupq_n_f32(gain0);
+		const float32x4_t gain1p = vdupq_n_f32(gain1 - gain0);
+		const float32x4_t scale = vdupq_n_f32(1.0f / (dstRaw.size() * AudioSamplePack::NumSamples));
+		const float32x4_t inc = vdupq_n_f32(4.0f);
+		const float offsetInit[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		float32x4_t offset = vld1q_f32(offsetInit);
+		for (size_t i = 0; i < nSamples; i += 4) {
+			const float32x4_t t = vmulq_f32(offset, scale);
+			const float32x4_t gain = vaddq_f32(gain0p, vmulq_f32(gain1p, t));
+			offset = vaddq_f32(offset, inc);
+			vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vld1q_f32(src + i), gain)));
+		}
+	}
+}
+
+void AudioMixerNEON::interleaveChannels(gsl::span<AudioSamplePack> dstBuffer, gsl::span<AudioBuffer*> srcs)
+{
+	Expects(srcs.size() == 2);
+
+	const size_t nSamples = size_t(dstBuffer.size()) * AudioSamplePack::NumSamples / 2;
+	const float* left = reinterpret_cast<const float*>(srcs[0]->packs.data());
+	const float* right = reinterpret_cast<const float*>(srcs[1]->packs.data());
+	float* dst = reinterpret_cast<float*>(dstBuffer.data());
+
+	for (size_t i = 0; i < nSamples; i += 4) {
+		float32x4x2_t lr;
+		lr.val[0] = vld1q_f32(left + i);
+		lr.val[1] = vld1q_f32(right + i);
+		vst2q_f32(dst + 2 * i, lr);
+	}
+}
+
+void AudioMixerNEON::compressRange(gsl::span<AudioSamplePack> buffer)
+{
+	float* dst = reinterpret_cast<float*>(buffer.data());
+	const size_t nSamples = size_t(buffer.size()) * AudioSamplePack::NumSamples;
+
+	const float32x4_t minVal = vdupq_n_f32(-0.99995f);
+	const float32x4_t maxVal = vdupq_n_f32(0.99995f);
+	for (size_t i = 0; i < nSamples; i += 4) {
+		vst1q_f32(dst + i, vmaxq_f32(minVal, vminq_f32(vld1q_f32(dst + i), maxVal)));
+	}
+}
+
+void AudioMixerNEON::convertToInt16(gsl::span<const float> src, gsl::span<short> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t nVec = size_t(src.size()) & ~size_t(7);
+
+	const float32x4_t scale = vdupq_n_f32(32768.0f);
+	const float32x4_t minVal = vdupq_n_f32(-32768.0f);
+	const float32x4_t maxVal = vdupq_n_f32(32767.0f);
+	for (size_t i = 0; i < nVec; i += 8) {
+		const int32x4_t a = vcvtq_s32_f32(vmaxq_f32(minVal, vminq_f32(vmulq_f32(vld1q_f32(src.data() + i), scale), maxVal)));
+		const int32x4_t b = vcvtq_s32_f32(vmaxq_f32(minVal, vminq_f32(vmulq_f32(vld1q_f32(src.data() + i + 4), scale), maxVal)));
+		vst1q_s16(dst.data() + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+
+	AudioMixer::convertToInt16(src.subspan(nVec), dst.subspan(nVec));
+}
+
+void AudioMixerNEON::convertToInt32(gsl::span<const float> src, gsl::span<int> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t nVec = size_t(src.size()) & ~size_t(3);
+
+	// NEON conversion saturates by itself, but clamping keeps the edge cases identical to the scalar version
+	const float32x4_t scale = vdupq_n_f32(2147483648.0f);
+	const float32x4_t minVal = vdupq_n_f32(-2147483648.0f);
+	const float32x4_t maxVal = vdupq_n_f32(2147483520.0f);
+	for (size_t i = 0; i < nVec; i += 4) {
+		const float32x4_t v = vmaxq_f32(minVal, vminq_f32(vmulq_f32(vld1q_f32(src.data() + i), scale), maxVal));
+		vst1q_s32(dst.data() + i, vcvtq_s32_f32(v));
+	}
+
+	AudioMixer::convertToInt32(src.subspan(nVec), dst.subspan(nVec));
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include "audio_mixer.h"
+
+#ifdef HAS_NEON
+namespace Halley
+{
+	class AudioMixerNEON final : public AudioMixer
+	{
+	public:
+		void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd) override;
+		void interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> srcs) override;
+		void compressRange(gsl::span<AudioSamplePack> buffer) override;
+		void convertToInt16(gsl::span<const float> src, gsl::span<short> dst) override;
+		void convertToInt32(gsl::span<const float> src, gsl::span<int> dst) override;
+		const char* getName() const override { return "NEON"; }
+	};
+}
+#endif
@@ -2,6 +2,7 @@
 
 #ifdef HAS_SSE
 #include <xmmintrin.h>
+#include <emmintrin.h>
 
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -24,7 +25,7 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 			dst[i + 3] = _mm_add_ps(dst[i + 3], _mm_mul_ps(src[i + 3], gain));
 		}
 	} else {
-		const float sc = 1.0f / (dst.size() * 16);
+		const float sc = 1.0f / (dstRaw.size() * AudioSamplePack::NumSamples);
 		const float gainDiff = gain1 - gain0;
 
 		__m128 gain0p = { gain0, gain0, gain0, gain0 };
@@ -41,6 +42,24 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 	}
 }
 
+void AudioMixerSSE::interleaveChannels(gsl::span<AudioSamplePack> dstBuffer, gsl::span<AudioBuffer*> srcs)
+{
+	Expects(srcs.size() == 2);
+
+	// Each dst pack takes half a pack from each channel
+	const size_t nSamples = size_t(dstBuffer.size()) * AudioSamplePack::NumSamples / 2;
+	const float* left = reinterpret_cast<const float*>(srcs[0]->packs.data());
+	const float* right = reinterpret_cast<const float*>(srcs[1]->packs.data());
+	float* dst = reinterpret_cast<float*>(dstBuffer.data());
+
+	for (size_t i = 0; i < nSamples; i += 4) {
+		const __m128 l = _mm_load_ps(left + i);
+		const __m128 r = _mm_load_ps(right + i);
+		_mm_store_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+		_mm_store_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+	}
+}
+
 void AudioMixerSSE::compressRange(gsl::span<AudioSamplePack> buffer)
 {
 	gsl::span<__m128> dst(reinterpret_cast<__m128*>(buffer.data()), buffer.size() * 4);
@@ -55,4 +74,43 @@ void AudioMixerSSE::compressRange(gsl::span<AudioSamplePack> buffer)
 	}
 }
 
+void AudioMixerSSE::convertToInt16(gsl::span<const float> src, gsl::span<short> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t n = size_t(src.size());
+	const size_t nVec = n & ~size_t(7);
+
+	// Clamped so that huge values don't wrap around on conversion
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 minVal = _mm_set1_ps(-32768.0f);
+	const __m128 maxVal = _mm_set1_ps(32767.0f);
+	for (size_t i = 0; i < nVec; i += 8) {
+		const __m128 va = _mm_max_ps(minVal, _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src.data() + i), scale), maxVal));
+		const __m128 vb = _mm_max_ps(minVal, _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src.data() + i + 4), scale), maxVal));
+		const __m128i a = _mm_cvttps_epi32(va);
+		const __m128i b = _mm_cvttps_epi32(vb);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst.data() + i), _mm_packs_epi32(a, b));
+	}
+
+	AudioMixer::convertToInt16(src.subspan(nVec), dst.subspan(nVec));
+}
+
+void AudioMixerSSE::convertToInt32(gsl::span<const float> src, gsl::span<int> dst)
+{
+	Expects(dst.size() >= src.size());
+	const size_t n = size_t(src.size());
+	const size_t nVec = n & ~size_t(3);
+
+	// Out of range conversions give INT_MIN, so clamp first
+	const __m128 scale = _mm_set1_ps(2147483648.0f);
+	const __m128 minVal = _mm_set1_ps(-2147483648.0f);
+	const __m128 maxVal = _mm_set1_ps(2147483520.0f);
+	for (size_t i = 0; i < nVec; i += 4) {
+		const __m128 v = _mm_max_ps(minVal, _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src.data() + i), scale), maxVal));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst.data() + i), _mm_cvttps_epi32(v));
+	}
+
+	AudioMixer::convertToInt32(src.subspan(nVec), dst.subspan(nVec));
+}
+
 #endif
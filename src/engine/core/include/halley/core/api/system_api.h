@@ -32,6 +32,9 @@ namespace Halley
 		virtual Path getUnpackedAssetsPath(const Path& gamePath) const = 0;
 
 		virtual std::unique_ptr<ResourceDataReader> getDataReader(String path, int64_t start = 0, int64_t end = -1) = 0;
+
+		// For large files that are read at random, such as asset packs; platforms that can map files into memory should do so here
+		virtual std::unique_ptr<ResourceDataReader> getMappedDataReader(String path) { return getDataReader(std::move(path)); }
 		
 		virtual std::unique_ptr<GLContext> createGLContext() = 0;
 
@@ -23,6 +23,7 @@ namespace Halley
 	class RenderTarget;
 	class Environment;
 	class DevConClient;
+	class Executor;
 
 	class Core final : public CoreAPIInternal, public IMainLoopable, public ILoggerSink
 	{
@@ -93,6 +94,7 @@ namespace Halley
 		std::unique_ptr<Game> game;
 		std::unique_ptr<HalleyAPI> api;
 		std::unique_ptr<Resources> resources;
+		std::unique_ptr<Executor> mainThreadExecutor;
 
 		std::unique_ptr<Painter> painter;
 		std::unique_ptr<Camera> camera;
@@ -194,6 +194,7 @@ namespace Halley
 		MaterialPass& getPass(int n);
 
 		const String& getName() const;
+		uint32_t getId() const { return id; } // Unique to each definition, and unlike its address, doesn't depend on where it was allocated
 		size_t getVertexSize() const;
 		size_t getVertexStride() const;
 		size_t getVertexPosOffset() const;
@@ -214,6 +215,7 @@ namespace Halley
 	private:
 		VideoAPI* api = nullptr;
 
+		uint32_t id = 0;
 		String name;
 		Vector<MaterialPass> passes;
 		Vector<MaterialTexture> textures;
@@ -42,6 +42,14 @@ namespace Halley
 
 		void flush();
 
+		// In deferred mode, draws are recorded rather than submitted, and on flush the draws within each deferred layer are
+		// stably sorted by material, so that compatible ones merge into the same draw call
+		// Only put draws in the same layer if their relative order doesn't matter (e.g. they don't overlap), and don't
+		// modify a material between drawing with it and the next flush
+		void setDeferred(bool deferred);
+		bool isDeferred() const { return deferred; }
+		void setDeferredLayer(int layer); // Draws are never reordered across layers, or across clip changes
+
 		Rect4i getViewPort() const { return viewPort; }
 		const Camera& getCurrentCamera() const { return camera; }
 		Rect4f getWorldViewAABB() const;
@@ -64,6 +72,9 @@ namespace Halley
 		// vertPosOffset is the offset, in bytes, from the start of each vertex's data, to a Vector2f which will be filled with the vertex's position in 0-1 space.
 		void drawSprites(const std::shared_ptr<Material>& material, size_t numSprites, const void* vertexData);
 
+		// Does drawSprites' expansion of a single sprite into its four quad vertices, for building vertex data off the render thread
+		static void makeSpriteQuad(const void* spriteVertex, size_t vertexSize, size_t vertexStride, size_t vertPosOffset, void* dst);
+
 		// Draw one sliced sprite. Slices -> x = left, y = top, z = right, w = bottom, in [0..1] space relative to the texture
 		void drawSlicedSprite(const std::shared_ptr<Material>& material, Vector2f scale, Vector4f slices, const void* vertexData);
 
@@ -93,6 +104,11 @@ namespace Halley
 		size_t getPrevVertices() const { return prevVertices; }
 		size_t getPrevTriangles() const { return prevTriangles; }
 
+		size_t getNumDeferredDraws() const { return nDeferredDraws; }
+		size_t getNumDrawCallsSaved() const { return nDrawCallsSaved; } // Compared to submitting the deferred draws in recorded order
+		size_t getPrevDeferredDraws() const { return prevDeferredDraws; }
+		size_t getPrevDrawCallsSaved() const { return prevDrawCallsSaved; }
+
 		void setLogging(bool logging);
 
 	protected:
@@ -138,6 +154,32 @@ namespace Halley
 		size_t prevTriangles = 0;
 		bool logging = true;
 
+		struct DeferredDraw {
+			uint64_t sortKey;
+			std::shared_ptr<Material> material;
+			std::optional<Rect4i> clip;
+			size_t vertexOffset;
+			size_t numVertices;
+			size_t indexOffset;
+			size_t numIndices;
+			bool standardQuadsOnly;
+		};
+
+		bool deferred = false;
+		int deferredLayer = 0;
+		uint32_t deferredWindow = 0;
+		std::optional<Rect4i> deferredClip;
+		const Material* lastDeferredMaterial = nullptr;
+		size_t deferredBatchesInOrder = 0;
+		Vector<DeferredDraw> deferredDraws;
+		Vector<uint32_t> deferredOrder;
+		Vector<char> deferredVertices;
+		Vector<IndexType> deferredIndices;
+		size_t nDeferredDraws = 0;
+		size_t nDrawCallsSaved = 0;
+		size_t prevDeferredDraws = 0;
+		size_t prevDrawCallsSaved = 0;
+
 		Vector<IndexType> stdQuadIndexCache;
 		std::optional<Rect4i> curClip;
 		std::optional<Rect4i> pendingClip;
@@ -156,6 +198,8 @@ namespace Halley
 		void makeSpaceForPendingVertices(size_t numBytes);
 		void makeSpaceForPendingIndices(size_t numIndices);
 		PainterVertexData addDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly);
+		PainterVertexData addDeferredDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly);
+		void flushDeferred();
 
 		IndexType* getStandardQuadIndices(size_t numQuads);
 		void generateQuadIndicesOffset(IndexType firstVertex, IndexType lineStride, IndexType* target);
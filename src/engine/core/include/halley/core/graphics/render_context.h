@@ -11,6 +11,9 @@ namespace Halley
 		friend class Core;
 
 	public:
+		// Core makes the context for each frame; this is for rendering outside of it, e.g. in tools and tests
+		RenderContext(Painter& painter, const Camera& camera, RenderTarget& renderTarget);
+
 		void bind(const std::function<void(Painter&)>& f)
 		{
 			pushContext();
@@ -38,7 +41,6 @@ namespace Halley
 
 		RenderContext* restore = nullptr;
 
-		RenderContext(Painter& painter, const Camera& camera, RenderTarget& renderTarget);
 		void setActive();
 		void setInactive();
 		void pushContext();
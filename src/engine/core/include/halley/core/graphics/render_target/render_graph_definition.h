@@ -78,6 +78,7 @@ namespace Halley {
     	
         static std::unique_ptr<RenderGraphDefinition> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::RenderGraphDefinition; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
     	void reload(Resource&& resource) override;
 
 		void serialize(Serializer& s) const;
@@ -46,6 +46,7 @@ namespace Halley
 		static std::unique_ptr<ShaderFile> loadResource(ResourceLoader& loader);
 		void reload(Resource&& resource) override;
 		constexpr static AssetType getAssetType() { return AssetType::Shader; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
@@ -119,6 +119,7 @@ namespace Halley
 
 		static std::unique_ptr<Animation> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Animation; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		void reload(Resource&& resource) override;
 
 		const String& getName() const { return name; }
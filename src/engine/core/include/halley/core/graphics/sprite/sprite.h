@@ -163,6 +163,8 @@ namespace Halley
 		bool operator!=(const Sprite& other) const;
 
 	private:
+		friend class SpritePainter;
+
 		SpriteVertexAttrib vertexAttrib;
 		std::shared_ptr<Material> material;
 
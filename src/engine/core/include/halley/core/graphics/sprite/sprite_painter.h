@@ -12,6 +12,7 @@ namespace Halley
 	class String;
 	class Sprite;
 	class Painter;
+	class ExecutionQueue;
 
 	enum class SpritePainterEntryType
 	{
@@ -32,6 +33,8 @@ namespace Halley
 		SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, size_t count, int mask, int layer, float tieBreaker, size_t insertOrder, std::optional<Rect4f> clip);
 
 		bool operator<(const SpritePainterEntry& o) const;
+		uint64_t getSortKey() const; // Orders like operator<, except for insertOrder
+		size_t getInsertOrder() const;
 		SpritePainterEntryType getType() const;
 		gsl::span<const Sprite> getSprites() const;
 		gsl::span<const TextRenderer> getTexts() const;
@@ -68,14 +71,46 @@ namespace Halley
 		
 		void draw(int mask, Painter& painter);
 
+		// Culling and vertex generation for sprites is split across this queue's threads (defaults to ExecutionQueue::getDefault(), or none without Executors)
+		void setExecutionQueue(ExecutionQueue* queue);
+
 	private:
+		// Sprites that can't go into a batch (sliced or clipped) are kept as a batch of zero, and drawn by themselves
+		struct SpriteBatch {
+			const Sprite* sprite;
+			const std::optional<Rect4f>* clip;
+			size_t numSprites;
+		};
+
+		struct SpriteChunk {
+			Vector<char> vertices;
+			Vector<SpriteBatch> batches;
+		};
+
+		struct SpriteRunItem {
+			const Sprite* sprite;
+			const std::optional<Rect4f>* clip;
+		};
+
 		Vector<SpritePainterEntry> sprites;
 		Vector<Sprite> cachedSprites;
 		Vector<TextRenderer> cachedText;
 		Vector<SpritePainterEntry::Callback> callbacks;
 		bool dirty = false;
 
-		void draw(gsl::span<const Sprite> sprite, Painter& painter, Rect4f view, const std::optional<Rect4f>& clip) const;
+		ExecutionQueue* queue = nullptr;
+		Vector<std::pair<uint64_t, uint32_t>> sortKeys;
+		Vector<std::pair<uint64_t, uint32_t>> sortKeysTmp;
+		Vector<SpritePainterEntry> sortedSprites;
+		Vector<SpriteRunItem> spriteRun;
+		Vector<SpriteChunk> chunks;
+
+		void sortEntries();
+		void addToSpriteRun(gsl::span<const Sprite> sprites, const std::optional<Rect4f>& clip);
+		void drawSpriteRun(Painter& painter, Rect4f view);
+		static void buildChunk(gsl::span<const SpriteRunItem> items, SpriteChunk& chunk, Rect4f view);
+		static void drawChunk(const SpriteChunk& chunk, Painter& painter);
+
 		void draw(gsl::span<const TextRenderer> text, Painter& painter, Rect4f view, const std::optional<Rect4f>& clip) const;
 		void draw(const SpritePainterEntry::Callback& callback, Painter& painter, const std::optional<Rect4f>& clip) const;
 	};
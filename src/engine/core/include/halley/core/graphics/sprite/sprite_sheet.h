@@ -103,6 +103,7 @@ namespace Halley
 
 		static std::unique_ptr<SpriteSheet> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::SpriteSheet; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		void reload(Resource&& resource) override;
 
 		void serialize(Serializer& s) const;
@@ -142,6 +143,7 @@ namespace Halley
 		const String& getDefaultMaterialName() const;
 
 		constexpr static AssetType getAssetType() { return AssetType::Sprite; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		static std::unique_ptr<SpriteResource> loadResource(ResourceLoader& loader);
 		void reload(Resource&& resource) override;
 
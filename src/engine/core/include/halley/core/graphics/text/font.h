@@ -5,11 +5,13 @@
 #include <unordered_map>
 #include "halley/core/graphics/texture.h"
 #include "halley/core/graphics/sprite/sprite.h"
+#include "font_atlas.h"
 
 namespace Halley
 {
 	class Deserializer;
 	class Serializer;
+	class VideoAPI;
 
 	class Font final : public Resource
 	{
@@ -23,6 +25,7 @@ namespace Halley
 			Vector2f horizontalBearing;
 			Vector2f verticalBearing;
 			Vector2f advance;
+			int atlasPage = 0; // Only used by dynamic fonts, -1 if it was evicted
 			
 			Glyph();
 			Glyph(const Glyph& other) = default;
@@ -40,6 +43,11 @@ namespace Halley
 		Font(String name, String imageName, float ascender, float height, float sizePt, float replacementScale, Vector2i imageSize);
 		Font(String name, String imageName, float ascender, float height, float sizePt, float replacementScale, Vector2i imageSize, float distanceFieldSmoothRadius, std::vector<String> fallback);
 
+		// Creates a distance field font whose glyphs are only rasterized the first time they're needed, into a paged atlas
+		// Glyphs on pages that haven't been drawn for a while get evicted when space runs out, and rasterized again if needed
+		// Only use it from the thread that renders, as atlas pages are uploaded when text using them is drawn
+		static std::shared_ptr<Font> makeDynamic(String name, std::shared_ptr<GlyphRasterizer> rasterizer, VideoAPI& video, Resources& resources, FontAtlas::Settings settings = {}, std::vector<String> fallback = {}, float replacementScale = 1.0f);
+
 		static std::unique_ptr<Font> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Font; }
 		void reload(Resource&& resource) override;
@@ -57,10 +65,18 @@ namespace Halley
 		float getReplacementScale() const;
 		String getName() const;
 		bool isDistanceField() const;
+		bool isDynamic() const;
 
 		void addGlyph(const Glyph& glyph);
 
 		std::shared_ptr<Material> getMaterial() const;
+		std::shared_ptr<Material> getMaterial(const Glyph& glyph) const;
+
+		// For dynamic fonts, changes (across this font and its fallbacks) whenever glyphs may have moved in the atlas
+		uint32_t getAtlasGeneration() const;
+		void prepareAtlasPage(int page) const; // Call before drawing glyphs from a page of a dynamic font
+
+		size_t getMemoryUsage() const override;
 
 		void serialize(Serializer& deserializer) const;
 		void deserialize(Deserializer& deserializer);
@@ -81,6 +97,12 @@ namespace Halley
 		std::vector<String> fallback;
 
 		std::shared_ptr<Material> material;
-		std::unordered_map<int, Glyph> glyphs;
+		mutable std::unordered_map<int, Glyph> glyphs;
+
+		std::shared_ptr<GlyphRasterizer> rasterizer;
+		std::unique_ptr<FontAtlas> atlas;
+
+		bool hasGlyphHere(int code) const;
+		const Glyph& getDynamicGlyph(int code) const; // Not thread safe, as references to glyphs are only valid until the next one is rasterized
 	};
 }
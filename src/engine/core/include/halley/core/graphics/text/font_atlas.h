@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include "halley/maths/rect.h"
+#include "halley/maths/vector2.h"
+#include "halley/data_structures/vector.h"
+
+namespace Halley
+{
+	class Image;
+	class Material;
+	class MaterialDefinition;
+	class Texture;
+	class VideoAPI;
+
+	// Produces the glyphs of a dynamic Font the first time they're needed
+	// See FontFaceGlyphRasterizer in halley-tools for one backed by FreeType
+	class GlyphRasterizer
+	{
+	public:
+		struct Metrics
+		{
+			float ascender = 0;
+			float height = 0;
+			float sizePoints = 0;
+			float smoothRadius = 0;
+		};
+
+		struct Glyph
+		{
+			std::unique_ptr<Image> image; // Single channel distance field, including its padding
+			Vector2f horizontalBearing;
+			Vector2f verticalBearing;
+			Vector2f advance;
+		};
+
+		virtual ~GlyphRasterizer() = default;
+
+		virtual Metrics getMetrics() const = 0;
+		virtual bool hasGlyph(int charcode) const = 0;
+		virtual Glyph rasterize(int charcode) = 0;
+	};
+
+	// Paged texture atlas for glyphs rasterized at runtime
+	// Glyphs are packed into shelves on fixed size pages; once there's no room left, the least recently drawn page is wiped and reused
+	// Pages are only uploaded when drawn after changing, so adding many glyphs in one frame costs one upload per page
+	class FontAtlas
+	{
+	public:
+		struct Settings
+		{
+			Vector2i pageSize = Vector2i(512, 512);
+			int maxPages = 4; // Only exceeded if every page has been used in the current frame
+			int padding = 1;
+		};
+
+		struct Location
+		{
+			int page;
+			Rect4f area; // In texture coordinates
+		};
+
+		using EvictCallback = std::function<void(int page)>;
+
+		FontAtlas(VideoAPI& video, std::shared_ptr<const MaterialDefinition> materialDefinition, Settings settings);
+		~FontAtlas();
+
+		// onEvict is called before a page is wiped to make room, so anything on it can be forgotten
+		Location add(const Image& image, const EvictCallback& onEvict);
+
+		void markUsed(int page);
+		void prepareForDraw(int page); // Marks it as used, and uploads it if it has changed
+
+		const std::shared_ptr<Material>& getMaterial(int page) const;
+		size_t getNumPages() const;
+		uint32_t getGeneration() const; // Changes whenever a page is evicted
+		Vector2i getPageSize() const;
+		size_t getMemoryUsage() const;
+
+	private:
+		struct Shelf
+		{
+			int y;
+			int height;
+			int x;
+		};
+
+		struct Page
+		{
+			std::unique_ptr<Image> image;
+			std::shared_ptr<Texture> texture;
+			std::shared_ptr<Material> material;
+			Vector<Shelf> shelves;
+			uint64_t lastUsedFrame = 0;
+			bool dirty = false;
+		};
+
+		VideoAPI& video;
+		std::shared_ptr<const MaterialDefinition> materialDefinition;
+		Settings settings;
+		Vector<Page> pages;
+		uint32_t generation = 0;
+
+		std::optional<Vector2i> tryPlace(Page& page, Vector2i size);
+		void upload(Page& page);
+		int addPage();
+		std::optional<int> findPageToEvict() const;
+		void evict(int page, const EvictCallback& onEvict);
+	};
+}
@@ -77,7 +77,7 @@ namespace Halley
 
 	private:
 		std::shared_ptr<const Font> font;
-		mutable std::map<const Font*, std::shared_ptr<Material>> materials;
+		mutable std::map<std::pair<const Font*, int>, std::shared_ptr<Material>> materials; // Keyed by font and atlas page
 		StringUTF32 text;
 		SpriteFilter spriteFilter;
 		
@@ -96,12 +96,30 @@ namespace Halley
 
 		std::vector<ColourOverride> colourOverrides;
 
+		// Laid out glyphs, relative to position, so moving the text doesn't need a new layout
+		struct GlyphQuad {
+			Vector2f pos;
+			Vector2f size;
+			Vector2f pivot;
+			float scale;
+			Rect4f texRect;
+			Colour4f colour;
+			uint32_t materialIdx;
+		};
+
+		mutable Vector<GlyphQuad> glyphQuads;
+		mutable Vector<std::shared_ptr<Material>> glyphMaterials;
+		mutable Vector<std::pair<const Font*, int>> glyphPages; // Font and atlas page of each of glyphMaterials
+		mutable uint32_t atlasGeneration = 0;
 		mutable Vector<Sprite> spritesCache;
 		mutable bool materialDirty = true;
 		mutable bool glyphsDirty = true;
-		mutable bool positionDirty = true;
+		mutable bool spritesDirty = true;
 
-		std::shared_ptr<Material> getMaterial(const Font& font) const;
+		void updateGlyphQuads() const;
+		void drawGlyphQuads(Painter& painter) const;
+
+		std::shared_ptr<Material> getMaterial(const Font& font, const Font::Glyph& glyph) const;
 		void updateMaterial(Material& material, const Font& font) const;
 		void updateMaterialForFont(const Font& font) const;
 		void updateMaterials() const;
@@ -15,6 +15,7 @@ namespace Halley
 	public:
 		Texture(Vector2i size);
 
+		// Can be called again on textures loaded with canBeUpdated, to replace their contents
 		void load(TextureDescriptor descriptor);
 
 		std::optional<uint32_t> getPixel(Vector2f texPos) const;
@@ -25,6 +26,8 @@ namespace Halley
 		Vector2i getSize() const { return size; }
 		const TextureDescriptor& getDescriptor() const { return descriptor; }
 
+		size_t getMemoryUsage() const override { return size_t(std::max(size.x, 0)) * size_t(std::max(size.y, 0)) * 4; }
+
 	protected:
 		Vector2i size;
 		TextureDescriptor descriptor;
@@ -4,6 +4,8 @@
 #include "halley/data_structures/tree_map.h"
 #include "halley/data_structures/hash_map.h"
 #include "halley/resources/metadata.h"
+#include "halley/data_structures/vector.h"
+#include <gsl/span>
 
 namespace Halley
 {
@@ -45,10 +47,30 @@ namespace Halley
 			HashMap<String, Entry> assets;
 		};
 
+		// Location of an asset's data inside of a pack
+		// Stored as a flat table sorted by key, so assets can be found without building or parsing strings
+		struct PackEntry {
+			uint64_t key = 0;
+			uint64_t pos = 0;
+			uint64_t size = 0;
+			uint16_t type = 0;
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
+		};
+
+		// Identifies an asset across all databases
+		static uint64_t getKey(AssetType type, const String& name);
+
 		void addAsset(const String& name, AssetType type, Entry&& entry);
+		void addPackedAsset(const String& name, AssetType type, uint64_t pos, uint64_t size, const Metadata& meta);
 		const TypedDB& getDatabase(AssetType type) const;
 		bool hasDatabase(AssetType type) const;
 		std::vector<String> getAssets() const;
+		Vector<uint64_t> getAssetKeys() const;
+
+		const PackEntry* findPackEntry(uint64_t key) const;
+		gsl::span<const PackEntry> getPackIndex() const;
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
@@ -56,5 +78,9 @@ namespace Halley
 
 	private:
 		mutable TreeMap<int, TypedDB> dbs;
+		mutable Vector<PackEntry> packIndex;
+		mutable bool packIndexSorted = true;
+
+		void sortPackIndex() const;
 	};
 }
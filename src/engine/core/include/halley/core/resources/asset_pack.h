@@ -4,6 +4,8 @@
 #include <memory>
 #include <gsl/span>
 #include "halley/resources/resource_data.h"
+#include "halley/data_structures/tree_map.h"
+#include "halley/concurrency/future.h"
 
 namespace Halley {
 	enum class AssetType;
@@ -23,6 +25,8 @@ namespace Halley {
 	};
 
     class AssetPack {
+		friend class PackDataReader;
+
     public:
 		AssetPack();
 		AssetPack(const AssetPack& other) = delete;
@@ -42,22 +46,50 @@ namespace Halley {
 
 		std::unique_ptr<ResourceData> getData(const String& asset, AssetType type, bool stream);
 
+		// Reads the data of the given assets (keys from AssetDatabase::getKey) in the background, on the disk IO thread (or right away, without Executors)
+		// Ranges close to each other are merged into large sequential reads, and later calls to getData for those assets are served from memory
+		// Each prefetched range is released once all of its assets have been requested, or on clearPrefetched
+		// Does nothing if the pack is memory mapped or already in memory
+		Future<void> prefetch(const Vector<uint64_t>& assetKeys);
+		void clearPrefetched();
+		size_t getPrefetchedBytes() const;
+
 		void readToMemory();
 		void encrypt(const String& key);
 		void decrypt(const String& key);
 	    
     	void readData(size_t pos, gsl::span<gsl::byte> dst);
 
+		// If the pack is backed by a memory mapping, returns a pointer to the given range of asset data, sharing ownership of the mapping
+		// Returns null otherwise
+		std::shared_ptr<const char> getMappedData(size_t pos, size_t size) const;
+
 		std::unique_ptr<ResourceDataReader> extractReader();
 
     private:
+		struct PrefetchBlock {
+			size_t size = 0;
+			int assetsLeft = 0;
+			std::shared_ptr<const char> data; // Null while the read is still pending
+		};
+
 		std::unique_ptr<AssetDatabase> assetDb;
 		std::unique_ptr<ResourceDataReader> reader;
 		std::atomic<bool> hasReader;
 		std::mutex readerMutex;
 		size_t dataOffset = 0;
+		std::shared_ptr<const char> mappedData;
+		size_t mappedSize = 0;
 		Bytes data;
 		std::array<char, 16> iv;
+
+		TreeMap<size_t, PrefetchBlock> prefetched; // By start position
+		Vector<Future<void>> prefetchTasks;
+		mutable std::mutex prefetchMutex;
+
+		std::shared_ptr<const char> getPrefetchedData(size_t pos, size_t size);
+		void runPrefetch(Vector<size_t> blockPositions);
+		void waitForPrefetches();
     };
 
 
@@ -70,9 +102,11 @@ namespace Halley {
 		void seek(int64_t pos, int whence) override;
 		size_t tell() const override;
 		void close() override;
+		std::shared_ptr<const char> getMappedData() const override;
 
 	private:
 		AssetPack& pack;
+		std::shared_ptr<const char> mappedData;
 		const size_t startPos;
 		const size_t fileSize;
 		size_t curPos = 0;
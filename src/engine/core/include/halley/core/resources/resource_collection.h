@@ -3,9 +3,14 @@
 #include <utility>
 #include <memory>
 #include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <halley/text/halleystring.h>
 #include <halley/resources/resource_data.h>
 #include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/vector.h>
+#include <halley/concurrency/future.h>
 
 namespace Halley
 {
@@ -14,6 +19,16 @@ namespace Halley
 	class Resources;
 	class ResourceLoader;
 
+	struct ResourceCollectionStats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t residentCount = 0;
+		size_t residentBytes = 0;
+
+		ResourceCollectionStats& operator+=(const ResourceCollectionStats& other);
+	};
+
 	class ResourceCollectionBase
 	{
 		class Wrapper
@@ -22,20 +37,30 @@ namespace Halley
 			Wrapper(Wrapper&& other) noexcept
 				: res(std::move(other.res))
 				, depth(other.depth)
+				, size(other.size)
+				, lastAccess(other.lastAccess)
+				, evictable(other.evictable)
 			{}
 
-			Wrapper(std::shared_ptr<Resource> resource, int loadDepth)
+			Wrapper(std::shared_ptr<Resource> resource, int loadDepth, size_t size = 0, uint64_t lastAccess = 0, bool evictable = false)
 				: res(std::move(resource))
 				, depth(loadDepth)
+				, size(size)
+				, lastAccess(lastAccess)
+				, evictable(evictable)
 			{}
 
 			std::shared_ptr<Resource> res;
 			int depth;
+			size_t size;
+			uint64_t lastAccess;
+			bool evictable;
 		};
 
 	public:
 		using ResourceLoaderFunc = std::function<std::shared_ptr<Resource>(const String&, ResourceLoadPriority)>;
 		using ResourceEnumeratorFunc = std::function<std::vector<String>()>;
+		using ResourceCallback = std::function<void(std::shared_ptr<Resource>)>;
 
 		explicit ResourceCollectionBase(Resources& parent, AssetType type);
 		virtual ~ResourceCollectionBase() {}
@@ -48,28 +73,69 @@ namespace Halley
 		void unload(const String& assetId);
 		void unloadAll(int minDepth = 0);
 		bool exists(const String& assetId) const;
+		bool isLoadedOrLoading(const String& assetId) const;
 		void setFallback(const String& assetId);
 
 		void reload(const String& assetId);
 		void purge(const String& assetId);
 
 		std::shared_ptr<Resource> getUntyped(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal);
+		Future<std::shared_ptr<Resource>> getUntypedAsync(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal);
+
+		// Loads the resource on the CPU executors (or on the main thread, for types that must be loaded there),
+		// then calls back with it, or with null if it failed to load
+		// Requests for a resource that's already being loaded join that load instead of starting a new one
+		void doGetAsync(const String& name, ResourceLoadPriority priority, ResourceCallback callback);
+
+		// Resources calls this before destroying collections, since pending loads still refer to them
+		void waitForPendingLoads();
+
+		// Once over budget, loaded resources that aren't referenced outside of the collection are unloaded, least recently used first
+		// Sizes are estimates: Resource::getMemoryUsage, or the size of the data it was loaded from
+		void setMemoryBudget(std::optional<size_t> bytes);
+		std::optional<size_t> getMemoryBudget() const;
+		ResourceCollectionStats getStats() const;
+
+		struct EvictionCandidate {
+			ResourceCollectionBase* collection;
+			String assetId;
+			uint64_t lastAccess;
+			size_t size;
+		};
+		void getEvictionCandidates(Vector<EvictionCandidate>& dst);
+		bool evict(const String& assetId); // Only if it's still unreferenced
 
 		std::vector<String> enumerate() const;
 
 	protected:
 		virtual std::shared_ptr<Resource> loadResource(ResourceLoader& loader) = 0;
+		virtual bool canLoadOnAnyThread() const = 0;
 
 		std::shared_ptr<Resource> doGet(const String& name, ResourceLoadPriority priority, bool allowFallback);
-		std::pair<std::shared_ptr<Resource>, bool> loadAsset(const String& assetId, ResourceLoadPriority priority, bool allowFallback);
+		std::pair<std::shared_ptr<Resource>, bool> loadAsset(const String& assetId, ResourceLoadPriority priority, bool allowFallback, size_t* dataSize = nullptr);
 
 	private:
+		struct PendingLoad {
+			Vector<ResourceCallback> callbacks;
+		};
+
 		Resources& parent;
 		HashMap<String, Wrapper> resources;
+		HashMap<String, std::shared_ptr<PendingLoad>> pending;
+		mutable std::mutex mutex;
 		String fallback;
 		AssetType type;
 		ResourceLoaderFunc resourceLoader;
 		ResourceEnumeratorFunc resourceEnumerator;
+
+		std::optional<size_t> memoryBudget;
+		ResourceCollectionStats stats;
+
+		bool canLoadOnThisThread() const;
+		void enforceMemoryBudget();
+		void onResourceRemoved(const Wrapper& wrapper);
+		std::shared_ptr<Resource> runLoad(const String& assetId, ResourceLoadPriority priority, bool allowFallback);
+		void finishLoad(const String& assetId, const std::shared_ptr<Resource>& resource);
 	};
 
 	template <typename T>
@@ -87,9 +153,24 @@ namespace Halley
 			return std::static_pointer_cast<T>(doGet(assetId, priority, true));
 		}
 
+		Future<std::shared_ptr<const T>> getAsync(const String& assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal)
+		{
+			Promise<std::shared_ptr<const T>> promise;
+			auto future = promise.getFuture();
+			doGetAsync(assetId, priority, [promise] (std::shared_ptr<Resource> res) mutable
+			{
+				promise.setValue(std::static_pointer_cast<const T>(std::move(res)));
+			});
+			return future;
+		}
+
 	protected:
 		std::shared_ptr<Resource> loadResource(ResourceLoader& loader) override {
 			return T::loadResource(loader);
 		}
+
+		bool canLoadOnAnyThread() const override {
+			return T::canLoadOnAnyThread();
+		}
 	};
 }
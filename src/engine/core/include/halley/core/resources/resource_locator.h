@@ -27,6 +27,7 @@
 #include <halley/data_structures/hash_map.h>
 #include <halley/data_structures/vector.h>
 #include "halley/data_structures/maybe.h"
+#include "halley/concurrency/future.h"
 
 namespace Halley {
 	enum class AssetType;
@@ -41,6 +42,7 @@ namespace Halley {
 		virtual const AssetDatabase& getAssetDatabase() = 0;
 		virtual int getPriority() const { return 0; }
 		virtual void purge(SystemAPI& system) = 0;
+		virtual Future<void> prefetch(const Vector<uint64_t>& assetKeys);
 	};
 
 	class ResourceLocator final : public IResourceLocator
@@ -51,6 +53,7 @@ namespace Halley {
 		void addPack(const Path& path, const String& encryptionKey = "", bool preLoad = false, bool allowFailure = false, std::optional<int> priority = {});
 		std::vector<String> getAssetsFromPack(const Path& path, const String& encryptionKey = "") const;
 		void removePack(const Path& path);
+		void addProvider(std::unique_ptr<IResourceLocatorProvider> provider, const Path& path); // For other sources of assets, e.g. in tools and tests
 
 		const Metadata* getMetaData(const String& resource, AssetType type) const override;
 
@@ -60,6 +63,10 @@ namespace Halley {
 		void purge(const String& asset, AssetType type);
 		void purgeAll();
 
+		// Starts reading the data of these assets in the background, where that helps (e.g. unmapped packs), so loading them later doesn't block on IO
+		Future<void> prefetch(const std::vector<String>& ids); // ids are in "type:name" format
+		Future<void> prefetch(const Vector<uint64_t>& assetKeys); // Keys from AssetDatabase::getKey
+
 		std::vector<String> enumerate(AssetType type);
 		bool exists(const String& asset, AssetType type);
 
@@ -68,11 +75,9 @@ namespace Halley {
 	private:
 		SystemAPI& system;
 		HashMap<String, IResourceLocatorProvider*> locatorPaths;
-		HashMap<String, IResourceLocatorProvider*> assetToLocator;
+		HashMap<uint64_t, IResourceLocatorProvider*> assetToLocator;
 		Vector<std::unique_ptr<IResourceLocatorProvider>> locators;
 
-		void add(std::unique_ptr<IResourceLocatorProvider> locator, const Path& path);
-
 		std::unique_ptr<ResourceData> getResource(const String& asset, AssetType type, bool stream, bool throwOnFail) const;
 		void loadLocatorData(IResourceLocatorProvider& locator);
 	};
@@ -23,6 +23,9 @@
 
 #include <ctime>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include <halley/support/exception.h>
 #include "halley/resources/resource.h"
 #include "resource_collection.h"
@@ -75,6 +78,26 @@ namespace Halley {
 			return of<T>().get(name, priority);
 		}
 
+		// Loads on the CPU executors (or later on the main thread, for types that require it); see ResourceCollectionBase::doGetAsync
+		// The future is set to null if the resource fails to load
+		template <typename T>
+		Future<std::shared_ptr<const T>> getAsync(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal) const
+		{
+			return of<T>().getAsync(name, priority);
+		}
+
+		struct PreloadEntry {
+			AssetType type;
+			String name;
+			ResourceLoadPriority priority = ResourceLoadPriority::Normal;
+		};
+
+		// Starts loading all the given resources in parallel, higher priority ones first
+		// Dependencies are resolved by the resources themselves as they load, and shared with any other loads that need them
+		// The future is ready once all of them are done (loaded or failed); don't block the main thread on it while frames need to keep going
+		Future<void> preload(Vector<PreloadEntry> entries) const;
+		Future<void> preload(const std::vector<String>& ids, ResourceLoadPriority priority = ResourceLoadPriority::Normal) const; // ids are in "type:name" format
+
 		template <typename T>
 		void unload(const String& name) const
 		{
@@ -93,6 +116,26 @@ namespace Halley {
 			of<T>().setFallback(name);
 		}
 
+		// Once a type goes over its budget, its least recently used resources that nothing else holds on to are evicted
+		// They're transparently reloaded the next time they're requested
+		template <typename T>
+		void setMemoryBudget(std::optional<size_t> bytes)
+		{
+			of<T>().setMemoryBudget(bytes);
+		}
+
+		// Same, but applied across all resource types
+		void setTotalMemoryBudget(std::optional<size_t> bytes);
+		std::optional<size_t> getTotalMemoryBudget() const;
+
+		// Evicts unused resources, least recently used first, until at most targetBytes are resident (defaults to the total budget)
+		// With neither a target nor a total budget, every unused resource is evicted, e.g. to respond to a low memory warning
+		// Returns the number of bytes freed
+		size_t trimMemory(std::optional<size_t> targetBytes = {});
+
+		ResourceCollectionStats getStats() const; // Totals for all types; use ofType(type).getStats() for a single one
+		size_t getResidentBytes() const { return residentBytes; }
+
 		template <typename T>
 		[[nodiscard]] bool exists(const String& name) const
 		{
@@ -120,5 +163,14 @@ namespace Halley {
 		Vector<std::unique_ptr<ResourceCollectionBase>> resources;
 		const HalleyAPI* const api;
 		Options options;
+		std::thread::id mainThreadId;
+
+		std::atomic<uint64_t> accessCounter = 0;
+		std::atomic<size_t> residentBytes = 0;
+		std::optional<size_t> totalMemoryBudget; // Loader threads check it after each load, so guarded by budgetMutex
+		mutable std::mutex budgetMutex;
+
+		uint64_t nextAccessTick() { return ++accessCounter; }
+		void enforceMemoryBudget();
 	};
 }
@@ -9,6 +9,7 @@
 namespace Halley {
 	class DummyVideoAPI : public VideoAPIInternal {
 	public:
+		DummyVideoAPI() = default;
 		explicit DummyVideoAPI(SystemAPI& system);
 
 		void startRender() override;
@@ -20,6 +20,7 @@
 #include "../dummy/dummy_plugins.h"
 #include "entry/entry_point.h"
 #include "halley/core/devcon/devcon_client.h"
+#include "halley/memory/frame_arena.h"
 #include "halley/net/connection/network_service.h"
 
 #ifdef _MSC_VER
@@ -183,6 +184,10 @@ void Core::init()
 		api->system->setThreadName("main");
 	}
 
+	// Tasks sent to the main thread run once per frame, and whenever the main thread is waiting on a future
+	Executors::getMainThread().attachWorkerThread();
+	mainThreadExecutor = std::make_unique<Executor>(Executors::getMainThread());
+
 	// Resources
 	initResources();
 
@@ -238,6 +243,7 @@ void Core::deInit()
 
 	// Deinit resources
 	resources.reset();
+	mainThreadExecutor.reset();
 
 	// Deinit API (note that this has to happen after resources, otherwise resources which rely on an API to de-init, such as textures, will crash)
 	api->deInit();
@@ -333,6 +339,13 @@ void Core::onFixedUpdate(Time time)
 
 void Core::onVariableUpdate(Time time)
 {
+	// Everything allocated from frame arenas during the previous frame is released here
+	FrameArena::beginFrame();
+
+	if (mainThreadExecutor) {
+		mainThreadExecutor->runPending();
+	}
+
 	if (api->system) {
 		api->systemInternal->onTickMainLoop();
 	}
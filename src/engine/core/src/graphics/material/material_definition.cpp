@@ -9,9 +9,14 @@
 #include "halley/text/string_converter.h"
 #include "halley/file_formats/binary_file.h"
 #include "halley/file_formats/config_file.h"
+#include <atomic>
 
 using namespace Halley;
 
+namespace {
+	std::atomic<uint32_t> nextDefinitionId = 1;
+}
+
 MaterialUniform::MaterialUniform()
 	: type(ShaderParameterType::Invalid)
 {}
@@ -126,9 +131,12 @@ void MaterialTexture::deserialize(Deserializer& s)
 	s >> samplerType;
 }
 
-MaterialDefinition::MaterialDefinition() {}
+MaterialDefinition::MaterialDefinition()
+	: id(nextDefinitionId++)
+{}
 
 MaterialDefinition::MaterialDefinition(ResourceLoader& loader)
+	: id(nextDefinitionId++)
 {
 	auto data = loader.getStatic();
 	Deserializer s(data->getSpan());
@@ -153,7 +161,9 @@ MaterialDefinition::MaterialDefinition(ResourceLoader& loader)
 void MaterialDefinition::reload(Resource&& resource)
 {
 	auto& other = dynamic_cast<MaterialDefinition&>(resource);
+	const auto prevId = id;
 	*this = std::move(other);
+	id = prevId; // Still the same definition
 }
 
 void MaterialDefinition::load(const ConfigNode& root)
@@ -1,5 +1,7 @@
 #include "halley/core/graphics/painter.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 
 #include "halley/core/graphics/render_context.h"
@@ -13,6 +15,7 @@
 
 #include "halley/maths/bezier.h"
 #include "halley/maths/polygon.h"
+#include "halley/memory/frame_arena.h"
 #include "resources/resources.h"
 
 using namespace Halley;
@@ -43,7 +46,10 @@ void Painter::startRender()
 	prevDrawCalls = nDrawCalls;
 	prevTriangles = nTriangles;
 	prevVertices = nVertices;
+	prevDeferredDraws = nDeferredDraws;
+	prevDrawCallsSaved = nDrawCallsSaved;
 	nDrawCalls = nTriangles = nVertices = 0;
+	nDeferredDraws = nDrawCallsSaved = 0;
 
 	resetPending();
 	doStartRender();
@@ -59,9 +65,26 @@ void Painter::endRender()
 
 void Painter::flush()
 {
+	flushDeferred();
 	flushPending();
 }
 
+void Painter::setDeferred(bool deferred)
+{
+	if (this->deferred && !deferred) {
+		flushDeferred();
+	}
+	this->deferred = deferred;
+}
+
+void Painter::setDeferredLayer(int layer)
+{
+	if (layer != deferredLayer) {
+		deferredLayer = layer;
+		++deferredWindow;
+	}
+}
+
 Rect4f Painter::getWorldViewAABB() const
 {
 	Vector2f size = Vector2f(viewPort.getSize()) / camera.getZoom();
@@ -77,6 +100,10 @@ static Vector4f& getVertPos(char* vertexAttrib, size_t vertPosOffset)
 
 Painter::PainterVertexData Painter::addDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly)
 {
+	if (deferred) {
+		return addDeferredDrawData(material, numVertices, numIndices, standardQuadsOnly);
+	}
+
 	updateClip();
 
 	constexpr auto maxVertices = size_t(std::numeric_limits<IndexType>::max());
@@ -113,6 +140,107 @@ Painter::PainterVertexData Painter::addDrawData(const std::shared_ptr<Material>&
 	return result;
 }
 
+Painter::PainterVertexData Painter::addDeferredDrawData(const std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly)
+{
+	constexpr auto maxVertices = size_t(std::numeric_limits<IndexType>::max());
+	if (numVertices > maxVertices) {
+		throw Exception("Too many vertices in draw call: " + toString(numVertices) + ", maximum is " + toString(maxVertices), HalleyExceptions::Graphics);
+	}
+
+	Expects(material != nullptr);
+	Expects(numVertices > 0);
+	Expects(numIndices >= numVertices);
+
+	// Clip changes can't be reordered either
+	if (pendingClip != deferredClip) {
+		deferredClip = pendingClip;
+		++deferredWindow;
+	}
+	if (deferredWindow > 0xFFFF) {
+		flushDeferred();
+		deferredWindow = 0;
+	}
+
+	// Keep track of how many draw calls these would have taken in recorded order
+	if (!lastDeferredMaterial || !(*lastDeferredMaterial == *material) || deferredDraws.empty() || deferredDraws.back().clip != pendingClip) {
+		++deferredBatchesInOrder;
+	}
+	lastDeferredMaterial = material.get();
+
+	// Key is (window, definition, material hash), so that a stable sort groups equal materials within each window
+	const auto& definition = material->getDefinition();
+	const uint64_t definitionBits = definition.getId() & 0xFFFF;
+	const uint64_t sortKey = (uint64_t(deferredWindow) << 48) | (definitionBits << 32) | (material->getHash() & 0xFFFFFFFF);
+
+	PainterVertexData result;
+	result.vertexSize = definition.getVertexSize();
+	result.vertexStride = definition.getVertexStride();
+	result.dataSize = numVertices * result.vertexStride;
+	result.firstIndex = 0; // Indices are relative to this draw until it's replayed
+
+	const size_t vertexOffset = deferredVertices.size();
+	const size_t indexOffset = deferredIndices.size();
+	deferredVertices.resize(vertexOffset + result.dataSize);
+	deferredIndices.resize(indexOffset + numIndices);
+	result.dstVertex = deferredVertices.data() + vertexOffset;
+	result.dstIndex = deferredIndices.data() + indexOffset;
+
+	deferredDraws.push_back(DeferredDraw{ sortKey, material, pendingClip, vertexOffset, numVertices, indexOffset, numIndices, standardQuadsOnly });
+	++nDeferredDraws;
+
+	return result;
+}
+
+void Painter::flushDeferred()
+{
+	if (deferredDraws.empty()) {
+		return;
+	}
+
+	deferredOrder.resize(deferredDraws.size());
+	for (size_t i = 0; i < deferredOrder.size(); ++i) {
+		deferredOrder[i] = static_cast<uint32_t>(i);
+	}
+	std::stable_sort(deferredOrder.begin(), deferredOrder.end(), [&] (uint32_t a, uint32_t b)
+	{
+		return deferredDraws[a].sortKey < deferredDraws[b].sortKey;
+	});
+
+	// Replay through the normal path, which merges consecutive compatible draws
+	const auto prevClip = pendingClip;
+	deferred = false;
+
+	size_t batches = 0;
+	const DeferredDraw* prev = nullptr;
+	for (const auto idx: deferredOrder) {
+		const auto& draw = deferredDraws[idx];
+		if (!prev || !(*prev->material == *draw.material) || prev->clip != draw.clip) {
+			++batches;
+		}
+		prev = &draw;
+
+		pendingClip = draw.clip;
+		const auto result = addDrawData(draw.material, draw.numVertices, draw.numIndices, draw.standardQuadsOnly);
+		memcpy(result.dstVertex, deferredVertices.data() + draw.vertexOffset, result.dataSize);
+		const auto* srcIndices = deferredIndices.data() + draw.indexOffset;
+		for (size_t i = 0; i < draw.numIndices; ++i) {
+			result.dstIndex[i] = static_cast<IndexType>(srcIndices[i] + result.firstIndex);
+		}
+	}
+
+	if (deferredBatchesInOrder > batches) {
+		nDrawCallsSaved += deferredBatchesInOrder - batches;
+	}
+
+	deferred = true;
+	pendingClip = prevClip;
+	deferredDraws.clear();
+	deferredVertices.clear();
+	deferredIndices.clear();
+	deferredBatchesInOrder = 0;
+	lastDeferredMaterial = nullptr;
+}
+
 void Painter::draw(const std::shared_ptr<Material>& material, size_t numVertices, const void* vertexData, gsl::span<const IndexType> indices, PrimitiveType primitiveType)
 {
 	Expects(primitiveType == PrimitiveType::Triangle);
@@ -151,25 +279,30 @@ void Painter::drawSprites(const std::shared_ptr<Material>& material, size_t numS
 	const char* const src = reinterpret_cast<const char*>(vertexData);
 
 	for (size_t i = 0; i < numSprites; i++) {
-		for (size_t j = 0; j < verticesPerSprite; j++) {
-			const size_t srcOffset = i * result.vertexStride;
-			const size_t dstOffset = (i * verticesPerSprite + j) * result.vertexStride;
-			memcpy(result.dstVertex + dstOffset, src + srcOffset, result.vertexSize);
-
-			// j -> vertPos
-			// 0 -> 0, 0
-			// 1 -> 1, 0
-			// 2 -> 1, 1
-			// 3 -> 0, 1
-			const float x = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
-			const float y = ((j & 2) >> 1) * 1.0f;
-			getVertPos(result.dstVertex + dstOffset, vertPosOffset) = Vector4f(x, y, x, y);
-		}
+		makeSpriteQuad(src + i * result.vertexStride, result.vertexSize, result.vertexStride, vertPosOffset, result.dstVertex + i * verticesPerSprite * result.vertexStride);
 	}
 
 	generateQuadIndices(result.firstIndex, numSprites, result.dstIndex);
 }
 
+void Painter::makeSpriteQuad(const void* spriteVertex, size_t vertexSize, size_t vertexStride, size_t vertPosOffset, void* dst)
+{
+	char* const dstBytes = reinterpret_cast<char*>(dst);
+	for (size_t j = 0; j < 4; j++) {
+		char* const vertex = dstBytes + j * vertexStride;
+		memcpy(vertex, spriteVertex, vertexSize);
+
+		// j -> vertPos
+		// 0 -> 0, 0
+		// 1 -> 1, 0
+		// 2 -> 1, 1
+		// 3 -> 0, 1
+		const float x = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
+		const float y = ((j & 2) >> 1) * 1.0f;
+		getVertPos(vertex, vertPosOffset) = Vector4f(x, y, x, y);
+	}
+}
+
 void Painter::drawSlicedSprite(const std::shared_ptr<Material>& material, Vector2f scale, Vector4f slices, const void* vertexData)
 {
 	Expects(vertexData != nullptr);
@@ -239,7 +372,7 @@ void Painter::drawLine(gsl::span<const Vector2f> points, float width, Colour4f c
 
 	const size_t nPoints = points.size();
 	const size_t nSegments = (loop ? nPoints : (nPoints - 1));
-	std::vector<LineVertex> vertices(nSegments * 4);
+	FrameVector<LineVertex> vertices(nSegments * 4);
 
 	auto segmentNormal = [&] (size_t i) -> std::optional<Vector2f>
 	{
@@ -311,7 +444,8 @@ static size_t getSegmentsForArc(float radius, float arcLen)
 void Painter::drawCircle(Vector2f centre, float radius, float width, Colour4f colour, std::shared_ptr<Material> material)
 {
 	const size_t n = getSegmentsForArc(radius, 2 * float(pi()));
-	std::vector<Vector2f> points;
+	FrameVector<Vector2f> points;
+	points.reserve(n);
 	for (size_t i = 0; i < n; ++i) {
 		points.push_back(centre + Vector2f(radius, 0).rotate(Angle1f::fromRadians(i * 2.0f * float(pi()) / n)));
 	}
@@ -327,7 +461,8 @@ void Painter::drawCircleArc(Vector2f centre, float radius, float width, Angle1f
 {
 	const float arcLen = (to - from).getRadians() + (from.turnSide(to) > 0 ? 0.0f : 0 * float(pi()));
 	const size_t n = getSegmentsForArc(radius, arcLen);
-	std::vector<Vector2f> points;
+	FrameVector<Vector2f> points;
+	points.reserve(n);
 	for (size_t i = 0; i < n; ++i) {
 		points.push_back(centre + Vector2f(radius, 0).rotate(from + Angle1f::fromRadians(i * arcLen / (n - 1))));
 	}
@@ -342,7 +477,8 @@ void Painter::drawCircleArc(Circle circle, float width, Angle1f from, Angle1f to
 void Painter::drawEllipse(Vector2f centre, Vector2f radius, float width, Colour4f colour, std::shared_ptr<Material> material)
 {
 	const size_t n = getSegmentsForArc(std::max(radius.x, radius.y), 2 * float(pi()));
-	std::vector<Vector2f> points;
+	FrameVector<Vector2f> points;
+	points.reserve(n);
 	for (size_t i = 0; i < n; ++i) {
 		points.push_back(centre + Vector2f(1.0f, 0).rotate(Angle1f::fromRadians(i * 2.0f * float(pi()) / n)) * radius);
 	}
@@ -351,11 +487,7 @@ void Painter::drawEllipse(Vector2f centre, Vector2f radius, float width, Colour4
 
 void Painter::drawRect(Rect4f rect, float width, Colour4f colour, std::shared_ptr<Material> material)
 {
-	std::vector<Vector2f> points;
-	points.push_back(rect.getTopLeft());
-	points.push_back(rect.getTopRight());
-	points.push_back(rect.getBottomRight());
-	points.push_back(rect.getBottomLeft());
+	const std::array<Vector2f, 4> points = { rect.getTopLeft(), rect.getTopRight(), rect.getBottomRight(), rect.getBottomLeft() };
 	drawLine(points, width, colour, true, std::move(material));
 }
 
@@ -380,14 +512,15 @@ void Painter::drawPolygon(const Polygon& polygon, Colour4f colour, std::shared_p
 	
 	const auto& vs = polygon.getVertices();
 	const auto n = vs.size();
-	std::vector<LineVertex> vertices(n);
+	FrameVector<LineVertex> vertices(n);
 	for (size_t i = 0; i < n; ++i) {
 		vertices[i].position = vs[i];
 		vertices[i].colour = col;
 		vertices[i].normal = Vector2f();
 		vertices[i].width = Vector2f();
 	}
-	std::vector<IndexType> indices((n - 2) * 3);
+	FrameVector<IndexType> indices;
+	indices.reserve((n - 2) * 3);
 	for (size_t i = 0; i < n - 2; ++i) {
 		indices.push_back(0);
 		indices.push_back(static_cast<IndexType>(i) + 1);
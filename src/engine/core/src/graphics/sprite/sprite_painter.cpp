@@ -1,8 +1,12 @@
 #include "graphics/sprite/sprite_painter.h"
 #include "graphics/sprite/sprite.h"
 #include "graphics/painter.h"
+#include "graphics/material/material.h"
+#include "graphics/material/material_definition.h"
 #include <gsl/gsl>
 #include "graphics/text/text_renderer.h"
+#include "halley/concurrency/concurrent.h"
+#include <array>
 
 using namespace Halley;
 
@@ -51,6 +55,24 @@ bool SpritePainterEntry::operator<(const SpritePainterEntry& o) const
 	}
 }
 
+uint64_t SpritePainterEntry::getSortKey() const
+{
+	// Flip the sign bits so that the unsigned order matches the signed/float order
+	const uint32_t layerBits = static_cast<uint32_t>(layer) ^ 0x80000000u;
+
+	uint32_t tieBits;
+	const float tie = tieBreaker == 0 ? 0.0f : tieBreaker; // -0 and +0 have to compare equal
+	memcpy(&tieBits, &tie, sizeof(tieBits));
+	tieBits = (tieBits & 0x80000000u) != 0 ? ~tieBits : (tieBits | 0x80000000u);
+
+	return (uint64_t(layerBits) << 32) | uint64_t(tieBits);
+}
+
+size_t SpritePainterEntry::getInsertOrder() const
+{
+	return insertOrder;
+}
+
 SpritePainterEntryType SpritePainterEntry::getType() const
 {
 	return type;
@@ -160,14 +182,15 @@ void SpritePainter::add(SpritePainterEntry::Callback callback, int mask, int lay
 	dirty = true;
 }
 
+void SpritePainter::setExecutionQueue(ExecutionQueue* queue)
+{
+	this->queue = queue;
+}
+
 void SpritePainter::draw(int mask, Painter& painter)
 {
 	if (dirty) {
-		// TODO: implement hierarchical bucketing.
-		// - one bucket per layer
-		// - for each layer, one bucket per vertical band of the screen (32px or so)
-		// - sort each leaf bucket
-		std::sort(sprites.begin(), sprites.end()); // lol
+		sortEntries();
 		dirty = false;
 	}
 
@@ -175,32 +198,172 @@ void SpritePainter::draw(int mask, Painter& painter)
 	const auto& cam = painter.getCurrentCamera();
 	Rect4f view = cam.getClippingRectangle();
 
-	// Draw!
+	// Draw! Consecutive sprites are gathered into a run, which is culled and turned into vertices in parallel
 	for (auto& s : sprites) {
 		if ((s.getMask() & mask) != 0) {
 			const auto type = s.getType();
 			
 			if (type == SpritePainterEntryType::SpriteRef) {
-				draw(s.getSprites(), painter, view, s.getClip());
+				addToSpriteRun(s.getSprites(), s.getClip());
 			} else if (type == SpritePainterEntryType::SpriteCached) {
-				draw(gsl::span<const Sprite>(cachedSprites.data() + s.getIndex(), s.getCount()), painter, view, s.getClip());
-			} else if (type == SpritePainterEntryType::TextRef) {
-				draw(s.getTexts(), painter, view, s.getClip());
-			} else if (type == SpritePainterEntryType::TextCached) {
-				draw(gsl::span<const TextRenderer>(cachedText.data() + s.getIndex(), s.getCount()), painter, view, s.getClip());
-			} else if (type == SpritePainterEntryType::Callback) {
-				draw(callbacks.at(s.getIndex()), painter, s.getClip());
+				addToSpriteRun(gsl::span<const Sprite>(cachedSprites.data() + s.getIndex(), s.getCount()), s.getClip());
+			} else {
+				drawSpriteRun(painter, view);
+
+				if (type == SpritePainterEntryType::TextRef) {
+					draw(s.getTexts(), painter, view, s.getClip());
+				} else if (type == SpritePainterEntryType::TextCached) {
+					draw(gsl::span<const TextRenderer>(cachedText.data() + s.getIndex(), s.getCount()), painter, view, s.getClip());
+				} else if (type == SpritePainterEntryType::Callback) {
+					draw(callbacks.at(s.getIndex()), painter, s.getClip());
+				}
 			}
 		}
 	}
+	drawSpriteRun(painter, view);
 	painter.flush();
 }
 
-void SpritePainter::draw(gsl::span<const Sprite> sprites, Painter& painter, Rect4f view, const std::optional<Rect4f>& clip) const
+void SpritePainter::sortEntries()
+{
+	// Stable LSD radix sort on (layer, tieBreaker), starting from insertion order so that it breaks the remaining ties
+	const size_t n = sprites.size();
+	sortKeys.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		const auto order = sprites[i].getInsertOrder();
+		Expects(order < n);
+		sortKeys[order] = std::pair(sprites[i].getSortKey(), static_cast<uint32_t>(i));
+	}
+
+	constexpr size_t nPasses = 8;
+	std::array<std::array<uint32_t, 256>, nPasses> histograms = {};
+	for (const auto& key: sortKeys) {
+		for (size_t pass = 0; pass < nPasses; ++pass) {
+			++histograms[pass][(key.first >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	sortKeysTmp.resize(n);
+	for (size_t pass = 0; pass < nPasses && n > 0; ++pass) {
+		auto& histogram = histograms[pass];
+		if (histogram[(sortKeys[0].first >> (pass * 8)) & 0xFF] == n) {
+			// Every key has the same digit here, e.g. all sprites in the same layer
+			continue;
+		}
+
+		uint32_t total = 0;
+		for (auto& count: histogram) {
+			const auto c = count;
+			count = total;
+			total += c;
+		}
+		for (const auto& key: sortKeys) {
+			sortKeysTmp[histogram[(key.first >> (pass * 8)) & 0xFF]++] = key;
+		}
+		std::swap(sortKeys, sortKeysTmp);
+	}
+
+	sortedSprites.clear();
+	sortedSprites.reserve(n);
+	for (const auto& key: sortKeys) {
+		sortedSprites.push_back(sprites[key.second]);
+	}
+	std::swap(sprites, sortedSprites);
+}
+
+void SpritePainter::addToSpriteRun(gsl::span<const Sprite> sprites, const std::optional<Rect4f>& clip)
 {
 	for (const auto& sprite: sprites) {
-		if (sprite.isInView(view)) {
-			sprite.draw(painter, clip);
+		spriteRun.push_back(SpriteRunItem{ &sprite, &clip });
+	}
+}
+
+void SpritePainter::drawSpriteRun(Painter& painter, Rect4f view)
+{
+	if (spriteRun.empty()) {
+		return;
+	}
+
+	constexpr size_t spritesPerChunk = 1024;
+	const size_t n = spriteRun.size();
+	const size_t nChunks = (n + spritesPerChunk - 1) / spritesPerChunk;
+	if (chunks.size() < nChunks) {
+		chunks.resize(nChunks);
+	}
+
+	auto build = [&] (size_t i)
+	{
+		const size_t start = i * spritesPerChunk;
+		buildChunk(gsl::span<const SpriteRunItem>(spriteRun).subspan(start, std::min(spritesPerChunk, n - start)), chunks[i], view);
+	};
+	if (nChunks > 1 && (queue || Executors::hasInstance())) {
+		Concurrent::parallelFor(queue ? *queue : ExecutionQueue::getDefault(), 0, nChunks, build);
+	} else {
+		// Not worth it, or no threads to split it across (e.g. in tools)
+		for (size_t i = 0; i < nChunks; ++i) {
+			build(i);
+		}
+	}
+
+	// Submission has to stay in order
+	for (size_t i = 0; i < nChunks; ++i) {
+		drawChunk(chunks[i], painter);
+	}
+
+	spriteRun.clear();
+}
+
+void SpritePainter::buildChunk(gsl::span<const SpriteRunItem> items, SpriteChunk& chunk, Rect4f view)
+{
+	constexpr size_t stride = sizeof(SpriteVertexAttrib);
+	chunk.batches.clear();
+	if (chunk.vertices.size() < size_t(items.size()) * 4 * stride) {
+		chunk.vertices.resize(size_t(items.size()) * 4 * stride);
+	}
+
+	size_t vertexPos = 0;
+	size_t vertexSize = 0;
+	size_t vertPosOffset = 0;
+	const Material* lastMaterial = nullptr;
+
+	for (const auto& item: items) {
+		const auto& sprite = *item.sprite;
+		if (!sprite.material || !sprite.isInView(view)) {
+			continue;
+		}
+
+		if (sprite.sliced || sprite.hasClip || *item.clip) {
+			chunk.batches.push_back(SpriteBatch{ &sprite, item.clip, 0 });
+			lastMaterial = nullptr;
+			continue;
+		}
+
+		const auto* material = sprite.material.get();
+		if (material != lastMaterial) {
+			const auto& definition = material->getDefinition();
+			Expects(definition.getVertexStride() == stride);
+			chunk.batches.push_back(SpriteBatch{ &sprite, item.clip, 0 });
+			vertexSize = definition.getVertexSize();
+			vertPosOffset = definition.getVertexPosOffset();
+			lastMaterial = material;
+		}
+
+		Painter::makeSpriteQuad(&sprite.vertexAttrib, vertexSize, stride, vertPosOffset, chunk.vertices.data() + vertexPos);
+		vertexPos += 4 * stride;
+		++chunk.batches.back().numSprites;
+	}
+}
+
+void SpritePainter::drawChunk(const SpriteChunk& chunk, Painter& painter)
+{
+	constexpr size_t stride = sizeof(SpriteVertexAttrib);
+	size_t vertexPos = 0;
+	for (const auto& batch: chunk.batches) {
+		if (batch.numSprites == 0) {
+			batch.sprite->draw(painter, *batch.clip);
+		} else {
+			painter.drawQuads(batch.sprite->material, batch.numSprites * 4, chunk.vertices.data() + vertexPos);
+			vertexPos += batch.numSprites * 4 * stride;
 		}
 	}
 }
@@ -66,6 +66,19 @@ Font::Font(String name, String imageName, float ascender, float height, float si
 {
 }
 
+std::shared_ptr<Font> Font::makeDynamic(String name, std::shared_ptr<GlyphRasterizer> rasterizer, VideoAPI& video, Resources& resources, FontAtlas::Settings settings, std::vector<String> fallback, float replacementScale)
+{
+	Expects(rasterizer != nullptr);
+
+	const auto metrics = rasterizer->getMetrics();
+	auto font = std::make_shared<Font>(std::move(name), "", metrics.ascender, metrics.height, metrics.sizePoints, replacementScale, settings.pageSize, metrics.smoothRadius, std::move(fallback));
+	font->rasterizer = std::move(rasterizer);
+	font->atlas = std::make_unique<FontAtlas>(video, resources.get<MaterialDefinition>("Halley/Text"), settings);
+	font->onLoaded(resources);
+
+	return font;
+}
+
 std::unique_ptr<Font> Font::loadResource(ResourceLoader& loader)
 {
 	auto data = loader.getStatic(false);
@@ -105,6 +118,10 @@ std::pair<const Font::Glyph&, const Font&> Font::getGlyph(int code) const
 
 const Font::Glyph& Font::getGlyphHere(int code) const
 {
+	if (rasterizer) {
+		return getDynamicGlyph(code);
+	}
+
 	auto iter = glyphs.find(code);
 	if (iter == glyphs.end()) {
 		iter = glyphs.find(0);
@@ -118,10 +135,9 @@ const Font::Glyph& Font::getGlyphHere(int code) const
 
 const Font& Font::getFontForGlyph(int code) const
 {
-	const auto iter = glyphs.find(code);
-	if (iter == glyphs.end()) {
+	if (!hasGlyphHere(code)) {
 		for (const auto& font: fallbackFont) {
-			if (font->glyphs.find(code) != font->glyphs.end()) {
+			if (font->hasGlyphHere(code)) {
 				return *font;
 			}
 		}
@@ -129,6 +145,40 @@ const Font& Font::getFontForGlyph(int code) const
 	return *this;
 }
 
+bool Font::hasGlyphHere(int code) const
+{
+	if (rasterizer) {
+		return rasterizer->hasGlyph(code);
+	}
+	return glyphs.find(code) != glyphs.end();
+}
+
+const Font::Glyph& Font::getDynamicGlyph(int code) const
+{
+	const int actualCode = rasterizer->hasGlyph(code) ? code : 0;
+	const auto iter = glyphs.find(actualCode);
+	if (iter != glyphs.end() && iter->second.atlasPage >= 0) {
+		// Looking a glyph up means it's about to be drawn, so don't evict its page from under it
+		atlas->markUsed(iter->second.atlasPage);
+		return iter->second;
+	}
+
+	auto rasterized = rasterizer->rasterize(actualCode);
+	const auto location = atlas->add(*rasterized.image, [&] (int page)
+	{
+		for (auto& [c, glyph]: glyphs) {
+			if (glyph.atlasPage == page) {
+				glyph.atlasPage = -1;
+			}
+		}
+	});
+
+	auto& glyph = glyphs[actualCode];
+	glyph = Glyph(actualCode, location.area, Vector2f(rasterized.image->getSize()), rasterized.horizontalBearing, rasterized.verticalBearing, rasterized.advance);
+	glyph.atlasPage = location.page;
+	return glyph;
+}
+
 float Font::getLineHeightAtSize(float size) const
 {
 	return height * size / sizePt;
@@ -174,6 +224,11 @@ bool Font::isDistanceField() const
 	return distanceField;
 }
 
+bool Font::isDynamic() const
+{
+	return rasterizer != nullptr;
+}
+
 void Font::addGlyph(const Glyph& glyph)
 {
 	glyphs[glyph.charcode] = glyph;
@@ -181,9 +236,41 @@ void Font::addGlyph(const Glyph& glyph)
 
 std::shared_ptr<Material> Font::getMaterial() const
 {
+	if (atlas) {
+		return atlas->getNumPages() > 0 ? atlas->getMaterial(0) : std::shared_ptr<Material>();
+	}
 	return material;
 }
 
+std::shared_ptr<Material> Font::getMaterial(const Glyph& glyph) const
+{
+	if (atlas) {
+		return atlas->getMaterial(glyph.atlasPage);
+	}
+	return material;
+}
+
+uint32_t Font::getAtlasGeneration() const
+{
+	uint32_t result = atlas ? atlas->getGeneration() : 0;
+	for (const auto& font: fallbackFont) {
+		result += font->getAtlasGeneration();
+	}
+	return result;
+}
+
+void Font::prepareAtlasPage(int page) const
+{
+	if (atlas) {
+		atlas->prepareForDraw(page);
+	}
+}
+
+size_t Font::getMemoryUsage() const
+{
+	return atlas ? atlas->getMemoryUsage() : 0;
+}
+
 void Font::serialize(Serializer& s) const
 {
 	s << name;
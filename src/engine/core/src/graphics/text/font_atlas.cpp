@@ -0,0 +1,184 @@
+#include "graphics/text/font_atlas.h"
+#include "halley/core/api/halley_api.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/texture.h"
+#include "halley/core/graphics/texture_descriptor.h"
+#include "halley/file_formats/image.h"
+#include "halley/memory/frame_arena.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+FontAtlas::FontAtlas(VideoAPI& video, std::shared_ptr<const MaterialDefinition> materialDefinition, Settings settings)
+	: video(video)
+	, materialDefinition(std::move(materialDefinition))
+	, settings(settings)
+{
+	Expects(settings.pageSize.x > 0 && settings.pageSize.y > 0);
+	Expects(settings.maxPages > 0);
+}
+
+FontAtlas::~FontAtlas() = default;
+
+FontAtlas::Location FontAtlas::add(const Image& image, const EvictCallback& onEvict)
+{
+	Expects(image.getFormat() == Image::Format::SingleChannel);
+
+	const auto imageSize = image.getSize();
+	const auto size = imageSize + Vector2i(settings.padding, settings.padding);
+	if (size.x > settings.pageSize.x || size.y > settings.pageSize.y) {
+		throw Exception("Glyph of size " + toString(imageSize) + " doesn't fit in a font atlas page of size " + toString(settings.pageSize), HalleyExceptions::Graphics);
+	}
+
+	int pageIdx = -1;
+	std::optional<Vector2i> pos;
+	for (int i = 0; i < static_cast<int>(pages.size()); ++i) {
+		pos = tryPlace(pages[i], size);
+		if (pos) {
+			pageIdx = i;
+			break;
+		}
+	}
+
+	if (!pos) {
+		const auto toEvict = static_cast<int>(pages.size()) < settings.maxPages ? std::optional<int>() : findPageToEvict();
+		if (toEvict) {
+			pageIdx = toEvict.value();
+			evict(pageIdx, onEvict);
+		} else {
+			pageIdx = addPage();
+		}
+		pos = tryPlace(pages[pageIdx], size);
+		Expects(pos.has_value());
+	}
+
+	auto& page = pages[pageIdx];
+	page.image->blitFrom(pos.value(), image.getPixelBytes(), imageSize.x, imageSize.y, imageSize.x, 8);
+	page.dirty = true;
+	page.lastUsedFrame = FrameArena::getFrameNumber();
+
+	const auto pageSize = Vector2f(settings.pageSize);
+	return Location{ pageIdx, Rect4f(Vector2f(pos.value()) / pageSize, Vector2f(pos.value() + imageSize) / pageSize) };
+}
+
+void FontAtlas::markUsed(int page)
+{
+	pages.at(page).lastUsedFrame = FrameArena::getFrameNumber();
+}
+
+void FontAtlas::prepareForDraw(int page)
+{
+	auto& p = pages.at(page);
+	p.lastUsedFrame = FrameArena::getFrameNumber();
+	if (p.dirty) {
+		upload(p);
+	}
+}
+
+const std::shared_ptr<Material>& FontAtlas::getMaterial(int page) const
+{
+	return pages.at(page).material;
+}
+
+size_t FontAtlas::getNumPages() const
+{
+	return pages.size();
+}
+
+uint32_t FontAtlas::getGeneration() const
+{
+	return generation;
+}
+
+Vector2i FontAtlas::getPageSize() const
+{
+	return settings.pageSize;
+}
+
+size_t FontAtlas::getMemoryUsage() const
+{
+	size_t total = 0;
+	for (const auto& page: pages) {
+		total += page.image->getByteSize() + page.texture->getMemoryUsage();
+	}
+	return total;
+}
+
+std::optional<Vector2i> FontAtlas::tryPlace(Page& page, Vector2i size)
+{
+	// Use the shortest shelf that fits, unless it would waste over half its height and there's room for a new one
+	Shelf* best = nullptr;
+	for (auto& shelf: page.shelves) {
+		if (shelf.height >= size.y && shelf.x + size.x <= settings.pageSize.x && (!best || shelf.height < best->height)) {
+			best = &shelf;
+		}
+	}
+
+	const int nextY = page.shelves.empty() ? 0 : page.shelves.back().y + page.shelves.back().height;
+	const bool canOpenShelf = nextY + size.y <= settings.pageSize.y && size.x <= settings.pageSize.x;
+	if (canOpenShelf && (!best || best->height > size.y * 2)) {
+		best = &page.shelves.emplace_back(Shelf{ nextY, size.y, 0 });
+	}
+
+	if (!best) {
+		return {};
+	}
+
+	const auto pos = Vector2i(best->x, best->y);
+	best->x += size.x;
+	return pos;
+}
+
+void FontAtlas::upload(Page& page)
+{
+	auto descriptor = TextureDescriptor(settings.pageSize, TextureFormat::Red);
+	descriptor.useFiltering = true;
+	descriptor.canBeUpdated = true;
+	descriptor.pixelFormat = PixelDataFormat::Precompiled;
+	descriptor.pixelData = TextureDescriptorImageData(gsl::as_bytes(page.image->getPixelBytes()));
+	page.texture->load(std::move(descriptor));
+	page.dirty = false;
+}
+
+int FontAtlas::addPage()
+{
+	auto& page = pages.emplace_back();
+	page.image = std::make_unique<Image>(Image::Format::SingleChannel, settings.pageSize);
+	page.image->clear(0);
+	page.texture = video.createTexture(settings.pageSize);
+	page.material = std::make_shared<Material>(materialDefinition);
+	page.material->set("tex0", page.texture);
+	page.lastUsedFrame = FrameArena::getFrameNumber();
+	page.dirty = true;
+	return static_cast<int>(pages.size()) - 1;
+}
+
+std::optional<int> FontAtlas::findPageToEvict() const
+{
+	// Pages drawn this frame might still be referenced by draws that haven't been flushed
+	const auto curFrame = FrameArena::getFrameNumber();
+	std::optional<int> best;
+	for (int i = 0; i < static_cast<int>(pages.size()); ++i) {
+		const auto lastUsed = pages[i].lastUsedFrame;
+		if (lastUsed != curFrame && (!best || lastUsed < pages[best.value()].lastUsedFrame)) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+void FontAtlas::evict(int pageIdx, const EvictCallback& onEvict)
+{
+	if (onEvict) {
+		onEvict(pageIdx);
+	}
+
+	auto& page = pages[pageIdx];
+	page.image->clear(0);
+	page.shelves.clear();
+	page.dirty = true;
+	++generation;
+}
@@ -3,6 +3,8 @@
 #include "halley/core/graphics/painter.h"
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/memory/frame_arena.h"
 #include <gsl/gsl_assert>
 
 #include "halley/support/logger.h"
@@ -28,7 +30,7 @@ TextRenderer& TextRenderer::setPosition(Vector2f pos)
 {
 	if (position != pos) {
 		position = pos;
-		positionDirty = true;
+		spritesDirty = true;
 	}
 	return *this;
 }
@@ -37,6 +39,7 @@ TextRenderer& TextRenderer::setFont(std::shared_ptr<const Font> v)
 {
 	if (font != v) {
 		font = v;
+		glyphsDirty = true;
 
 		if (font->isDistanceField()) {
 			materialDirty = true;
@@ -183,6 +186,30 @@ TextRenderer TextRenderer::clone() const
 }
 
 void TextRenderer::generateSprites(std::vector<Sprite>& sprites) const
+{
+	updateGlyphQuads();
+
+	if (spritesDirty || &sprites != &spritesCache) {
+		sprites.resize(glyphQuads.size());
+		for (size_t i = 0; i < glyphQuads.size(); ++i) {
+			const auto& quad = glyphQuads[i];
+			sprites[i] = Sprite()
+				.setMaterial(glyphMaterials[quad.materialIdx], true)
+				.setSize(quad.size)
+				.setTexRect(quad.texRect)
+				.setColour(quad.colour)
+				.setPivot(quad.pivot)
+				.setScale(quad.scale)
+				.setPos(position + quad.pos);
+		}
+
+		if (&sprites == &spritesCache) {
+			spritesDirty = false;
+		}
+	}
+}
+
+void TextRenderer::updateGlyphQuads() const
 {
 	Expects(font != nullptr);
 
@@ -198,102 +225,116 @@ void TextRenderer::generateSprites(std::vector<Sprite>& sprites) const
 
 	const bool hasMaterialOverride = font->isDistanceField();
 	if (hasMaterialOverride && materialDirty) {
+		// Materials are updated in place, so the glyphs can keep pointing at them
 		updateMaterials();
 		materialDirty = false;
 	}
 
-	if (glyphsDirty || positionDirty) {
-		float mainScale = getScale(*font);
-		Vector2f p = floorAlign(position + Vector2f(0, font->getAscenderDistance() * mainScale));
-		if (offset != Vector2f(0, 0)) {
-			p -= floorAlign(getExtents() * offset);
-		}
+	if (font->getAtlasGeneration() != atlasGeneration) {
+		// Some glyphs were evicted from a dynamic font's atlas, so they might be somewhere else now
+		glyphsDirty = true;
+	}
 
-		size_t startPos = 0;
-		size_t spritesInserted = 0;
-		Vector2f lineOffset;
-
-		auto flush = [&] ()
-		{
-			// Line break, update previous characters!
-			if (align != 0) {
-				Vector2f off = floorAlign(-lineOffset * align);
-				for (size_t j = startPos; j < spritesInserted; j++) {
-					auto& sprite = sprites[j];
-					sprite.setPos(sprite.getPosition() + off);
-				}
+	if (!glyphsDirty) {
+		return;
+	}
+
+	float mainScale = getScale(*font);
+	Vector2f p = floorAlign(Vector2f(0, font->getAscenderDistance() * mainScale));
+	if (offset != Vector2f(0, 0)) {
+		p -= floorAlign(getExtents() * offset);
+	}
+
+	glyphQuads.clear();
+	glyphMaterials.clear();
+	glyphPages.clear();
+	size_t startPos = 0;
+	Vector2f lineOffset;
+
+	auto flush = [&] ()
+	{
+		// Line break, update previous characters!
+		if (align != 0) {
+			Vector2f off = floorAlign(-lineOffset * align);
+			for (size_t j = startPos; j < glyphQuads.size(); j++) {
+				glyphQuads[j].pos += off;
 			}
+		}
 
-			// Move pen
-			p.y += getLineHeight();
+		// Move pen
+		p.y += getLineHeight();
 
-			// Reset
-			startPos = spritesInserted;
-			lineOffset.x = 0;
-		};
+		// Reset
+		startPos = glyphQuads.size();
+		lineOffset.x = 0;
+	};
 
-		auto curCol = colour;
-		size_t curOverride = 0;
+	auto curCol = colour;
+	size_t curOverride = 0;
 
-		const size_t n = text.size();
+	const size_t n = text.size();
+	glyphQuads.reserve(n);
 
-		size_t nGlyphs = 0;
-		for (size_t i = 0; i < n; i++) {
-			if (text[i] != '\n') {
-				++nGlyphs;
-			}
+	for (size_t i = 0; i < n; i++) {
+		int c = text[i];
+
+		// Check for colour override
+		while (curOverride < colourOverrides.size() && colourOverrides[curOverride].first == i) {
+			curCol = colourOverrides[curOverride].second ? colourOverrides[curOverride].second.value() : colour;
+			++curOverride;
 		}
-		sprites.resize(nGlyphs);
+		
+		if (c == '\n') {
+			flush();
+		} else {
+			const auto& [glyph, fontForGlyph] = font->getGlyph(c);
+			const float scale = getScale(fontForGlyph);
+			const auto fontAdjustment = floorAlign(Vector2f(0, fontForGlyph.getAscenderDistance() - font->getAscenderDistance()) * scale);
+
+			std::shared_ptr<Material> materialToUse = hasMaterialOverride ? getMaterial(fontForGlyph, glyph) : fontForGlyph.getMaterial(glyph);
+			if (glyphMaterials.empty() || glyphMaterials.back() != materialToUse) {
+				glyphMaterials.push_back(std::move(materialToUse));
+				glyphPages.emplace_back(&fontForGlyph, glyph.atlasPage);
+			}
 
-		for (size_t i = 0; i < n; i++) {
-			int c = text[i];
+			GlyphQuad quad;
+			quad.pos = p + lineOffset + pixelOffset + fontAdjustment;
+			quad.size = glyph.size;
+			quad.pivot = glyph.horizontalBearing / glyph.size * Vector2f(-1, 1);
+			quad.scale = scale;
+			quad.texRect = glyph.area;
+			quad.colour = curCol;
+			quad.materialIdx = static_cast<uint32_t>(glyphMaterials.size() - 1);
+			Expects(quad.pivot.isValid());
+			glyphQuads.push_back(quad);
 
-			// Check for colour override
-			while (curOverride < colourOverrides.size() && colourOverrides[curOverride].first == i) {
-				curCol = colourOverrides[curOverride].second ? colourOverrides[curOverride].second.value() : colour;
-				++curOverride;
-			}
-			
-			if (c == '\n') {
+			lineOffset.x += glyph.advance.x * scale;
+
+			if (i == n - 1) {
 				flush();
-			} else {
-				const auto& [glyph, fontForGlyph] = font->getGlyph(c);
-				const float scale = getScale(fontForGlyph);
-				const auto fontAdjustment = floorAlign(Vector2f(0, fontForGlyph.getAscenderDistance() - font->getAscenderDistance()) * scale);
-
-				std::shared_ptr<Material> materialToUse = hasMaterialOverride ? getMaterial(fontForGlyph) : fontForGlyph.getMaterial();
-
-				sprites[spritesInserted++] = Sprite()
-					.setMaterial(std::move(materialToUse), true)
-					.setSize(glyph.size)
-					.setTexRect(glyph.area)
-					.setColour(curCol)
-					.setPivot(glyph.horizontalBearing / glyph.size * Vector2f(-1, 1))
-					.setScale(scale)
-					.setPos(p + lineOffset + pixelOffset + fontAdjustment);
-
-				lineOffset.x += glyph.advance.x * scale;
-
-				if (i == n - 1) {
-					flush();
-				}
 			}
 		}
-
-		glyphsDirty = false;
-		positionDirty = false;
 	}
+
+	// Any glyphs rasterized above are on pages used this frame, so they can't have been evicted since
+	atlasGeneration = font->getAtlasGeneration();
+	glyphsDirty = false;
+	spritesDirty = true;
 }
 
 void TextRenderer::draw(Painter& painter, const std::optional<Rect4f>& extClip) const
 {
-	generateSprites(spritesCache);
-
 	if (spriteFilter) {
-		// We don't know what the user will do with glyphs, so mark them as dirty
+		// We don't know what the user will do with glyphs, so they go through sprites, rebuilt from the cached layout every time
+		generateSprites(spritesCache);
 		spriteFilter(gsl::span<Sprite>(spritesCache.data(), spritesCache.size()));
-		glyphsDirty = true;
-		positionDirty = true;
+		spritesDirty = true;
+	} else {
+		updateGlyphQuads();
+	}
+
+	for (const auto& [glyphFont, page]: glyphPages) {
+		glyphFont->prepareAtlasPage(page);
 	}
 
 	const std::optional<Rect4f> myClip = clip ? clip.value() + position : std::optional<Rect4f>();
@@ -301,14 +342,59 @@ void TextRenderer::draw(Painter& painter, const std::optional<Rect4f>& extClip)
 	if (finalClip) {
 		painter.setRelativeClip(finalClip.value());
 	}
-	
-	Sprite::drawMixedMaterials(spritesCache.data(), spritesCache.size(), painter);
+
+	if (spriteFilter) {
+		Sprite::drawMixedMaterials(spritesCache.data(), spritesCache.size(), painter);
+	} else {
+		drawGlyphQuads(painter);
+	}
 
 	if (finalClip) {
 		painter.setClip();
 	}
 }
 
+void TextRenderer::drawGlyphQuads(Painter& painter) const
+{
+	const size_t n = glyphQuads.size();
+	if (n == 0) {
+		return;
+	}
+
+	FrameVector<char> vertices(n * 4 * sizeof(SpriteVertexAttrib));
+
+	size_t start = 0;
+	for (size_t i = 1; i <= n; ++i) {
+		if (i < n && glyphQuads[i].materialIdx == glyphQuads[start].materialIdx) {
+			continue;
+		}
+
+		// Expand this material's run straight into quads, without going through Sprite
+		const auto& material = glyphMaterials[glyphQuads[start].materialIdx];
+		const auto& definition = material->getDefinition();
+		const size_t stride = definition.getVertexStride();
+		Expects(stride == sizeof(SpriteVertexAttrib));
+		const size_t vertexSize = definition.getVertexSize();
+		const size_t vertPosOffset = definition.getVertexPosOffset();
+
+		char* dst = vertices.data();
+		for (size_t j = start; j < i; ++j) {
+			const auto& quad = glyphQuads[j];
+			SpriteVertexAttrib attrib = {};
+			attrib.pos = position + quad.pos;
+			attrib.pivot = quad.pivot;
+			attrib.size = quad.size;
+			attrib.scale = Vector2f(quad.scale, quad.scale);
+			attrib.colour = quad.colour;
+			attrib.texRect0 = quad.texRect;
+			Painter::makeSpriteQuad(&attrib, vertexSize, stride, vertPosOffset, dst + (j - start) * 4 * stride);
+		}
+		painter.drawQuads(material, (i - start) * 4, dst);
+
+		start = i;
+	}
+}
+
 void TextRenderer::setSpriteFilter(SpriteFilter f)
 {
 	spriteFilter = std::move(f);
@@ -541,12 +627,13 @@ float TextRenderer::getScale(const Font& f) const
 	return size / f.getSizePoints() * (usingReplacement ? font->getReplacementScale() : 1.0f);
 }
 
-std::shared_ptr<Material> TextRenderer::getMaterial(const Font& font) const
+std::shared_ptr<Material> TextRenderer::getMaterial(const Font& font, const Font::Glyph& glyph) const
 {
-	const auto iter = materials.find(&font);
+	const auto key = std::make_pair(&font, font.isDynamic() ? glyph.atlasPage : 0);
+	const auto iter = materials.find(key);
 	if (iter == materials.end()) {
-		auto material = font.getMaterial()->clone();
-		materials[&font] = material;
+		auto material = font.getMaterial(glyph)->clone();
+		materials[key] = material;
 		updateMaterial(*material, font);
 		return material;
 	} else {
@@ -574,14 +661,17 @@ void TextRenderer::updateMaterial(Material& material, const Font& font) const
 
 void TextRenderer::updateMaterialForFont(const Font& font) const
 {
-	auto material = getMaterial(font);
-	updateMaterial(*material, font);
+	for (auto& m: materials) {
+		if (m.first.first == &font) {
+			updateMaterial(*m.second, font);
+		}
+	}
 }
 
 void TextRenderer::updateMaterials() const
 {
 	for (auto& m: materials) {
-		updateMaterial(*m.second, *m.first);
+		updateMaterial(*m.second, *m.first.first);
 	}
 }
 
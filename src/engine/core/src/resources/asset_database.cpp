@@ -2,6 +2,7 @@
 #include "halley/bytes/byte_serializer.h"
 #include "halley/support/exception.h"
 #include "halley/resources/resource.h"
+#include "halley/utils/hash.h"
 #include <set>
 
 using namespace Halley;
@@ -25,6 +26,22 @@ void AssetDatabase::Entry::deserialize(Deserializer& s)
 	s >> meta;
 }
 
+void AssetDatabase::PackEntry::serialize(Serializer& s) const
+{
+	s << key;
+	s << pos;
+	s << size;
+	s << type;
+}
+
+void AssetDatabase::PackEntry::deserialize(Deserializer& s)
+{
+	s >> key;
+	s >> pos;
+	s >> size;
+	s >> type;
+}
+
 AssetDatabase::TypedDB::TypedDB()
 {
 }
@@ -70,6 +87,12 @@ AssetType AssetDatabase::TypedDB::getType() const
 	return type;
 }
 
+uint64_t AssetDatabase::getKey(AssetType type, const String& name)
+{
+	const uint64_t hash = Hash::hash(gsl::as_bytes(gsl::span<const char>(name.c_str(), name.length())));
+	return hash ^ (uint64_t(type) * 0x9E3779B97F4A7C15ull);
+}
+
 void AssetDatabase::addAsset(const String& name, AssetType type, Entry&& entry)
 {
 	const auto iter = dbs.find(static_cast<int>(type));
@@ -82,6 +105,19 @@ void AssetDatabase::addAsset(const String& name, AssetType type, Entry&& entry)
 	}
 }
 
+void AssetDatabase::addPackedAsset(const String& name, AssetType type, uint64_t pos, uint64_t size, const Metadata& meta)
+{
+	PackEntry packEntry;
+	packEntry.key = getKey(type, name);
+	packEntry.pos = pos;
+	packEntry.size = size;
+	packEntry.type = uint16_t(type);
+	packIndex.push_back(packEntry);
+	packIndexSorted = false;
+
+	addAsset(name, type, Entry("", meta));
+}
+
 const AssetDatabase::TypedDB& AssetDatabase::getDatabase(AssetType type) const
 {
 	const int key = int(type);
@@ -116,14 +152,76 @@ std::vector<String> AssetDatabase::getAssets() const
 	return result;
 }
 
+Vector<uint64_t> AssetDatabase::getAssetKeys() const
+{
+	Vector<uint64_t> result;
+	if (!packIndex.empty()) {
+		result.reserve(packIndex.size());
+		for (const auto& e: packIndex) {
+			result.push_back(e.key);
+		}
+	} else {
+		for (const auto& db: dbs) {
+			for (const auto& asset: db.second.getAssets()) {
+				result.push_back(getKey(AssetType(db.first), asset.first));
+			}
+		}
+	}
+	return result;
+}
+
+const AssetDatabase::PackEntry* AssetDatabase::findPackEntry(uint64_t key) const
+{
+	if (!packIndexSorted) {
+		sortPackIndex();
+	}
+
+	const auto iter = std::lower_bound(packIndex.begin(), packIndex.end(), key, [] (const PackEntry& e, uint64_t k) { return e.key < k; });
+	if (iter != packIndex.end() && iter->key == key) {
+		return &*iter;
+	}
+	return nullptr;
+}
+
+gsl::span<const AssetDatabase::PackEntry> AssetDatabase::getPackIndex() const
+{
+	if (!packIndexSorted) {
+		sortPackIndex();
+	}
+	return packIndex;
+}
+
+void AssetDatabase::sortPackIndex() const
+{
+	std::sort(packIndex.begin(), packIndex.end(), [] (const PackEntry& a, const PackEntry& b) { return a.key < b.key; });
+	for (size_t i = 1; i < packIndex.size(); ++i) {
+		if (packIndex[i].key == packIndex[i - 1].key) {
+			throw Exception("Asset key collision in pack index; rename one of the assets of type " + toString(AssetType(packIndex[i].type)), HalleyExceptions::Resources);
+		}
+	}
+	packIndexSorted = true;
+}
+
 void AssetDatabase::serialize(Serializer& s) const
 {
+	if (!packIndexSorted) {
+		sortPackIndex();
+	}
+
 	s << dbs;
+	s << packIndex;
 }
 
 void AssetDatabase::deserialize(Deserializer& s)
 {
 	s >> dbs;
+
+	// Databases written before the pack index existed end here
+	packIndex.clear();
+	if (s.getBytesRemaining() > 0) {
+		s >> packIndex;
+	}
+	packIndexSorted = std::is_sorted(packIndex.begin(), packIndex.end(), [] (const PackEntry& a, const PackEntry& b) { return a.key < b.key; });
 }
 
 std::vector<String> AssetDatabase::enumerate(AssetType type) const
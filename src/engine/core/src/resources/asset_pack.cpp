@@ -5,9 +5,17 @@
 #include "halley/bytes/compression.h"
 #include "halley/maths/random.h"
 #include "halley/utils/encrypt.h"
+#include "halley/resources/resource.h"
+#include "halley/concurrency/concurrent.h"
 
 using namespace Halley;
 
+namespace {
+	// Ranges with a gap up to this size between them are read together, as that's cheaper than seeking
+	constexpr size_t maxPrefetchGap = 64 * 1024;
+	constexpr size_t maxPrefetchReadSize = 8 * 1024 * 1024;
+}
+
 void AssetPackHeader::init(size_t assetDbSize)
 {
 	memcpy(identifier.data(), "HALLEYPK", 8);
@@ -66,6 +74,10 @@ AssetPack::AssetPack(std::unique_ptr<ResourceDataReader> _reader, const String&
 
 	if (preLoad || hasCrypt) {
 		readToMemory();
+	} else if (auto mapped = reader->getMappedData()) {
+		// Assets can be viewed directly in the mapping, without copies or locking
+		mappedData = std::move(mapped);
+		mappedSize = totalSize;
 	}
 
 	if (hasCrypt) {
@@ -75,14 +87,21 @@ AssetPack::AssetPack(std::unique_ptr<ResourceDataReader> _reader, const String&
 
 AssetPack::~AssetPack()
 {
+	waitForPrefetches();
 }
 
 AssetPack& AssetPack::operator=(AssetPack&& other) noexcept
 {
+	waitForPrefetches();
+	other.waitForPrefetches();
+	prefetched.clear();
+
 	std::unique_lock<std::mutex> lock(other.readerMutex);
 
 	assetDb = std::move(other.assetDb);
 	dataOffset = other.dataOffset;
+	mappedData = std::move(other.mappedData);
+	mappedSize = other.mappedSize;
 	reader = std::move(other.reader);
 	data = std::move(other.data);
 	hasReader = !!reader;
@@ -129,17 +148,29 @@ Bytes AssetPack::writeOut() const
 
 std::unique_ptr<ResourceData> AssetPack::getData(const String& asset, AssetType type, bool stream)
 {
-	auto path = asset;
-	auto ps = assetDb->getDatabase(type).get(asset).path.split(':');
-	size_t pos = size_t(ps.at(0).toInteger());
-	size_t size = size_t(ps.at(1).toInteger());
+	const auto& path = asset;
+	size_t pos;
+	size_t size;
+	if (const auto* entry = assetDb->findPackEntry(AssetDatabase::getKey(type, asset))) {
+		pos = size_t(entry->pos);
+		size = size_t(entry->size);
+	} else {
+		// Packs built before the index existed store the location as "pos:size" in the path
+		auto ps = assetDb->getDatabase(type).get(asset).path.split(':');
+		pos = size_t(ps.at(0).toInteger());
+		size = size_t(ps.at(1).toInteger());
+	}
 
 	if (stream) {
 		return std::make_unique<ResourceDataStream>(path, [=] () -> std::unique_ptr<ResourceDataReader> {
 			return std::make_unique<PackDataReader>(*this, pos, size);
 		});
 	} else {
-		if (hasReader) {
+		if (auto mapped = getMappedData(pos, size)) {
+			return std::make_unique<ResourceDataStatic>(std::move(mapped), size, path);
+		} else if (auto prefetchedData = getPrefetchedData(pos, size)) {
+			return std::make_unique<ResourceDataStatic>(std::move(prefetchedData), size, path);
+		} else if (hasReader) {
 			auto result = new char[size];
 			try {
 				readData(pos, gsl::as_writable_bytes(gsl::span<char>(result, size)));
@@ -159,6 +190,188 @@ std::unique_ptr<ResourceData> AssetPack::getData(const String& asset, AssetType
 	}
 }
 
+Future<void> AssetPack::prefetch(const Vector<uint64_t>& assetKeys)
+{
+	if (mappedData || !hasReader) {
+		Promise<void> promise;
+		promise.set();
+		return promise.getFuture();
+	}
+
+	Vector<std::pair<size_t, size_t>> ranges;
+	ranges.reserve(assetKeys.size());
+	for (const auto key: assetKeys) {
+		if (const auto* entry = assetDb->findPackEntry(key)) {
+			ranges.emplace_back(size_t(entry->pos), size_t(entry->size));
+		}
+	}
+	std::sort(ranges.begin(), ranges.end());
+
+	std::unique_lock<std::mutex> lock(prefetchMutex);
+
+	// Coalesce ranges into blocks, skipping anything that's already prefetched
+	Vector<std::pair<size_t, PrefetchBlock>> blocks;
+	for (const auto& [pos, size]: ranges) {
+		auto existing = prefetched.upper_bound(pos);
+		if (existing != prefetched.begin() && pos + size <= std::prev(existing)->first + std::prev(existing)->second.size) {
+			// Keep that block around until this one is requested too
+			++std::prev(existing)->second.assetsLeft;
+			continue;
+		}
+
+		if (!blocks.empty()) {
+			auto& [blockPos, block] = blocks.back();
+			const size_t blockEnd = blockPos + block.size;
+			const size_t newEnd = std::max(blockEnd, pos + size);
+			if (pos <= blockEnd + maxPrefetchGap && newEnd - blockPos <= maxPrefetchReadSize) {
+				block.size = newEnd - blockPos;
+				++block.assetsLeft;
+				continue;
+			}
+		}
+
+		PrefetchBlock block;
+		block.size = size;
+		block.assetsLeft = 1;
+		blocks.emplace_back(pos, std::move(block));
+	}
+
+	Vector<size_t> positions;
+	for (auto& [pos, block]: blocks) {
+		if (prefetched.emplace(pos, std::move(block)).second) {
+			positions.push_back(pos);
+		}
+	}
+
+	if (positions.empty()) {
+		Promise<void> promise;
+		promise.set();
+		return promise.getFuture();
+	}
+
+	if (!Executors::hasInstance()) {
+		// Nothing to run it in the background, so read it now
+		lock.unlock();
+		runPrefetch(std::move(positions));
+		Promise<void> promise;
+		promise.set();
+		return promise.getFuture();
+	}
+
+	prefetchTasks.erase(std::remove_if(prefetchTasks.begin(), prefetchTasks.end(), [] (const Future<void>& f) { return f.isReady(); }), prefetchTasks.end());
+	auto future = Concurrent::execute(Executors::getDiskIO(), [this, positions = std::move(positions)] () mutable
+	{
+		runPrefetch(std::move(positions));
+	});
+	prefetchTasks.push_back(future);
+	return future;
+}
+
+void AssetPack::clearPrefetched()
+{
+	std::unique_lock<std::mutex> lock(prefetchMutex);
+	for (auto iter = prefetched.begin(); iter != prefetched.end(); ) {
+		if (iter->second.data) {
+			iter = prefetched.erase(iter);
+		} else {
+			// Still being read, the IO thread will drop it
+			iter->second.assetsLeft = 0;
+			++iter;
+		}
+	}
+}
+
+size_t AssetPack::getPrefetchedBytes() const
+{
+	std::unique_lock<std::mutex> lock(prefetchMutex);
+	size_t total = 0;
+	for (const auto& [pos, block]: prefetched) {
+		if (block.data) {
+			total += block.size;
+		}
+	}
+	return total;
+}
+
+std::shared_ptr<const char> AssetPack::getPrefetchedData(size_t pos, size_t size)
+{
+	std::unique_lock<std::mutex> lock(prefetchMutex);
+	auto iter = prefetched.upper_bound(pos);
+	if (iter == prefetched.begin()) {
+		return {};
+	}
+	--iter;
+
+	const size_t blockPos = iter->first;
+	auto& block = iter->second;
+	if (pos + size > blockPos + block.size) {
+		return {};
+	}
+
+	// If it's still pending, it gets read directly; the block is dropped once nothing else needs it
+	--block.assetsLeft;
+	std::shared_ptr<const char> result;
+	if (block.data) {
+		result = std::shared_ptr<const char>(block.data, block.data.get() + (pos - blockPos));
+		if (block.assetsLeft <= 0) {
+			prefetched.erase(iter);
+		}
+	}
+	return result;
+}
+
+void AssetPack::runPrefetch(Vector<size_t> blockPositions)
+{
+	for (const auto pos: blockPositions) {
+		size_t size;
+		{
+			std::unique_lock<std::mutex> lock(prefetchMutex);
+			const auto iter = prefetched.find(pos);
+			if (iter == prefetched.end()) {
+				continue;
+			}
+			if (iter->second.assetsLeft <= 0) {
+				prefetched.erase(iter);
+				continue;
+			}
+			size = iter->second.size;
+		}
+
+		std::shared_ptr<const char> buffer;
+		try {
+			auto* bytes = new char[size];
+			buffer = std::shared_ptr<const char>(bytes, std::default_delete<const char[]>());
+			readData(pos, gsl::as_writable_bytes(gsl::span<char>(bytes, size)));
+		} catch (...) {
+			// Loads of these assets will read them directly, and report any errors then
+			buffer.reset();
+		}
+
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		const auto iter = prefetched.find(pos);
+		if (iter != prefetched.end()) {
+			if (buffer && iter->second.assetsLeft > 0) {
+				iter->second.data = std::move(buffer);
+			} else {
+				prefetched.erase(iter);
+			}
+		}
+	}
+}
+
+void AssetPack::waitForPrefetches()
+{
+	Vector<Future<void>> tasks;
+	{
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		tasks = std::move(prefetchTasks);
+		prefetchTasks.clear();
+	}
+	for (auto& task: tasks) {
+		task.wait();
+	}
+}
+
 void AssetPack::readToMemory()
 {
 	std::unique_lock<std::mutex> lock(readerMutex);
@@ -188,6 +401,14 @@ void AssetPack::decrypt(const String& key)
 
 void AssetPack::readData(size_t pos, gsl::span<gsl::byte> dst)
 {
+	if (mappedData) {
+		if (dataOffset + pos + size_t(dst.size()) > mappedSize) {
+			throw Exception("Asset data is out of pack bounds.", HalleyExceptions::Resources);
+		}
+		memcpy(dst.data(), mappedData.get() + dataOffset + pos, dst.size());
+		return;
+	}
+
 	if (hasReader) {
 		std::unique_lock<std::mutex> lock(readerMutex);
 		if (reader) {
@@ -204,6 +425,17 @@ void AssetPack::readData(size_t pos, gsl::span<gsl::byte> dst)
 	memcpy(dst.data(), data.data() + pos, dst.size());
 }
 
+std::shared_ptr<const char> AssetPack::getMappedData(size_t pos, size_t size) const
+{
+	if (!mappedData) {
+		return {};
+	}
+	if (dataOffset + pos + size > mappedSize) {
+		throw Exception("Asset data is out of pack bounds.", HalleyExceptions::Resources);
+	}
+	return std::shared_ptr<const char>(mappedData, mappedData.get() + dataOffset + pos);
+}
+
 std::unique_ptr<ResourceDataReader> AssetPack::extractReader()
 {
 	std::unique_lock<std::mutex> lock(readerMutex);
@@ -213,9 +445,13 @@ std::unique_ptr<ResourceDataReader> AssetPack::extractReader()
 
 PackDataReader::PackDataReader(AssetPack& pack, size_t startPos, size_t fileSize)
 	: pack(pack)
+	, mappedData(pack.getMappedData(startPos, fileSize))
 	, startPos(startPos)
 	, fileSize(fileSize)
 {
+	if (!mappedData) {
+		mappedData = pack.getPrefetchedData(startPos, fileSize);
+	}
 }
 
 size_t PackDataReader::size() const
@@ -226,10 +462,14 @@ size_t PackDataReader::size() const
 int PackDataReader::read(gsl::span<gsl::byte> dst)
 {
 	std::unique_lock<std::mutex> lock(mutex);
-	size_t available = fileSize - curPos;
+	size_t available = curPos < fileSize ? fileSize - curPos : 0;
 	size_t toRead = std::min(available, size_t(dst.size()));
 
-	pack.readData(startPos + curPos, dst.subspan(0, toRead));
+	if (mappedData) {
+		memcpy(dst.data(), mappedData.get() + curPos, toRead);
+	} else {
+		pack.readData(startPos + curPos, dst.subspan(0, toRead));
+	}
 	curPos += toRead;
 
 	return int(toRead);
@@ -261,3 +501,8 @@ void PackDataReader::close()
 {
 }
 
+std::shared_ptr<const char> PackDataReader::getMappedData() const
+{
+	return mappedData;
+}
+
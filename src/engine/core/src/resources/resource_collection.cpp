@@ -6,9 +6,59 @@
 
 #include "graphics/sprite/sprite.h"
 #include "halley/support/logger.h"
+#include "halley/concurrency/executor.h"
 
 using namespace Halley;
 
+namespace {
+	struct LoadingAsset {
+		const ResourceCollectionBase* collection;
+		const String* assetId;
+		int helpDepth;
+	};
+
+	// Assets being loaded on this thread, innermost last
+	// Tasks picked up while waiting (see ExecutionQueue::getHelpDepth) share the stack, but aren't part of the loads below them
+	thread_local Vector<LoadingAsset> loadingStack;
+
+	class LoadingScope {
+	public:
+		LoadingScope(const ResourceCollectionBase& collection, const String& assetId)
+		{
+			loadingStack.push_back(LoadingAsset{ &collection, &assetId, ExecutionQueue::getHelpDepth() });
+		}
+
+		~LoadingScope()
+		{
+			loadingStack.pop_back();
+		}
+	};
+
+	const LoadingAsset* findLoadingOnThisThread(const ResourceCollectionBase& collection, const String& assetId)
+	{
+		const LoadingAsset* result = nullptr;
+		const int depth = ExecutionQueue::getHelpDepth();
+		for (const auto& loading: loadingStack) {
+			if (loading.collection == &collection && *loading.assetId == assetId) {
+				if (loading.helpDepth == depth) {
+					return &loading;
+				}
+				result = &loading;
+			}
+		}
+		return result;
+	}
+}
+
+ResourceCollectionStats& ResourceCollectionStats::operator+=(const ResourceCollectionStats& other)
+{
+	hits += other.hits;
+	misses += other.misses;
+	evictions += other.evictions;
+	residentCount += other.residentCount;
+	residentBytes += other.residentBytes;
+	return *this;
+}
 
 ResourceCollectionBase::ResourceCollectionBase(Resources& parent, AssetType type)
 	: parent(parent)
@@ -18,22 +68,33 @@ ResourceCollectionBase::ResourceCollectionBase(Resources& parent, AssetType type
 
 void ResourceCollectionBase::clear()
 {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (auto& res: resources) {
+		onResourceRemoved(res.second);
+	}
 	resources.clear();
 }
 
 void ResourceCollectionBase::unload(const String& assetId)
 {
-	resources.erase(assetId);
+	std::unique_lock<std::mutex> lock(mutex);
+	const auto iter = resources.find(assetId);
+	if (iter != resources.end()) {
+		onResourceRemoved(iter->second);
+		resources.erase(iter);
+	}
 }
 
 void ResourceCollectionBase::unloadAll(int minDepth)
 {
+	std::unique_lock<std::mutex> lock(mutex);
 	for (auto iter = resources.begin(); iter != resources.end(); ) {
 		auto next = iter;
 		++next;
 
 		auto& res = (*iter).second;
 		if (res.depth >= minDepth) {
+			onResourceRemoved(res);
 			resources.erase(iter);
 		}
 
@@ -43,14 +104,31 @@ void ResourceCollectionBase::unloadAll(int minDepth)
 
 void ResourceCollectionBase::reload(const String& assetId)
 {
-	auto res = resources.find(assetId);
-	if (res != resources.end()) {
-		auto& resWrap = res->second;
+	std::shared_ptr<Resource> oldAsset;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const auto res = resources.find(assetId);
+		if (res != resources.end()) {
+			oldAsset = res->second.res;
+		}
+	}
+
+	if (oldAsset) {
 		try {
-			const auto [newAsset, loaded] = loadAsset(assetId, ResourceLoadPriority::High, false);
+			size_t dataSize = 0;
+			const auto [newAsset, loaded] = loadAsset(assetId, ResourceLoadPriority::High, false, &dataSize);
 			newAsset->setAssetId(assetId);
 			newAsset->onLoaded(parent);
-			resWrap.res->reloadResource(std::move(*newAsset));
+			oldAsset->reloadResource(std::move(*newAsset));
+
+			std::unique_lock<std::mutex> lock(mutex);
+			const auto res = resources.find(assetId);
+			if (res != resources.end() && res->second.res == oldAsset) {
+				const size_t newSize = std::max(oldAsset->getMemoryUsage(), dataSize);
+				stats.residentBytes = stats.residentBytes - res->second.size + newSize;
+				parent.residentBytes += newSize - res->second.size;
+				res->second.size = newSize;
+			}
 		} catch (std::exception& e) {
 			Logger::logError("Error while reloading " + assetId + ": " + e.what());
 		} catch (...) {
@@ -71,6 +149,70 @@ std::shared_ptr<Resource> ResourceCollectionBase::getUntyped(const String& name,
 	return doGet(name, priority, true);
 }
 
+Future<std::shared_ptr<Resource>> ResourceCollectionBase::getUntypedAsync(const String& name, ResourceLoadPriority priority)
+{
+	Promise<std::shared_ptr<Resource>> promise;
+	auto future = promise.getFuture();
+	doGetAsync(name, priority, [promise] (std::shared_ptr<Resource> res) mutable
+	{
+		promise.setValue(std::move(res));
+	});
+	return future;
+}
+
+void ResourceCollectionBase::doGetAsync(const String& assetId, ResourceLoadPriority priority, ResourceCallback callback)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	const auto pendingIter = pending.find(assetId);
+	if (pendingIter != pending.end()) {
+		++stats.hits;
+		pendingIter->second->callbacks.push_back(std::move(callback));
+		return;
+	}
+
+	const auto res = resources.find(assetId);
+	if (res != resources.end()) {
+		++stats.hits;
+		res->second.lastAccess = parent.nextAccessTick();
+		auto result = res->second.res;
+		lock.unlock();
+		callback(std::move(result));
+		return;
+	}
+
+	++stats.misses;
+	auto load = std::make_shared<PendingLoad>();
+	load->callbacks.push_back(std::move(callback));
+	pending[assetId] = std::move(load);
+	lock.unlock();
+
+	const bool anyThread = canLoadOnAnyThread() && !resourceLoader;
+	auto& queue = !anyThread ? Executors::getMainThread() : priority == ResourceLoadPriority::Low ? Executors::getCPUAux() : Executors::getCPU();
+	queue.addToQueue([this, assetId, priority] ()
+	{
+		try {
+			runLoad(assetId, priority, true);
+		} catch (std::exception& e) {
+			Logger::logError("Error while loading " + toString(type) + ":" + assetId + ": " + e.what());
+		} catch (...) {
+			Logger::logError("Unknown error while loading " + toString(type) + ":" + assetId);
+		}
+	});
+}
+
+void ResourceCollectionBase::waitForPendingLoads()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!pending.empty()) {
+		lock.unlock();
+		if (!ExecutionQueue::tryHelpOnCurrentThread()) {
+			std::this_thread::yield();
+		}
+		lock.lock();
+	}
+}
+
 std::vector<String> ResourceCollectionBase::enumerate() const
 {
 	if (resourceEnumerator) {
@@ -80,7 +222,7 @@ std::vector<String> ResourceCollectionBase::enumerate() const
 	}
 }
 
-std::pair<std::shared_ptr<Resource>, bool> ResourceCollectionBase::loadAsset(const String& assetId, ResourceLoadPriority priority, bool allowFallback) {
+std::pair<std::shared_ptr<Resource>, bool> ResourceCollectionBase::loadAsset(const String& assetId, ResourceLoadPriority priority, bool allowFallback, size_t* dataSize) {
 	std::shared_ptr<Resource> newRes;
 
 	if (resourceLoader) {
@@ -90,6 +232,9 @@ std::pair<std::shared_ptr<Resource>, bool> ResourceCollectionBase::loadAsset(con
 		// Normal loading
 		auto resLoader = ResourceLoader(*(parent.locator), assetId, type, priority, parent.api, parent);		
 		newRes = loadResource(resLoader);
+		if (dataSize) {
+			*dataSize = resLoader.bytesLoaded;
+		}
 		if (newRes) {
 			newRes->setMeta(resLoader.getMeta());
 		} else if (resLoader.loaded) {
@@ -100,7 +245,7 @@ std::pair<std::shared_ptr<Resource>, bool> ResourceCollectionBase::loadAsset(con
 	if (!newRes) {
 		if (allowFallback && !fallback.isEmpty()) {
 			Logger::logError("Resource not found: \"" + toString(type) + ":" + assetId + "\"");
-			return loadAsset(fallback, priority, false);
+			return loadAsset(fallback, priority, false, dataSize);
 		}
 		
 		throw Exception("Resource not found: \"" + toString(type) + ":" + assetId + "\"", HalleyExceptions::Resources);
@@ -111,43 +256,242 @@ std::pair<std::shared_ptr<Resource>, bool> ResourceCollectionBase::loadAsset(con
 
 std::shared_ptr<Resource> ResourceCollectionBase::doGet(const String& assetId, ResourceLoadPriority priority, bool allowFallback)
 {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	const auto pendingIter = pending.find(assetId);
+	if (pendingIter != pending.end()) {
+		if (const auto* loading = findLoadingOnThisThread(*this, assetId)) {
+			// Requested again while finishing its own load (e.g. from onLoaded), which is fine once it's in the cache
+			const auto res = resources.find(assetId);
+			if (res != resources.end()) {
+				return res->second.res;
+			}
+
+			if (loading->helpDepth == ExecutionQueue::getHelpDepth()) {
+				throw Exception("Circular dependency while loading resource \"" + toString(type) + ":" + assetId + "\"", HalleyExceptions::Resources);
+			}
+
+			// Being loaded by a task further down this thread, which can't finish until we return, so waiting would never end
+			// Rare enough that loading a separate, uncached copy is fine
+			lock.unlock();
+			LoadingScope scope(*this, assetId);
+			auto newRes = loadAsset(assetId, priority, allowFallback).first;
+			newRes->setAssetId(assetId);
+			newRes->onLoaded(parent);
+			return newRes;
+		}
+
+		// Someone else is already loading it, so wait for them instead
+		++stats.hits;
+		Promise<std::shared_ptr<Resource>> promise;
+		auto future = promise.getFuture();
+		pendingIter->second->callbacks.push_back([promise] (std::shared_ptr<Resource> res) mutable
+		{
+			promise.setValue(std::move(res));
+		});
+		lock.unlock();
+
+		auto result = future.get();
+		if (!result) {
+			throw Exception("Unable to load resource \"" + toString(type) + ":" + assetId + "\"", HalleyExceptions::Resources);
+		}
+		return result;
+	}
+
 	// Look in cache and return if it's there
 	const auto res = resources.find(assetId);
 	if (res != resources.end()) {
+		++stats.hits;
+		res->second.lastAccess = parent.nextAccessTick();
 		return res->second.res;
 	}
-	
-	// Load resource from disk
-	const auto [newRes, loaded] = loadAsset(assetId, priority, allowFallback);
 
-	// Store in cache
-	if (loaded) {
+	if (!canLoadOnThisThread()) {
+		// Have the main thread load it; it runs its queue while waiting on futures or parallelFor, so this can't get stuck behind it
+		lock.unlock();
+		auto result = getUntypedAsync(assetId, priority).get();
+		if (!result) {
+			throw Exception("Unable to load resource \"" + toString(type) + ":" + assetId + "\"", HalleyExceptions::Resources);
+		}
+		return result;
+	}
+
+	// Load it here
+	++stats.misses;
+	pending[assetId] = std::make_shared<PendingLoad>();
+	lock.unlock();
+	return runLoad(assetId, priority, allowFallback);
+}
+
+bool ResourceCollectionBase::canLoadOnThisThread() const
+{
+	return (canLoadOnAnyThread() && !resourceLoader) || std::this_thread::get_id() == parent.mainThreadId;
+}
+
+std::shared_ptr<Resource> ResourceCollectionBase::runLoad(const String& assetId, ResourceLoadPriority priority, bool allowFallback)
+{
+	LoadingScope scope(*this, assetId);
+
+	std::shared_ptr<Resource> newRes;
+	try {
+		// Load resource from disk
+		size_t dataSize = 0;
+		newRes = loadAsset(assetId, priority, allowFallback, &dataSize).first;
 		newRes->setAssetId(assetId);
-		resources.emplace(assetId, Wrapper(newRes, 0));
+
+		// Store in cache before onLoaded, so it can find itself
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			const size_t size = std::max(newRes->getMemoryUsage(), dataSize);
+			resources.emplace(assetId, Wrapper(newRes, 0, size, parent.nextAccessTick(), true));
+			++stats.residentCount;
+			stats.residentBytes += size;
+			parent.residentBytes += size;
+		}
 		newRes->onLoaded(parent);
+	} catch (...) {
+		finishLoad(assetId, {});
+		throw;
 	}
 
+	finishLoad(assetId, newRes);
+
+	enforceMemoryBudget();
+	parent.enforceMemoryBudget();
+
 	return newRes;
 }
 
+void ResourceCollectionBase::finishLoad(const String& assetId, const std::shared_ptr<Resource>& resource)
+{
+	std::shared_ptr<PendingLoad> load;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const auto iter = pending.find(assetId);
+		load = std::move(iter->second);
+		pending.erase(iter);
+	}
+
+	for (auto& callback: load->callbacks) {
+		callback(resource);
+	}
+}
+
 bool ResourceCollectionBase::exists(const String& assetId) const
 {
 	// Look in cache
-	const auto res = resources.find(assetId);
-	if (res != resources.end()) {
-		return true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const auto res = resources.find(assetId);
+		if (res != resources.end()) {
+			return true;
+		}
 	}
 
 	return parent.locator->exists(assetId, type);
 }
 
+bool ResourceCollectionBase::isLoadedOrLoading(const String& assetId) const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return resources.find(assetId) != resources.end() || pending.find(assetId) != pending.end();
+}
+
 void ResourceCollectionBase::setFallback(const String& assetId)
 {
 	fallback = assetId;
 }
 
 void ResourceCollectionBase::setResource(int curDepth, const String& name, std::shared_ptr<Resource> resource) {
-	resources.emplace(name, Wrapper(std::move(resource), curDepth));
+	std::unique_lock<std::mutex> lock(mutex);
+	const size_t size = resource->getMemoryUsage();
+	if (resources.emplace(name, Wrapper(std::move(resource), curDepth, size, parent.nextAccessTick(), false)).second) {
+		++stats.residentCount;
+		stats.residentBytes += size;
+		parent.residentBytes += size;
+	}
+}
+
+void ResourceCollectionBase::setMemoryBudget(std::optional<size_t> bytes)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		memoryBudget = bytes;
+	}
+	enforceMemoryBudget();
+}
+
+std::optional<size_t> ResourceCollectionBase::getMemoryBudget() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return memoryBudget;
+}
+
+ResourceCollectionStats ResourceCollectionBase::getStats() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return stats;
+}
+
+void ResourceCollectionBase::getEvictionCandidates(Vector<EvictionCandidate>& dst)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (auto& [assetId, wrapper]: resources) {
+		// Only the collection holds a reference
+		if (wrapper.evictable && wrapper.res.use_count() == 1 && pending.find(assetId) == pending.end()) {
+			dst.push_back(EvictionCandidate{ this, assetId, wrapper.lastAccess, wrapper.size });
+		}
+	}
+}
+
+bool ResourceCollectionBase::evict(const String& assetId)
+{
+	std::shared_ptr<Resource> evicted; // Destroy outside of the lock, as it might release other resources
+	std::unique_lock<std::mutex> lock(mutex);
+	const auto iter = resources.find(assetId);
+	if (iter == resources.end() || iter->second.res.use_count() != 1 || pending.find(assetId) != pending.end()) {
+		return false;
+	}
+
+	evicted = std::move(iter->second.res);
+	onResourceRemoved(iter->second);
+	resources.erase(iter);
+	++stats.evictions;
+	lock.unlock();
+	return true;
+}
+
+void ResourceCollectionBase::enforceMemoryBudget()
+{
+	size_t excess;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!memoryBudget || stats.residentBytes <= *memoryBudget) {
+			return;
+		}
+		excess = stats.residentBytes - *memoryBudget;
+	}
+
+	Vector<EvictionCandidate> candidates;
+	getEvictionCandidates(candidates);
+	std::sort(candidates.begin(), candidates.end(), [] (const EvictionCandidate& a, const EvictionCandidate& b) { return a.lastAccess < b.lastAccess; });
+
+	size_t freed = 0;
+	for (auto& c: candidates) {
+		if (freed >= excess) {
+			break;
+		}
+		if (evict(c.assetId)) {
+			freed += c.size;
+		}
+	}
+}
+
+void ResourceCollectionBase::onResourceRemoved(const Wrapper& wrapper)
+{
+	--stats.residentCount;
+	stats.residentBytes -= wrapper.size;
+	parent.residentBytes -= wrapper.size;
 }
 
 void ResourceCollectionBase::setResourceLoader(ResourceLoaderFunc loader)
@@ -35,6 +35,7 @@ FileSystemResourceLocator::FileSystemResourceLocator(SystemAPI& system, const Pa
 
 const AssetDatabase& FileSystemResourceLocator::getAssetDatabase()
 {
+	std::unique_lock<std::mutex> lock(mutex);
 	if (!assetDb) {
 		loadAssetDb();
 	}
@@ -48,6 +49,7 @@ int FileSystemResourceLocator::getPriority() const
 
 void FileSystemResourceLocator::purge(SystemAPI& system)
 {
+	std::unique_lock<std::mutex> lock(mutex);
 	assetDb.reset();
 }
 
@@ -64,12 +66,16 @@ void FileSystemResourceLocator::loadAssetDb()
 
 std::unique_ptr<ResourceData> FileSystemResourceLocator::getData(const String& asset, AssetType type, bool stream)
 {
-	if (!assetDb) {
-		loadAssetDb();
+	String path;
+	{
+		// Resources can be loaded from multiple threads
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!assetDb) {
+			loadAssetDb();
+		}
+		path = (basePath / assetDb->getDatabase(type).get(asset).path).string();
 	}
 
-	auto path = (basePath / assetDb->getDatabase(type).get(asset).path).string();
-
 	if (stream) {
 		return std::make_unique<ResourceDataStream>(path, [=] () -> std::unique_ptr<ResourceDataReader> {
 			return system.getDataReader(path);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include "resources/resource_locator.h"
 #include "resources/asset_database.h"
 
@@ -19,6 +20,7 @@ namespace Halley {
 		SystemAPI& system;
 		Path basePath;
 		std::unique_ptr<AssetDatabase> assetDb;
+		std::mutex mutex;
 
 	private:
 		void loadAssetDb();
@@ -6,15 +6,24 @@
 #include "api/system_api.h"
 #include "halley/text/string_converter.h"
 #include "halley/resources/resource.h"
+#include "resources/asset_database.h"
 
 using namespace Halley;
 
+Future<void> IResourceLocatorProvider::prefetch(const Vector<uint64_t>& /*assetKeys*/)
+{
+	// Only worth doing for providers with slow reads, which override this
+	Promise<void> promise;
+	promise.set();
+	return promise.getFuture();
+}
+
 ResourceLocator::ResourceLocator(SystemAPI& system)
 	: system(system)
 {
 }
 
-void ResourceLocator::add(std::unique_ptr<IResourceLocatorProvider> locator, const Path& path)
+void ResourceLocator::addProvider(std::unique_ptr<IResourceLocatorProvider> locator, const Path& path)
 {
 	loadLocatorData(*locator);
 	locatorPaths[path.getString()] = locator.get();
@@ -24,17 +33,17 @@ void ResourceLocator::add(std::unique_ptr<IResourceLocatorProvider> locator, con
 void ResourceLocator::loadLocatorData(IResourceLocatorProvider& locator)
 {
 	auto& db = locator.getAssetDatabase();
-	for (auto& asset: db.getAssets()) {
-		auto result = assetToLocator.find(asset);
+	for (auto key: db.getAssetKeys()) {
+		auto result = assetToLocator.find(key);
 		if (result == assetToLocator.end() || result->second->getPriority() < locator.getPriority()) {
-			assetToLocator[asset] = &locator;
+			assetToLocator[key] = &locator;
 		}
 	}
 }
 
 void ResourceLocator::purge(const String& asset, AssetType type)
 {
-	auto result = assetToLocator.find(toString(type) + ":" + asset);
+	auto result = assetToLocator.find(AssetDatabase::getKey(type, asset));
 	if (result != assetToLocator.end()) {
 		// Found the locator for this file, purge it
 		result->second->purge(system);
@@ -53,9 +62,37 @@ void ResourceLocator::purgeAll()
 	}
 }
 
+Future<void> ResourceLocator::prefetch(const std::vector<String>& ids)
+{
+	Vector<uint64_t> keys;
+	keys.reserve(ids.size());
+	for (auto& id: ids) {
+		const auto splitPos = id.find(':');
+		keys.push_back(AssetDatabase::getKey(fromString<AssetType>(id.left(splitPos)), id.mid(splitPos + 1)));
+	}
+	return prefetch(keys);
+}
+
+Future<void> ResourceLocator::prefetch(const Vector<uint64_t>& assetKeys)
+{
+	HashMap<IResourceLocatorProvider*, Vector<uint64_t>> byLocator;
+	for (const auto key: assetKeys) {
+		const auto result = assetToLocator.find(key);
+		if (result != assetToLocator.end()) {
+			byLocator[result->second].push_back(key);
+		}
+	}
+
+	JoinFuture join(int(byLocator.size()));
+	for (auto& [locator, keys]: byLocator) {
+		locator->prefetch(keys).thenNotify(join);
+	}
+	return join.getFuture();
+}
+
 std::unique_ptr<ResourceData> ResourceLocator::getResource(const String& asset, AssetType type, bool stream, bool throwOnFail) const
 {
-	auto result = assetToLocator.find(toString(type) + ":" + asset);
+	auto result = assetToLocator.find(AssetDatabase::getKey(type, asset));
 	if (result != assetToLocator.end()) {
 		auto data = result->second->getData(asset, type, stream);
 		if (data) {
@@ -115,15 +152,15 @@ std::vector<String> ResourceLocator::enumerate(const AssetType type)
 
 void ResourceLocator::addFileSystem(const Path& path)
 {
-	add(std::make_unique<FileSystemResourceLocator>(system, path), path);
+	addProvider(std::make_unique<FileSystemResourceLocator>(system, path), path);
 }
 
 void ResourceLocator::addPack(const Path& path, const String& encryptionKey, bool preLoad, bool allowFailure, std::optional<int> priority)
 {
-	auto dataReader = system.getDataReader(path.string());
+	auto dataReader = system.getMappedDataReader(path.string());
 	if (dataReader) {
 		auto resourceLocator = std::make_unique<PackResourceLocator>(std::move(dataReader), path, encryptionKey, preLoad, priority);
-		add(std::move(resourceLocator), path);
+		addProvider(std::move(resourceLocator), path);
 
 	} else {
 		if (allowFailure) {
@@ -138,30 +175,21 @@ void ResourceLocator::removePack(const Path& path)
 {
 	auto* locatorToRemove = locatorPaths.find(path.getString())->second;
 	auto& dbToRemove = locatorToRemove->getAssetDatabase();
-	for (auto& asset : dbToRemove.getAssets()) {
-		auto result = assetToLocator.find(asset);
-		if (result != assetToLocator.end()) {
-			assetToLocator.erase(asset);
-		}
+	for (auto key : dbToRemove.getAssetKeys()) {
+		assetToLocator.erase(key);
 	}
 	auto locaterIter = std::find_if(locators.begin(), locators.end(), [&](std::unique_ptr<IResourceLocatorProvider>& locator) { return locator.get() == locatorToRemove; });
 	locators.erase(locaterIter);
 	
 	for (const auto& locator : locators)
 	{
-		auto& db = locator->getAssetDatabase();
-		for (auto& asset : db.getAssets()) {
-			auto result = assetToLocator.find(asset);
-			if (result == assetToLocator.end() || result->second->getPriority() < locator->getPriority()) {
-				assetToLocator[asset] = locator.get();
-			}
-		}
+		loadLocatorData(*locator);
 	}
 }
 
 std::vector<String> ResourceLocator::getAssetsFromPack(const Path& path, const String& encryptionKey) const
 {
-	auto dataReader = system.getDataReader(path.string());
+	auto dataReader = system.getMappedDataReader(path.string());
 	if (dataReader) {
 		std::unique_ptr<IResourceLocatorProvider> resourceLocator = std::make_unique<PackResourceLocator>(std::move(dataReader), path, "", true);
 		auto& db = resourceLocator->getAssetDatabase();
@@ -174,7 +202,7 @@ std::vector<String> ResourceLocator::getAssetsFromPack(const Path& path, const S
 
 const Metadata* ResourceLocator::getMetaData(const String& asset, AssetType type) const
 {
-	auto result = assetToLocator.find(toString(type) + ":" + asset);
+	auto result = assetToLocator.find(AssetDatabase::getKey(type, asset));
 	if (result != assetToLocator.end()) {
 		return &result->second->getAssetDatabase().getDatabase(type).get(asset).meta;
 	} else {
@@ -184,7 +212,7 @@ const Metadata* ResourceLocator::getMetaData(const String& asset, AssetType type
 
 bool ResourceLocator::exists(const String& asset, AssetType type)
 {
-	return assetToLocator.find(toString(type) + ":" + asset) != assetToLocator.end();
+	return assetToLocator.find(AssetDatabase::getKey(type, asset)) != assetToLocator.end();
 }
 
 size_t ResourceLocator::getLocatorCount() const
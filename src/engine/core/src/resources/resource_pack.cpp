@@ -10,7 +10,7 @@ PackResourceLocator::PackResourceLocator(std::unique_ptr<ResourceDataReader> rea
 	, preLoad(preLoad)
 	, priority(priority)
 {
-	assetPack = std::make_unique<AssetPack>(std::move(reader), encryptionKey, preLoad);
+	assetPack = std::make_shared<AssetPack>(std::move(reader), encryptionKey, preLoad);
 }
 
 PackResourceLocator::~PackResourceLocator()
@@ -19,29 +19,39 @@ PackResourceLocator::~PackResourceLocator()
 
 std::unique_ptr<ResourceData> PackResourceLocator::getData(const String& asset, AssetType type, bool stream)
 {
-	if (!assetPack) {
-		loadAfterPurge();
-	}
-	return assetPack->getData(asset, type, stream);
+	return getAssetPack()->getData(asset, type, stream);
 }
 
 const AssetDatabase& PackResourceLocator::getAssetDatabase()
 {
-	if (!assetPack) {
-		loadAfterPurge();
-	}
-	return assetPack->getAssetDatabase();
+	return getAssetPack()->getAssetDatabase();
 }
 
 void PackResourceLocator::purge(SystemAPI& sys)
 {
+	std::unique_lock<std::mutex> lock(mutex);
 	assetPack.reset();
 	system = &sys;
 }
 
+std::shared_ptr<AssetPack> PackResourceLocator::getAssetPack()
+{
+	// Resources can be loaded from multiple threads, and the pack kept alive by a load while it gets purged
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!assetPack) {
+		loadAfterPurge();
+	}
+	return assetPack;
+}
+
 void PackResourceLocator::loadAfterPurge()
 {
-	assetPack = std::make_unique<AssetPack>(system->getDataReader(path.string()), encryptionKey, preLoad);
+	assetPack = std::make_shared<AssetPack>(system->getMappedDataReader(path.string()), encryptionKey, preLoad);
+}
+
+Future<void> PackResourceLocator::prefetch(const Vector<uint64_t>& assetKeys)
+{
+	return getAssetPack()->prefetch(assetKeys);
 }
 
 int PackResourceLocator::getPriority() const
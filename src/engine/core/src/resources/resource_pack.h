@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include "resources/resource_locator.h"
 #include "resources/asset_database.h"
 
@@ -17,11 +18,14 @@ namespace Halley {
 		const AssetDatabase& getAssetDatabase() override;
 		void purge(SystemAPI& system) override;
 		int getPriority() const override;
+		Future<void> prefetch(const Vector<uint64_t>& assetKeys) override;
 		
 	private:
+		std::shared_ptr<AssetPack> getAssetPack();
 		void loadAfterPurge();
 
-		std::unique_ptr<AssetPack> assetPack;
+		std::shared_ptr<AssetPack> assetPack;
+		std::mutex mutex;
 
 		Path path;
 		String encryptionKey; // :(
@@ -1,5 +1,6 @@
 #include "resources/resources.h"
 #include "resources/resource_locator.h"
+#include "resources/asset_database.h"
 #include "api/halley_api.h"
 #include "halley/support/logger.h"
 
@@ -9,9 +10,60 @@ Resources::Resources(std::unique_ptr<ResourceLocator> locator, const HalleyAPI&
 	: locator(std::move(locator))
 	, api(&api)
 	, options(options)
+	, mainThreadId(std::this_thread::get_id())
 {
 }
 
+Future<void> Resources::preload(Vector<PreloadEntry> entries) const
+{
+	std::stable_sort(entries.begin(), entries.end(), [] (const PreloadEntry& a, const PreloadEntry& b)
+	{
+		return a.priority > b.priority;
+	});
+
+	JoinFuture join(int(entries.size()));
+	auto startLoads = [this, entries, join] () mutable
+	{
+		for (auto& entry: entries) {
+			ofType(entry.type).doGetAsync(entry.name, entry.priority, [join] (std::shared_ptr<Resource>) mutable
+			{
+				join.notify();
+			});
+		}
+	};
+
+	// Have packs read all of it in a few large reads first, rather than each load seeking to its own asset
+	if (locator) {
+		Vector<uint64_t> keys;
+		keys.reserve(entries.size());
+		for (auto& entry: entries) {
+			// Those won't read their data again, so it would just sit there
+			if (!ofType(entry.type).isLoadedOrLoading(entry.name)) {
+				keys.push_back(AssetDatabase::getKey(entry.type, entry.name));
+			}
+		}
+		auto prefetched = locator->prefetch(keys);
+		if (!prefetched.isReady()) {
+			prefetched.then(Executors::getCPU(), startLoads);
+			return join.getFuture();
+		}
+	}
+
+	startLoads();
+	return join.getFuture();
+}
+
+Future<void> Resources::preload(const std::vector<String>& ids, ResourceLoadPriority priority) const
+{
+	Vector<PreloadEntry> entries;
+	entries.reserve(ids.size());
+	for (auto& id: ids) {
+		const auto splitPos = id.find(':');
+		entries.push_back(PreloadEntry{ fromString<AssetType>(id.left(splitPos)), id.mid(splitPos + 1), priority });
+	}
+	return preload(std::move(entries));
+}
+
 void Resources::reloadAssets(const std::vector<String>& ids)
 {
 	// Early out
@@ -63,4 +115,73 @@ void Resources::reloadAssets(const std::map<AssetType, std::vector<String>>& byT
 	}
 }
 
-Resources::~Resources() = default;
+void Resources::setTotalMemoryBudget(std::optional<size_t> bytes)
+{
+	{
+		std::unique_lock<std::mutex> lock(budgetMutex);
+		totalMemoryBudget = bytes;
+	}
+	enforceMemoryBudget();
+}
+
+std::optional<size_t> Resources::getTotalMemoryBudget() const
+{
+	std::unique_lock<std::mutex> lock(budgetMutex);
+	return totalMemoryBudget;
+}
+
+size_t Resources::trimMemory(std::optional<size_t> targetBytes)
+{
+	const size_t target = targetBytes ? *targetBytes : getTotalMemoryBudget().value_or(0);
+	if (residentBytes <= target) {
+		return 0;
+	}
+	const size_t excess = residentBytes - target;
+
+	Vector<ResourceCollectionBase::EvictionCandidate> candidates;
+	for (auto& collection: resources) {
+		if (collection) {
+			collection->getEvictionCandidates(candidates);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) { return a.lastAccess < b.lastAccess; });
+
+	size_t freed = 0;
+	for (auto& c: candidates) {
+		if (freed >= excess) {
+			break;
+		}
+		if (c.collection->evict(c.assetId)) {
+			freed += c.size;
+		}
+	}
+	return freed;
+}
+
+void Resources::enforceMemoryBudget()
+{
+	const auto budget = getTotalMemoryBudget();
+	if (budget && residentBytes > *budget) {
+		trimMemory(*budget);
+	}
+}
+
+ResourceCollectionStats Resources::getStats() const
+{
+	ResourceCollectionStats total;
+	for (auto& collection: resources) {
+		if (collection) {
+			total += collection->getStats();
+		}
+	}
+	return total;
+}
+
+Resources::~Resources()
+{
+	for (auto& collection: resources) {
+		if (collection) {
+			collection->waitForPendingLoads();
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <memory>
+#include <cstddef>
+#include <halley/data_structures/vector.h>
+#include <halley/data_structures/tree_map.h>
+#include "family_mask.h"
+
+namespace Halley {
+	class Entity;
+	class Archetype;
+	class ComponentDeleterTable;
+	class Component;
+
+	// A fixed-capacity block of entities sharing an archetype, with each component type stored in its own contiguous array (SoA)
+	class ArchetypeChunk {
+	public:
+		ArchetypeChunk(const Archetype& archetype, size_t capacity, size_t bytes);
+
+		ArchetypeChunk(const ArchetypeChunk& other) = delete;
+		ArchetypeChunk& operator=(const ArchetypeChunk& other) = delete;
+		ArchetypeChunk(ArchetypeChunk&& other) noexcept = default;
+		ArchetypeChunk& operator=(ArchetypeChunk&& other) noexcept = default;
+
+		// Number of slots in use, including holes left by removed entities
+		size_t size() const { return used; }
+		size_t capacity() const { return entities.size(); }
+		bool isFull() const { return used == entities.size(); }
+
+		// Returns nullptr if the slot is a hole; its components must not be touched in that case
+		Entity* getEntity(size_t idx) const { return entities[idx]; }
+
+		template <typename T>
+		T* getComponents() const
+		{
+			return static_cast<T*>(getColumn(T::componentIndex));
+		}
+
+		void* getColumn(int componentId) const;
+		void* getComponent(int componentId, size_t idx) const;
+
+	private:
+		friend class Archetype;
+
+		const Archetype* archetype;
+		std::unique_ptr<std::byte[]> data;
+		Vector<Entity*> entities;
+		size_t used = 0;
+	};
+
+	class Archetype {
+	public:
+		Archetype(FamilyMaskType mask, Vector<int> componentIds, ComponentDeleterTable& deleterTable);
+
+		Archetype(const Archetype& other) = delete;
+		Archetype& operator=(const Archetype& other) = delete;
+
+		FamilyMaskType getMask() const { return mask; }
+		const Vector<int>& getComponentIds() const { return componentIds; }
+		const Vector<ArchetypeChunk>& getChunks() const { return chunks; }
+		size_t getChunkCapacity() const { return chunkCapacity; }
+
+		uint32_t allocSlot(Entity& entity);
+		void freeSlot(uint32_t slot);
+
+		void* getComponent(int componentId, uint32_t slot) const;
+		bool owns(int componentId, uint32_t slot, const void* component) const;
+
+		int getColumnIndex(int componentId) const
+		{
+			return componentId >= 0 && componentId < int(columnLookup.size()) ? columnLookup[componentId] : -1;
+		}
+
+		size_t getColumnOffset(int column) const { return columnOffsets[column]; }
+		size_t getColumnStride(int column) const { return columnStrides[column]; }
+
+	private:
+		FamilyMaskType mask;
+		Vector<int> componentIds;
+		Vector<int> columnLookup;
+		Vector<size_t> columnOffsets;
+		Vector<size_t> columnStrides;
+		size_t chunkCapacity = 0;
+		size_t chunkBytes = 0;
+
+		Vector<ArchetypeChunk> chunks;
+		Vector<uint32_t> freeSlots;
+	};
+
+	// Keeps the components of entities that share a mask packed together in chunks, rather than individually pooled
+	// Component pointers held by entities and families point into the chunks, so those are never moved once allocated
+	class ArchetypeStorage {
+	public:
+		ArchetypeStorage(MaskStorage& maskStorage, ComponentDeleterTable& deleterTable);
+		~ArchetypeStorage();
+
+		// Moves the entity's live components into the archetype matching its current mask
+		// Returns true if any component pointers changed, which requires families to refresh that entity
+		bool placeEntity(Entity& entity);
+
+		// Releases the entity's slot. Components must have been destroyed already.
+		void removeEntity(Entity& entity);
+
+		size_t getNumArchetypes() const { return archetypes.size(); }
+		const Vector<Archetype*>& getArchetypesContaining(FamilyMaskType mask);
+
+		template <typename F>
+		void forEachChunk(FamilyMaskType mask, F&& f)
+		{
+			for (auto* archetype: getArchetypesContaining(mask)) {
+				for (auto& chunk: archetype->getChunks()) {
+					if (chunk.size() > 0) {
+						f(chunk);
+					}
+				}
+			}
+		}
+
+	private:
+		MaskStorage& maskStorage;
+		ComponentDeleterTable& deleterTable;
+		TreeMap<FamilyMaskType, std::unique_ptr<Archetype>> archetypes;
+		TreeMap<FamilyMaskType, Vector<Archetype*>> matchCache;
+
+		Archetype* getArchetype(const Entity& entity);
+		void relocateComponent(int id, Component*& component, void* dst, const Archetype* srcArchetype, uint32_t srcSlot);
+	};
+}
@@ -18,22 +18,12 @@ namespace Halley {
 	class System;
 	class EntityRef;
 	class Prefab;
+	class Archetype;
 
 	// True if T::onAddedToEntity(EntityRef&) exists
 	template <class, class = void_t<>> struct HasOnAddedToEntityMember : std::false_type {};
 	template <class T> struct HasOnAddedToEntityMember<T, decltype(std::declval<T&>().onAddedToEntity(std::declval<EntityRef&>()))> : std::true_type { };
 	
-	class MessageEntry
-	{
-	public:
-		std::unique_ptr<Message> msg;
-		int type = -1;
-		int age = -1;
-
-		MessageEntry() {}
-		MessageEntry(std::unique_ptr<Message> msg, int type, int age) : msg(std::move(msg)), type(type), age(age) {}
-	};
-
 	class EntityRef;
 	class ConstEntityRef;
 
@@ -43,6 +33,8 @@ namespace Halley {
 		friend class System;
 		friend class EntityRef;
 		friend class ConstEntityRef;
+		friend class ArchetypeStorage;
+		friend class EntityCommandBuffer;
 
 	public:
 		~Entity();
@@ -126,8 +118,9 @@ namespace Halley {
 		FamilyMaskType getMask() const;
 		EntityId getEntityId() const;
 
-		void refresh(MaskStorage& storage, ComponentDeleterTable& table);
-		void destroy();
+		// Returns true if a component was removed and added back, as its pointer changed without changing the mask
+		bool refresh(MaskStorage& storage, ComponentDeleterTable& table);
+		void destroy(World& world);
 		
 		void sortChildrenByPrefabUUIDs(const std::vector<UUID>& uuids);
 
@@ -155,7 +148,6 @@ namespace Halley {
 		Vector<Entity*> children; // Cacheline 1 starts 16 bytes into this
 
 		// Cacheline 1
-		Vector<MessageEntry> inbox;
 		String name;
 
 		// Cacheline 2
@@ -165,6 +157,13 @@ namespace Halley {
 
 		uint8_t hierarchyRevision = 0;
 
+		// Position in the World's entity list, so it can be removed without searching
+		uint32_t worldIndex = 0;
+
+		// Only used if the world has archetype storage enabled
+		Archetype* archetype = nullptr;
+		uint32_t archetypeSlot = 0;
+
 		Entity();
 		void destroyComponents(ComponentDeleterTable& storage);
 
@@ -206,7 +205,7 @@ namespace Halley {
 		void propagateChildrenChange();
 		void propagateChildWorldPartition(uint8_t newWorldPartition);
 
-		void doDestroy(bool updateParenting);
+		void doDestroy(World& world, bool updateParenting);
 
 		bool hasBit(const World& world, int index) const;
 	};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <halley/data_structures/vector.h>
+#include <halley/text/halleystring.h>
+#include <halley/maths/uuid.h>
+#include <halley/data_structures/memory_pool.h>
+#include "entity_id.h"
+#include "entity.h"
+
+namespace Halley {
+	class World;
+
+	// Refers to an entity created earlier in the same command buffer, which won't have an id until it's played back
+	struct PendingEntityId {
+		int index = -1;
+	};
+
+	// Records entity creation/destruction and component changes so they can be made from any thread
+	// The World applies them on the main thread at its next sync point (see World::getCommandBuffer)
+	class EntityCommandBuffer {
+	public:
+		// Either an existing entity or one created in this buffer
+		struct Target {
+			Target(EntityId id) : id(id) {}
+			Target(PendingEntityId pending) : pending(pending.index) {}
+
+			EntityId id;
+			int pending = -1;
+		};
+
+		EntityCommandBuffer() = default;
+		~EntityCommandBuffer();
+
+		EntityCommandBuffer(const EntityCommandBuffer& other) = delete;
+		EntityCommandBuffer& operator=(const EntityCommandBuffer& other) = delete;
+
+		// Commands are played back ordered by sort key, and in recording order within the same key
+		// Buffers from different threads are only deterministic relative to each other if they use distinct keys,
+		// e.g. the index of the element being processed in a parallel loop
+		void setSortKey(uint64_t key) { sortKey = key; }
+
+		PendingEntityId createEntity(String name = "", std::optional<Target> parent = {}, UUID uuid = {});
+		void destroyEntity(Target target);
+
+		template <typename T>
+		void addComponent(Target target, T component)
+		{
+			static_assert(std::is_base_of<Component, T>::value, "Components must extend the Component class");
+
+			auto& cmd = addCommand(CommandType::AddComponent, target);
+			cmd.componentId = T::componentIndex;
+			cmd.component = new T(std::move(component));
+			cmd.addComponent = [] (World& world, EntityRef& e, Component* c)
+			{
+				// Hands over the component allocated when recording, as EntityRef::addComponent does with its own
+				auto* component = static_cast<T*>(c);
+				getRawEntity(world, e).addComponent(world, component);
+				if constexpr (HasOnAddedToEntityMember<T>::value) {
+					component->onAddedToEntity(e);
+				}
+			};
+			cmd.deleteComponent = &deleteComponent<T>;
+		}
+
+		template <typename T>
+		void removeComponent(Target target)
+		{
+			addCommand(CommandType::RemoveComponent, target).componentId = T::componentIndex;
+		}
+
+		bool empty() const { return commands.empty(); }
+		size_t size() const { return commands.size(); }
+		uint64_t getSortKey(size_t idx) const { return commands[idx].sortKey; }
+
+		void execute(World& world, size_t idx);
+		void clear();
+
+	private:
+		enum class CommandType : uint8_t {
+			CreateEntity,
+			DestroyEntity,
+			AddComponent,
+			RemoveComponent
+		};
+
+		struct Command {
+			CommandType type;
+			uint64_t sortKey = 0;
+			Target target;
+			std::optional<Target> parent;
+			int componentId = -1;
+			Component* component = nullptr;
+			void (*addComponent)(World&, EntityRef&, Component*) = nullptr;
+			void (*deleteComponent)(Component*) = nullptr;
+			String name;
+			UUID uuid;
+
+			Command(CommandType type, uint64_t sortKey, Target target) : type(type), sortKey(sortKey), target(target) {}
+		};
+
+		Vector<Command> commands;
+		Vector<EntityId> createdEntities;
+		int numPendingEntities = 0;
+		uint64_t sortKey = 0;
+
+		Command& addCommand(CommandType type, Target target);
+		EntityId resolve(const Target& target) const;
+		static Entity& getRawEntity(World& world, const EntityRef& entity);
+
+		template <typename T>
+		static void deleteComponent(Component* c)
+		{
+			// Components live in the size pools and can't go through delete
+			static_cast<T*>(c)->~T();
+			PoolPool::getPool(sizeof(T))->free(c);
+		}
+	};
+}
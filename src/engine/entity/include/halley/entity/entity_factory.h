@@ -5,6 +5,7 @@
 #include "prefab.h"
 #include "halley/file_formats/config_file.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/data_structures/hash_map.h"
 #include "halley/entity/entity.h"
 
 namespace Halley {
@@ -100,6 +101,7 @@ namespace Halley {
 		EntityId getEntityIdFromUUID(const UUID& uuid) const;
 
 		void addEntity(EntityRef entity);
+		void onPrefabUUIDChanged(EntityRef entity, const UUID& oldPrefabUUID);
 		void notifyEntity(const EntityRef& entity) const;
 		EntityRef getEntity(const UUID& uuid, bool allowPrefabUUID) const;
 
@@ -115,7 +117,8 @@ namespace Halley {
 		std::shared_ptr<const Prefab> prefab;
 		World* world;
 		EntityScene* scene;
-		std::vector<EntityRef> entities;
+		HashMap<UUID, EntityRef> entitiesByInstanceUUID;
+		HashMap<UUID, Vector<EntityRef>> entitiesByPrefabUUID; // In the order they were added, as the first one wins
 		bool update = false;
 
 		const IEntityData* entityData = nullptr;
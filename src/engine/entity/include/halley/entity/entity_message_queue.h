@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <cstddef>
+#include <gsl/span>
+#include <gsl/gsl_assert>
+#include <halley/data_structures/vector.h>
+#include "entity_id.h"
+#include "message.h"
+
+namespace Halley {
+	// Entity messages of a single type sent by a single system
+	// Messages are constructed in place in blocks that are kept between frames, so steady-state sending doesn't allocate
+	// Messages sent during an update stay pending until published, and remain visible until the next purge
+	class EntityMessageQueue {
+	public:
+		EntityMessageQueue(int messageType, size_t messageSize, size_t messageAlignment);
+		~EntityMessageQueue();
+
+		EntityMessageQueue(const EntityMessageQueue& other) = delete;
+		EntityMessageQueue& operator=(const EntityMessageQueue& other) = delete;
+
+		int getMessageType() const { return messageType; }
+
+		template <typename T>
+		void push(EntityId target, T msg)
+		{
+			Expects(sizeof(T) <= stride);
+			auto& buffer = buffers[1 - published];
+			buffer.messages.push_back(::new (allocate(buffer)) T(std::move(msg)));
+			buffer.targets.push_back(target);
+		}
+
+		// Makes pending messages visible to receivers. Must be purged first.
+		void publish();
+
+		// Destroys all published messages, keeping their memory around
+		void purge();
+
+		bool empty() const { return buffers[published].messages.empty(); }
+		gsl::span<Message* const> getMessages() const { return buffers[published].messages; }
+		gsl::span<const EntityId> getTargets() const { return buffers[published].targets; }
+
+	private:
+		struct Buffer {
+			Vector<std::unique_ptr<std::byte[]>> blocks;
+			Vector<Message*> messages;
+			Vector<EntityId> targets;
+		};
+
+		int messageType;
+		size_t stride;
+		size_t messagesPerBlock;
+		std::array<Buffer, 2> buffers;
+		int published = 0;
+
+		void* allocate(Buffer& buffer);
+		static void clear(Buffer& buffer);
+	};
+}
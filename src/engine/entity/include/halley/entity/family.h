@@ -1,11 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
+#include <optional>
 #include <gsl/gsl_assert>
 #include "family_type.h"
 #include "family_mask.h"
 #include "entity_id.h"
+#include "archetype_storage.h"
 #include "halley/data_structures/nullable_reference.h"
+#include "halley/data_structures/hash_map.h"
 #include "halley/support/exception.h"
 #include "halley/support/debug.h"
 #include "halley/utils/utils.h"
@@ -31,6 +35,15 @@ namespace Halley {
 			return static_cast<char*>(elems) + (n * elemSize);
 		}
 
+		std::optional<size_t> tryGetIndex(EntityId id) const
+		{
+			const auto iter = indices.find(id);
+			if (iter != indices.end()) {
+				return iter->second;
+			}
+			return std::nullopt;
+		}
+
 		void addOnEntitiesAdded(FamilyBindingBase* bind);
 		void removeOnEntityAdded(FamilyBindingBase* bind);
 		void addOnEntitiesRemoved(FamilyBindingBase* bind);
@@ -42,10 +55,20 @@ namespace Halley {
 		void notifyRemove(void* entities, size_t count);
 		void notifyReload(void* entities, size_t count);
 
+		// Iterates the contiguous archetype chunks of every entity matching this family
+		// Does nothing unless the World has archetype storage enabled
+		template <typename F>
+		void forEachChunk(F&& f) const
+		{
+			if (archetypeStorage) {
+				archetypeStorage->forEachChunk(inclusionMask, std::forward<F>(f));
+			}
+		}
+
 	protected:
 		virtual void addEntity(Entity& entity) = 0;
 		virtual void refreshEntity(Entity& entity) = 0;
-		void removeEntity(Entity& entity);
+		virtual void removeEntity(Entity& entity) = 0;
 		void reloadEntity(Entity& entity);
 		virtual void updateEntities() = 0;
 		virtual void clearEntities() = 0;
@@ -53,7 +76,7 @@ namespace Halley {
 		void* elems = nullptr;
 		size_t elemCount = 0;
 		size_t elemSize = 0;
-		Vector<EntityId> toRemove;
+		HashMap<EntityId, size_t> indices;
 		Vector<EntityId> toReload;
 
 		Vector<FamilyBindingBase*> addEntityCallbacks;
@@ -63,6 +86,7 @@ namespace Halley {
 	private:
 		FamilyMaskType inclusionMask;
 		FamilyMaskType optionalMask;
+		ArchetypeStorage* archetypeStorage = nullptr;
 	};
 
 	class FamilyBase {
@@ -116,6 +140,7 @@ namespace Halley {
 	protected:
 		void addEntity(Entity& entity) override
 		{
+			indices[entity.getEntityId()] = entities.size();
 			auto& e = entities.emplace_back();
 			e.entityId = entity.getEntityId();
 			T::Type::loadComponents(entity, &e.data[0]);
@@ -125,11 +150,19 @@ namespace Halley {
 		
 		void refreshEntity(Entity& entity) override
 		{
-			for (auto& e: entities) {
-				if (e.entityId == entity.getEntityId()) {
-					T::Type::loadComponents(entity, &e.data[0]);
-					break;
-				}
+			const auto iter = indices.find(entity.getEntityId());
+			if (iter != indices.end()) {
+				T::Type::loadComponents(entity, &entities[iter->second].data[0]);
+			}
+		}
+
+		void removeEntity(Entity& entity) override
+		{
+			// Resolve the index now, so that re-adding the same entity before the update doesn't confuse the two
+			const auto iter = indices.find(entity.getEntityId());
+			if (iter != indices.end()) {
+				toRemove.push_back(iter->second);
+				indices.erase(iter);
 			}
 		}
 
@@ -152,10 +185,11 @@ namespace Halley {
 			if (!toReload.empty()) {
 				// Notify reloads
 				HALLEY_DEBUG_TRACE();
-				std::vector<StorageType*> reloadedEntities;
-				for (auto& entity : entities) {
-					if (std::find(toReload.begin(), toReload.end(), entity.entityId) != toReload.end()) {
-						reloadedEntities.push_back(&entity);
+				reloadedEntities.clear();
+				for (auto& id: toReload) {
+					const auto iter = indices.find(id);
+					if (iter != indices.end()) {
+						reloadedEntities.push_back(&entities[iter->second]);
 					}
 				}
 				notifyReload(reloadedEntities.data(), reloadedEntities.size());
@@ -170,11 +204,15 @@ namespace Halley {
 		{
 			notifyRemove(entities.data(), entities.size());
 			entities.clear();
+			indices.clear();
+			toRemove.clear();
 			updateElems();
 		}
 
 	private:
 		Vector<StorageType> entities;
+		Vector<size_t> toRemove;
+		Vector<StorageType*> reloadedEntities;
 		bool dirty = false;
 
 		void updateElems()
@@ -187,46 +225,29 @@ namespace Halley {
 		void removeDeadEntities()
 		{
 			// Performance-critical code
-			// Benchmarks suggest that using a Vector is faster than std::set and std::unordered_set
 			if (!toRemove.empty()) {
 				HALLEY_DEBUG_TRACE();
-				size_t removeCount = toRemove.size();
-				Expects(removeCount > 0);
+				const size_t removeCount = toRemove.size();
 				Expects(removeCount <= entities.size());
-				std::sort(toRemove.begin(), toRemove.end());
-
-				for (size_t i = 1; i < toRemove.size(); ++i) {
-					Expects(toRemove[i - 1] != toRemove[i]);
-				}
 
-				// Move all entities to be removed to the back of the vector
-				{
-					int n = int(entities.size());
-					// Note: it's important to scan it forward. Scanning backwards would improve performance for short-lived entities,
-					// but it causes an issue where an entity is removed and added to the same family in one frame.
-					for (int i = 0; i < n; i++) {
-						EntityId id = entities[i].entityId;
-						auto iter = std::lower_bound(toRemove.begin(), toRemove.end(), id);
-						if (iter != toRemove.end() && id == *iter) {
-							toRemove.erase(iter);
-							if (i != n - 1) {
-								std::swap(entities[i], entities[n - 1]);
-								i--;
-							}
-							n--;
-							if (toRemove.empty()) {
-								break;
-							}
-						}
+				// Going from the highest index down, swap each one with the last live entity
+				// Anything past the current index is either live or already moved out, so this never displaces an entity still to be removed
+				std::sort(toRemove.begin(), toRemove.end(), std::greater<>());
+				size_t n = entities.size();
+				for (size_t i = 0; i < removeCount; ++i) {
+					const size_t idx = toRemove[i];
+					Expects(i == 0 || toRemove[i - 1] != idx);
+					--n;
+					if (idx != n) {
+						std::swap(entities[idx], entities[n]);
+						indices[entities[idx].entityId] = idx;
 					}
-					Ensures(size_t(n) + removeCount == entities.size());
 				}
-
-				Expects(toRemove.empty());
+				toRemove.clear();
 
 				// Notify removal
-				size_t newSize = entities.size() - removeCount;
-				Ensures(newSize < entities.size());
+				const size_t newSize = entities.size() - removeCount;
+				Ensures(newSize == n);
 				notifyRemove(entities.data() + newSize, removeCount);
 
 				// Remove them
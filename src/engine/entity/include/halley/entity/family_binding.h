@@ -14,6 +14,9 @@ namespace Halley {
 		size_t count() const { return family->count(); }
 		size_t size() const { return family->count(); }
 
+		template <typename F>
+		void forEachChunk(F&& f) const { family->forEachChunk(std::forward<F>(f)); }
+
 		~FamilyBindingBase();
 
 	protected:
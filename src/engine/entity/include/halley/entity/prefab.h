@@ -8,6 +8,7 @@ namespace Halley {
 	public:
 		static std::unique_ptr<Prefab> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Prefab; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 
 		void reload(Resource&& resource) override;
 		void makeDefault();
@@ -66,6 +67,7 @@ namespace Halley {
 	public:
 		static std::unique_ptr<Scene> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Scene; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 
 		bool isScene() const override;
 		
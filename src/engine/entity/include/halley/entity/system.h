@@ -10,6 +10,7 @@
 #include "entity.h"
 #include "halley/utils/type_traits.h"
 #include "system_message.h"
+#include "entity_message_queue.h"
 
 namespace Halley {
 	class Message;
@@ -33,12 +34,36 @@ namespace Halley {
 	// True if T::onEntityModified() exists
 	template <class, class, class = Halley::void_t<>> struct HasOnEntitiesReloaded : std::false_type {};
 	template <class T, class F> struct HasOnEntitiesReloaded<T, F, decltype(std::declval<T>().onEntitiesReloaded(std::declval<Span<F*>>()))> : std::true_type {};
+
+	// Same values as the access flags in the system schema, plus message usage
+	enum class SystemDependencyFlags : int {
+		None = 0,
+		API = 1,
+		World = 2,
+		Resources = 4,
+		Messages = 8
+	};
+
+	// What a system touches during update, used to decide which systems can run concurrently
+	// Systems that never declare their dependencies are always run on their own
+	class SystemDependencies
+	{
+	public:
+		Vector<int> componentsRead;
+		Vector<int> componentsWritten;
+		Vector<String> services;
+		int flags = 0;
+		bool declared = false;
+
+		bool isExclusive() const;
+		bool conflictsWith(const SystemDependencies& other) const;
+	};
 	
 	class System
 	{
 	public:
 		System(Vector<FamilyBindingBase*> families, Vector<int> messageTypesReceived);
-		virtual ~System() {}
+		virtual ~System();
 
 		const String& getName() const { return name; }
 		void setName(String n) { name = std::move(n); }
@@ -57,6 +82,8 @@ namespace Halley {
 		void processSystemMessages();
 		size_t getSystemMessagesInInbox() const;
 
+		const SystemDependencies& getDependencies() const { return dependencies; }
+
 	protected:
 		const HalleyAPI& doGetAPI() const { return *api; }
 		World& doGetWorld() const { return *world; }
@@ -69,6 +96,8 @@ namespace Halley {
 		virtual void onMessagesReceived(int, Message**, size_t*, size_t) {}
 		virtual void onSystemMessageReceived(int messageId, SystemMessage& msg, const std::function<void(std::byte*)>& callback) {}
 
+		void declareDependencies(Vector<int> componentsRead, Vector<int> componentsWritten, Vector<String> services, int flags);
+
 		template <typename F, typename V>
 		static void invokeIndividual(F&& f, V& fam)
 		{
@@ -88,9 +117,7 @@ namespace Halley {
 		template <typename T>
 		void sendMessageGeneric(EntityId entityId, T msg)
 		{
-			auto toSend = std::make_unique<T>();
-			*toSend = std::move(msg);
-			doSendMessage(entityId, std::move(toSend), T::messageIndex);
+			getMessageQueue(T::messageIndex, sizeof(T), alignof(T)).push(entityId, std::move(msg));
 		}
 
 		template <typename T, typename R, typename F>
@@ -179,8 +206,9 @@ namespace Halley {
 
 		Vector<FamilyBindingBase*> families;
 		Vector<int> messageTypesReceived;
-		Vector<EntityId> messagesSentTo;
-		Vector<std::pair<EntityId, MessageEntry>> outbox;
+		Vector<std::unique_ptr<EntityMessageQueue>> messageQueues; // Indexed by message type
+		Vector<Message*> receivedMessages;
+		Vector<size_t> receivedIndices;
 		Vector<const SystemMessageContext*> systemMessageInbox;
 		Vector<const SystemMessageContext*> systemMessages;
 
@@ -193,6 +221,7 @@ namespace Halley {
 		bool collectSamples = false;
 
 		StopwatchRollingAveraging timer;
+		SystemDependencies dependencies;
 
 		void doUpdate(Time time);
 		void doRender(RenderContext& rc);
@@ -200,7 +229,7 @@ namespace Halley {
 
 		void purgeMessages();
 		void processMessages();
-		void doSendMessage(EntityId target, std::unique_ptr<Message> msg, int msgId);
+		EntityMessageQueue& getMessageQueue(int msgId, size_t size, size_t alignment);
 		size_t doSendSystemMessage(SystemMessageContext context, const String& targetSystem);
 		void dispatchMessages();
 	};
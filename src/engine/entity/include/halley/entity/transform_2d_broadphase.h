@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <halley/data_structures/broadphase_2d.h>
+#include <halley/data_structures/hash_map.h>
+#include "entity_id.h"
+
+namespace Halley {
+	// Keeps a Broadphase2D in step with a family that has a Transform2DComponent (as the transform2D member), using the entity ids as broadphase ids
+	// Entities are only re-inserted when their transform revision changes, so static ones cost a hash lookup per sync
+	template <typename T>
+	class Transform2DBroadphaseSync {
+	public:
+		using GetBounds = std::function<Rect4f(const T& element)>;
+
+		// If no bounds function is given, each entity is a point at its global position
+		explicit Transform2DBroadphaseSync(Broadphase2D& broadphase, GetBounds getBounds = {})
+			: broadphase(broadphase)
+			, getBounds(std::move(getBounds))
+		{}
+
+		// Call once per frame (or whenever the broadphase is about to be queried), before any queries
+		// Set force if the bounds depend on something other than the transform (e.g. the sprite changed size)
+		template <typename FamilyRange>
+		void sync(const FamilyRange& family, bool force = false)
+		{
+			++generation;
+
+			for (const auto& e: family) {
+				const auto id = static_cast<Broadphase2D::Id>(e.entityId.value);
+				const auto revision = e.transform2D.getRevision();
+				auto iter = tracked.find(id);
+				const bool added = iter == tracked.end();
+				if (added) {
+					iter = tracked.insert(std::make_pair(id, Tracked{ revision, generation })).first;
+				}
+				auto& state = iter->second;
+
+				if (added || force || state.revision != revision) {
+					broadphase.update(id, computeBounds(e));
+					state.revision = revision;
+				}
+				state.generation = generation;
+			}
+
+			// Anything not seen this time has left the family
+			for (auto iter = tracked.begin(); iter != tracked.end(); ) {
+				if (iter->second.generation != generation) {
+					broadphase.remove(iter->first);
+					iter = tracked.erase(iter);
+				} else {
+					++iter;
+				}
+			}
+		}
+
+		void clear()
+		{
+			for (const auto& [id, state]: tracked) {
+				broadphase.remove(id);
+			}
+			tracked.clear();
+		}
+
+		static EntityId toEntityId(Broadphase2D::Id id)
+		{
+			EntityId result;
+			result.value = static_cast<decltype(result.value)>(id);
+			return result;
+		}
+
+	private:
+		struct Tracked {
+			uint32_t revision = 0;
+			uint32_t generation = 0;
+		};
+
+		Broadphase2D& broadphase;
+		GetBounds getBounds;
+		HashMap<Broadphase2D::Id, Tracked> tracked;
+		uint32_t generation = 0;
+
+		Rect4f computeBounds(const T& e) const
+		{
+			if (getBounds) {
+				return getBounds(e);
+			}
+			const auto pos = e.transform2D.getGlobalPosition();
+			return Rect4f(pos, pos);
+		}
+	};
+}
@@ -3,28 +3,37 @@
 #include <memory>
 #include <typeinfo>
 #include <type_traits>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <gsl/span>
 #include "entity_id.h"
 #include "family_mask.h"
 #include "family.h"
+#include "archetype_storage.h"
 #include <halley/time/halleytime.h>
 #include <halley/text/halleystring.h>
 #include <halley/data_structures/mapped_pool.h>
 #include <halley/time/stopwatch.h>
 #include <halley/data_structures/vector.h>
 #include <halley/data_structures/tree_map.h>
+#include <halley/data_structures/flat_map.h>
+#include <halley/data_structures/hash_map.h>
+#include <halley/maths/uuid.h>
 #include "service.h"
 #include "create_functions.h"
 #include "halley/utils/attributes.h"
 
 namespace Halley {
 	struct SystemMessageContext;
-	class UUID;
 	class ConfigNode;
 	class RenderContext;
 	class Entity;
 	class System;
 	class Painter;
 	class HalleyAPI;
+	class EntityMessageQueue;
+	class EntityCommandBuffer;
 
 	class World
 	{
@@ -81,6 +90,11 @@ namespace Halley {
 		void destroyEntity(EntityId id);
 		void destroyEntity(EntityRef entity);
 
+		// The calling thread's command buffer for this world, for structural changes made off the main thread
+		// Buffers are played back on the main thread after each system update, merged by their sort keys
+		EntityCommandBuffer& getCommandBuffer();
+		void playbackCommandBuffers();
+
 		EntityRef getEntity(EntityId id);
 		ConstEntityRef getEntity(EntityId id) const;
 		EntityRef tryGetEntity(EntityId id);
@@ -97,9 +111,9 @@ namespace Halley {
 
 		void spawnPending(); // Warning: use with care, will invalidate entities
 
-		void onEntityDirty();
+		void onEntityDirty(Entity& entity);
 
-		void setEntityReloaded();
+		void setEntityReloaded(Entity& entity);
 
 		template <typename T>
 		Family& getFamily() noexcept
@@ -128,19 +142,52 @@ namespace Halley {
 		void setEditor(bool isEditor);
 		bool isEditor() const;
 
+		// Packs components of entities sharing a mask into contiguous chunks. Must be set before any entities are created.
+		void setArchetypeStorageEnabled(bool enabled);
+		bool isArchetypeStorageEnabled() const;
+		ArchetypeStorage* getArchetypeStorage() const;
+
+		// Entity messages sent by every system, by message type
+		void addMessageQueue(EntityMessageQueue& queue);
+		void removeMessageQueue(EntityMessageQueue& queue);
+		gsl::span<EntityMessageQueue* const> getMessageQueues(int messageType) const;
+
+		// Runs systems of the same update timeline concurrently when their declared dependencies don't conflict
+		void setParallelSystemsEnabled(bool enabled);
+		bool isParallelSystemsEnabled() const;
+
 	private:
 		const HalleyAPI& api;
 		Resources& resources;
 		std::array<Vector<std::unique_ptr<System>>, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> systems;
+		std::array<Vector<Vector<System*>>, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> systemBatches;
 		CreateComponentFunction createComponent;
 		bool collectMetrics = false;
 		bool entityDirty = false;
-		bool entityReloaded = false;
 		bool editor = false;
+		bool parallelSystems = false;
 		
 		Vector<Entity*> entities;
 		Vector<Entity*> entitiesPendingCreation;
 		MappedPool<Entity*> entityMap;
+		HashMap<UUID, EntityId> uuidMap; // Newest entity with each UUID
+		std::unordered_set<UUID> sharedUUIDs; // UUIDs that were given to more than one entity, which need scanning when the newest is gone
+
+		// Entities that need visiting on the next updateEntities(), so unchanged ones are never touched
+		Vector<Entity*> dirtyEntities;
+		Vector<Entity*> reloadedEntities;
+		Vector<Entity*> entitiesRemoved;
+
+		struct FamilyTodo {
+			FamilyMaskType mask;
+			Vector<std::pair<FamilyMaskType, Entity*>> toAdd;
+			Vector<std::pair<FamilyMaskType, Entity*>> toRemove;
+			Vector<std::pair<FamilyMaskType, Entity*>> toReload;
+		};
+		// Kept across updates so their buffers are reused; only the first familyTodoCount are in use
+		Vector<FamilyTodo> familyTodos;
+		size_t familyTodoCount = 0;
+		FlatMap<FamilyMaskType, size_t> familyTodoIndices;
 
 		//TreeMap<FamilyMaskType, std::unique_ptr<Family>> families;
 		Vector<std::unique_ptr<Family>> families;
@@ -150,20 +197,32 @@ namespace Halley {
 
 		std::shared_ptr<MaskStorage> maskStorage;
 		std::shared_ptr<ComponentDeleterTable> componentDeleterTable;
+		std::unique_ptr<ArchetypeStorage> archetypeStorage;
 
 		mutable std::array<StopwatchRollingAveraging, 3> timer;
 
 		std::list<SystemMessageContext> pendingSystemMessages;
 
+		uint64_t worldSerial;
+		std::mutex commandBuffersMutex;
+		Vector<std::pair<std::thread::id, std::unique_ptr<EntityCommandBuffer>>> commandBuffers;
+		Vector<std::pair<uint64_t, std::pair<EntityCommandBuffer*, size_t>>> commandPlayback;
+		Vector<Vector<EntityMessageQueue*>> messageQueues;
+
 		void allocateEntity(Entity* entity);
 		void updateEntities();
+		FamilyTodo& getFamilyTodo(FamilyMaskType mask);
 		void initSystems();
 
 		void doDestroyEntity(EntityId id);
 		void doDestroyEntity(Entity* entity);
 		void deleteEntity(Entity* entity);
+		bool isSpawned(const Entity& entity) const;
+		Entity* findEntityByScan(const UUID& id, bool includePending, const Entity* exclude) const;
 
 		void updateSystems(TimeLine timeline, Time elapsed);
+		void updateSystemsParallel(TimeLine timeline, Time elapsed);
+		const Vector<Vector<System*>>& getSystemBatches(TimeLine timeline);
 		void renderSystems(RenderContext& rc) const;
 
 		NOINLINE Family& addFamily(std::unique_ptr<Family> family) noexcept;
@@ -2,9 +2,11 @@
 
 namespace Halley {} // Get GitHub to realise this is C++ :3
 
+#include "entity/archetype_storage.h"
 #include "entity/component.h"
 #include "entity/component_reflector.h"
 #include "entity/message.h"
+#include "entity/entity_message_queue.h"
 #include "entity/prefab.h"
 #include "entity/prefab_scene_data.h"
 #include "entity/registry.h"
@@ -16,10 +18,12 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "entity/family_binding.h"
 #include "entity/family.h"
 #include "entity/entity_data.h"
+#include "entity/entity_command_buffer.h"
 #include "entity/entity_data_delta.h"
 #include "entity/entity_scene.h"
 #include "entity/entity_factory.h"
 #include "entity/entity_stage.h"
+#include "entity/transform_2d_broadphase.h"
 
 #include "entity/diagnostics/performance_stats.h"
 #include "entity/diagnostics/world_stats.h"
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include "archetype_storage.h"
+#include "entity.h"
+#include "type_deleter.h"
+#include <halley/data_structures/memory_pool.h>
+#include <halley/support/exception.h>
+#include <halley/utils/utils.h>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t targetChunkBytes = 16 * 1024;
+	constexpr size_t minChunkCapacity = 8;
+	constexpr size_t columnAlignment = alignof(std::max_align_t);
+}
+
+ArchetypeChunk::ArchetypeChunk(const Archetype& archetype, size_t capacity, size_t bytes)
+	: archetype(&archetype)
+	, data(new std::byte[bytes])
+	, entities(capacity, nullptr)
+{
+}
+
+void* ArchetypeChunk::getColumn(int componentId) const
+{
+	const int column = archetype->getColumnIndex(componentId);
+	if (column < 0) {
+		return nullptr;
+	}
+	return data.get() + archetype->getColumnOffset(column);
+}
+
+void* ArchetypeChunk::getComponent(int componentId, size_t idx) const
+{
+	const int column = archetype->getColumnIndex(componentId);
+	if (column < 0) {
+		return nullptr;
+	}
+	return data.get() + archetype->getColumnOffset(column) + idx * archetype->getColumnStride(column);
+}
+
+Archetype::Archetype(FamilyMaskType mask, Vector<int> ids, ComponentDeleterTable& deleterTable)
+	: mask(mask)
+	, componentIds(std::move(ids))
+{
+	std::sort(componentIds.begin(), componentIds.end());
+
+	size_t bytesPerEntity = 0;
+	for (const int id: componentIds) {
+		auto* deleter = deleterTable.get(id);
+		if (deleter->getAlignment() > columnAlignment) {
+			throw Exception("Component " + toString(id) + " is over-aligned and cannot be stored in an archetype.", HalleyExceptions::Entity);
+		}
+		columnStrides.push_back(deleter->getSize());
+		bytesPerEntity += deleter->getSize();
+	}
+	chunkCapacity = std::max(minChunkCapacity, targetChunkBytes / std::max(bytesPerEntity, size_t(1)));
+
+	// Lay out each column back to back, each starting at an aligned offset
+	for (size_t i = 0; i < componentIds.size(); ++i) {
+		columnOffsets.push_back(chunkBytes);
+		chunkBytes = alignUp(chunkBytes + columnStrides[i] * chunkCapacity, columnAlignment);
+	}
+
+	if (!componentIds.empty()) {
+		columnLookup.resize(size_t(componentIds.back()) + 1, -1);
+		for (size_t i = 0; i < componentIds.size(); ++i) {
+			columnLookup[componentIds[i]] = int(i);
+		}
+	}
+}
+
+uint32_t Archetype::allocSlot(Entity& entity)
+{
+	uint32_t slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	} else {
+		if (chunks.empty() || chunks.back().isFull()) {
+			chunks.emplace_back(*this, chunkCapacity, chunkBytes);
+		}
+		auto& chunk = chunks.back();
+		slot = static_cast<uint32_t>((chunks.size() - 1) * chunkCapacity + chunk.used);
+		++chunk.used;
+	}
+
+	chunks[slot / chunkCapacity].entities[slot % chunkCapacity] = &entity;
+	return slot;
+}
+
+void Archetype::freeSlot(uint32_t slot)
+{
+	chunks[slot / chunkCapacity].entities[slot % chunkCapacity] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+void* Archetype::getComponent(int componentId, uint32_t slot) const
+{
+	return chunks[slot / chunkCapacity].getComponent(componentId, slot % chunkCapacity);
+}
+
+bool Archetype::owns(int componentId, uint32_t slot, const void* component) const
+{
+	return getColumnIndex(componentId) >= 0 && getComponent(componentId, slot) == component;
+}
+
+
+ArchetypeStorage::ArchetypeStorage(MaskStorage& maskStorage, ComponentDeleterTable& deleterTable)
+	: maskStorage(maskStorage)
+	, deleterTable(deleterTable)
+{
+}
+
+ArchetypeStorage::~ArchetypeStorage() = default;
+
+bool ArchetypeStorage::placeEntity(Entity& entity)
+{
+	Archetype* target = getArchetype(entity);
+	Archetype* source = entity.archetype;
+	const uint32_t sourceSlot = entity.archetypeSlot;
+
+	if (target == source) {
+		// Same archetype, but components might have been removed and re-added, so bring back any that are outside of the chunk
+		bool relocated = false;
+		if (target) {
+			for (uint8_t i = 0; i < entity.liveComponents; ++i) {
+				auto& [id, component] = entity.components[i];
+				if (!target->owns(id, sourceSlot, component)) {
+					relocateComponent(id, component, target->getComponent(id, sourceSlot), nullptr, 0);
+					relocated = true;
+				}
+			}
+		}
+		return relocated;
+	}
+
+	const uint32_t targetSlot = target ? target->allocSlot(entity) : 0;
+	if (target) {
+		for (uint8_t i = 0; i < entity.liveComponents; ++i) {
+			auto& [id, component] = entity.components[i];
+			relocateComponent(id, component, target->getComponent(id, targetSlot), source, sourceSlot);
+		}
+	}
+	if (source) {
+		source->freeSlot(sourceSlot);
+	}
+
+	entity.archetype = target;
+	entity.archetypeSlot = targetSlot;
+	return true;
+}
+
+void ArchetypeStorage::removeEntity(Entity& entity)
+{
+	if (entity.archetype) {
+		entity.archetype->freeSlot(entity.archetypeSlot);
+		entity.archetype = nullptr;
+		entity.archetypeSlot = 0;
+	}
+}
+
+const Vector<Archetype*>& ArchetypeStorage::getArchetypesContaining(FamilyMaskType mask)
+{
+	const auto iter = matchCache.find(mask);
+	if (iter != matchCache.end()) {
+		return iter->second;
+	}
+
+	Vector<Archetype*> result;
+	for (auto& [archetypeMask, archetype]: archetypes) {
+		if (archetypeMask.contains(mask, maskStorage)) {
+			result.push_back(archetype.get());
+		}
+	}
+	return matchCache[mask] = std::move(result);
+}
+
+Archetype* ArchetypeStorage::getArchetype(const Entity& entity)
+{
+	if (entity.liveComponents == 0) {
+		return nullptr;
+	}
+
+	const auto mask = entity.getMask();
+	const auto iter = archetypes.find(mask);
+	if (iter != archetypes.end()) {
+		return iter->second.get();
+	}
+
+	Vector<int> ids;
+	ids.reserve(entity.liveComponents);
+	for (uint8_t i = 0; i < entity.liveComponents; ++i) {
+		ids.push_back(entity.components[i].first);
+	}
+
+	auto archetype = std::make_unique<Archetype>(mask, std::move(ids), deleterTable);
+	auto* result = archetype.get();
+	archetypes[mask] = std::move(archetype);
+	matchCache.clear();
+	return result;
+}
+
+void ArchetypeStorage::relocateComponent(int id, Component*& component, void* dst, const Archetype* srcArchetype, uint32_t srcSlot)
+{
+	auto* deleter = deleterTable.get(id);
+	deleter->moveConstruct(dst, component);
+	deleter->callDestructor(component);
+
+	// Components that weren't living in a chunk came from the size pools
+	if (!srcArchetype || !srcArchetype->owns(id, srcSlot, component)) {
+		PoolPool::getPool(deleter->getSize())->free(component);
+	}
+
+	component = static_cast<Component*>(dst);
+}
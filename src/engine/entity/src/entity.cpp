@@ -1,5 +1,6 @@
 #include <halley/data_structures/memory_pool.h>
 #include "entity.h"
+#include "archetype_storage.h"
 #include "world.h"
 #include "components/transform_2d_component.h"
 
@@ -83,7 +84,11 @@ void Entity::deleteComponent(Component* component, int id, ComponentDeleterTable
 {
 	TypeDeleterBase* deleter = table.get(id);
 	deleter->callDestructor(component);
-	PoolPool::getPool(deleter->getSize())->free(component);
+
+	// Components living in an archetype chunk are released along with the entity's slot
+	if (!archetype || !archetype->owns(id, archetypeSlot, component)) {
+		PoolPool::getPool(deleter->getSize())->free(component);
+	}
 }
 
 void Entity::keepOnlyComponentsWithIds(const std::vector<int>& ids, World& world)
@@ -107,7 +112,7 @@ void Entity::markDirty(World& world)
 {
 	if (!dirty) {
 		dirty = true;
-		world.onEntityDirty();
+		world.onEntityDirty(*this);
 	}
 }
 
@@ -204,14 +209,17 @@ FamilyMaskType Entity::getMask() const
 	return mask;
 }
 
-void Entity::refresh(MaskStorage& storage, ComponentDeleterTable& table)
+bool Entity::refresh(MaskStorage& storage, ComponentDeleterTable& table)
 {
+	bool replaced = false;
 	if (dirty) {
 		dirty = false;
 
 		// Delete stale components
 		for (size_t i = liveComponents; i < components.size(); ++i) {
-			deleteComponent(components[i].second, components[i].first, table);
+			const int id = components[i].first;
+			replaced = replaced || std::any_of(components.begin(), components.begin() + liveComponents, [&] (const auto& c) { return c.first == id; });
+			deleteComponent(components[i].second, id, table);
 		}
 		components.resize(liveComponents);
 
@@ -227,6 +235,7 @@ void Entity::refresh(MaskStorage& storage, ComponentDeleterTable& table)
 			parent->propagateChildrenChange();
 		}
 	}
+	return replaced;
 }
 
 EntityId Entity::getEntityId() const
@@ -237,9 +246,9 @@ EntityId Entity::getEntityId() const
 	return entityId;
 }
 
-void Entity::destroy()
+void Entity::destroy(World& world)
 {
-	doDestroy(true);
+	doDestroy(world, true);
 }
 
 void Entity::sortChildrenByPrefabUUIDs(const std::vector<UUID>& uuids)
@@ -286,7 +295,7 @@ bool Entity::isEmpty() const
 	return liveComponents == 0 && children.empty();
 }
 
-void Entity::doDestroy(bool updateParenting)
+void Entity::doDestroy(World& world, bool updateParenting)
 {
 	Expects(alive);
 	
@@ -295,12 +304,12 @@ void Entity::doDestroy(bool updateParenting)
 	}
 
 	for (auto& c: children) {
-		c->doDestroy(false);
+		c->doDestroy(world, false);
 	}
 	children.clear();
 	
 	alive = false;
-	dirty = true;
+	markDirty(world);
 }
 
 bool Entity::hasBit(const World& world, int index) const
@@ -311,7 +320,8 @@ bool Entity::hasBit(const World& world, int index) const
 void EntityRef::setReloaded()
 {
 	Expects(entity);
-	entity->reloaded = true;
-
-	world->setEntityReloaded();
+	if (!entity->reloaded) {
+		entity->reloaded = true;
+		world->setEntityReloaded(*entity);
+	}
 }
@@ -0,0 +1,104 @@
+#include "entity_command_buffer.h"
+#include "world.h"
+#include <halley/support/exception.h>
+#include <utility>
+
+using namespace Halley;
+
+EntityCommandBuffer::~EntityCommandBuffer()
+{
+	clear();
+}
+
+PendingEntityId EntityCommandBuffer::createEntity(String name, std::optional<Target> parent, UUID uuid)
+{
+	auto& cmd = addCommand(CommandType::CreateEntity, PendingEntityId{ numPendingEntities });
+	cmd.parent = parent;
+	cmd.name = std::move(name);
+	cmd.uuid = uuid;
+	return PendingEntityId{ numPendingEntities++ };
+}
+
+void EntityCommandBuffer::destroyEntity(Target target)
+{
+	addCommand(CommandType::DestroyEntity, target);
+}
+
+void EntityCommandBuffer::execute(World& world, size_t idx)
+{
+	auto& cmd = commands[idx];
+
+	switch (cmd.type) {
+	case CommandType::CreateEntity:
+		{
+			std::optional<EntityRef> parent;
+			if (cmd.parent) {
+				parent = world.getEntity(resolve(*cmd.parent));
+			}
+			auto entity = world.createEntity(cmd.uuid, std::move(cmd.name), parent);
+			if (createdEntities.size() <= size_t(cmd.target.pending)) {
+				createdEntities.resize(size_t(cmd.target.pending) + 1);
+			}
+			createdEntities[cmd.target.pending] = entity.getEntityId();
+			break;
+		}
+
+	case CommandType::DestroyEntity:
+		{
+			// It might have been destroyed already, e.g. along with its parent
+			const auto id = resolve(cmd.target);
+			const auto* entity = world.tryGetRawEntity(id);
+			if (entity && entity->isAlive()) {
+				world.destroyEntity(id);
+			}
+			break;
+		}
+
+	case CommandType::AddComponent:
+		{
+			// Ownership only passes on once the entity is known to exist, otherwise clear() still deletes it
+			auto entity = world.getEntity(resolve(cmd.target));
+			auto* component = std::exchange(cmd.component, nullptr);
+			cmd.addComponent(world, entity, component);
+			break;
+		}
+
+	case CommandType::RemoveComponent:
+		world.getEntity(resolve(cmd.target)).removeComponentById(cmd.componentId);
+		break;
+	}
+}
+
+void EntityCommandBuffer::clear()
+{
+	for (auto& cmd: commands) {
+		if (cmd.component) {
+			cmd.deleteComponent(cmd.component);
+		}
+	}
+	commands.clear();
+	createdEntities.clear();
+	numPendingEntities = 0;
+	sortKey = 0;
+}
+
+EntityCommandBuffer::Command& EntityCommandBuffer::addCommand(CommandType type, Target target)
+{
+	return commands.emplace_back(type, sortKey, target);
+}
+
+EntityId EntityCommandBuffer::resolve(const Target& target) const
+{
+	if (target.pending < 0) {
+		return target.id;
+	}
+	if (size_t(target.pending) >= createdEntities.size() || !createdEntities[target.pending].isValid()) {
+		throw Exception("Entity command refers to a pending entity before its creation was played back; check the sort keys.", HalleyExceptions::Entity);
+	}
+	return createdEntities[target.pending];
+}
+
+Entity& EntityCommandBuffer::getRawEntity(World& world, const EntityRef& entity)
+{
+	return *world.tryGetRawEntity(entity.getEntityId());
+}
@@ -139,7 +139,30 @@ EntityId EntityFactoryContext::getEntityIdFromUUID(const UUID& uuid) const
 
 void EntityFactoryContext::addEntity(EntityRef entity)
 {
-	entities.push_back(entity);
+	// First one added wins, as when this was a list scanned in order
+	entitiesByInstanceUUID.emplace(entity.getInstanceUUID(), entity);
+	if (entity.getPrefabUUID().isValid()) {
+		entitiesByPrefabUUID[entity.getPrefabUUID()].push_back(entity);
+	}
+}
+
+void EntityFactoryContext::onPrefabUUIDChanged(EntityRef entity, const UUID& oldPrefabUUID)
+{
+	const auto& newPrefabUUID = entity.getPrefabUUID();
+	if (newPrefabUUID == oldPrefabUUID || entitiesByInstanceUUID.find(entity.getInstanceUUID()) == entitiesByInstanceUUID.end()) {
+		return;
+	}
+
+	const auto iter = entitiesByPrefabUUID.find(oldPrefabUUID);
+	if (iter != entitiesByPrefabUUID.end()) {
+		std_ex::erase_if(iter->second, [&] (const EntityRef& e) { return e.getEntityId() == entity.getEntityId(); });
+		if (iter->second.empty()) {
+			entitiesByPrefabUUID.erase(iter);
+		}
+	}
+	if (newPrefabUUID.isValid()) {
+		entitiesByPrefabUUID[newPrefabUUID].push_back(entity);
+	}
 }
 
 EntityRef EntityFactoryContext::getEntity(const UUID& uuid, bool allowPrefabUUID) const
@@ -148,9 +171,14 @@ EntityRef EntityFactoryContext::getEntity(const UUID& uuid, bool allowPrefabUUID
 		return EntityRef();
 	}
 	
-	for (const auto& e: entities) {
-		if (e.getInstanceUUID() == uuid || (allowPrefabUUID && e.getPrefabUUID() == uuid)) {
-			return e;
+	const auto iter = entitiesByInstanceUUID.find(uuid);
+	if (iter != entitiesByInstanceUUID.end()) {
+		return iter->second;
+	}
+	if (allowPrefabUUID) {
+		const auto prefabIter = entitiesByPrefabUUID.find(uuid);
+		if (prefabIter != entitiesByPrefabUUID.end()) {
+			return prefabIter->second.front();
 		}
 	}
 
@@ -259,13 +287,17 @@ void EntityFactory::updateEntityNode(const IEntityData& iData, EntityRef entity,
 		if (delta.getName()) {
 			entity.setName(delta.getName().value());
 		}
-		entity.setPrefab(context->getPrefab(), delta.getPrefabUUID().value_or(entity.getPrefabUUID()));
+		const auto oldPrefabUUID = entity.getPrefabUUID();
+		entity.setPrefab(context->getPrefab(), delta.getPrefabUUID().value_or(oldPrefabUUID));
+		context->onPrefabUUIDChanged(entity, oldPrefabUUID);
 		updateEntityComponentsDelta(entity, delta, *context);
 		updateEntityChildrenDelta(entity, delta, context);
 	} else {
 		const auto& data = iData.asEntityData();
 		entity.setName(data.getName());
-		entity.setPrefab(context->getPrefab(), data.getPrefabUUID());	
+		const auto oldPrefabUUID = entity.getPrefabUUID();
+		entity.setPrefab(context->getPrefab(), data.getPrefabUUID());
+		context->onPrefabUUIDChanged(entity, oldPrefabUUID);
 		updateEntityComponents(entity, data, *context);
 		updateEntityChildren(entity, data, context);
 	}
@@ -0,0 +1,57 @@
+#include "entity_message_queue.h"
+#include <halley/support/exception.h>
+#include <halley/text/string_converter.h>
+#include <halley/utils/utils.h>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t targetBlockBytes = 16 * 1024;
+	constexpr size_t minMessagesPerBlock = 16;
+}
+
+EntityMessageQueue::EntityMessageQueue(int messageType, size_t messageSize, size_t messageAlignment)
+	: messageType(messageType)
+{
+	if (messageAlignment > alignof(std::max_align_t)) {
+		throw Exception("Message " + toString(messageType) + " is over-aligned and cannot be queued.", HalleyExceptions::Entity);
+	}
+	stride = alignUp(messageSize, messageAlignment);
+	messagesPerBlock = std::max(minMessagesPerBlock, targetBlockBytes / stride);
+}
+
+EntityMessageQueue::~EntityMessageQueue()
+{
+	clear(buffers[0]);
+	clear(buffers[1]);
+}
+
+void EntityMessageQueue::publish()
+{
+	Expects(buffers[published].messages.empty());
+	published = 1 - published;
+}
+
+void EntityMessageQueue::purge()
+{
+	clear(buffers[published]);
+}
+
+void* EntityMessageQueue::allocate(Buffer& buffer)
+{
+	const size_t idx = buffer.messages.size();
+	const size_t block = idx / messagesPerBlock;
+	if (block == buffer.blocks.size()) {
+		buffer.blocks.emplace_back(new std::byte[messagesPerBlock * stride]);
+	}
+	return buffer.blocks[block].get() + (idx % messagesPerBlock) * stride;
+}
+
+void EntityMessageQueue::clear(Buffer& buffer)
+{
+	for (auto* msg: buffer.messages) {
+		msg->~Message();
+	}
+	buffer.messages.clear();
+	buffer.targets.clear();
+}
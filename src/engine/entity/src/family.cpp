@@ -61,11 +61,6 @@ void Family::notifyReload(void* entities, size_t count)
 	}
 }
 
-void Family::removeEntity(Entity& entity)
-{
-	toRemove.push_back(entity.getEntityId());
-}
-
 void Family::reloadEntity(Entity& entity)
 {
 	toReload.push_back(entity.getEntityId());
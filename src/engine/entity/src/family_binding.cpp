@@ -10,6 +10,9 @@ FamilyBindingBase::~FamilyBindingBase()
 	if (removedCallback) {
 		family->removeOnEntityRemoved(this);
 	}
+	if (reloadedCallback) {
+		family->removeOnEntitiesReloaded(this);
+	}
 }
 
 void FamilyBindingBase::doInit(FamilyMaskType read, FamilyMaskType write) noexcept
@@ -12,6 +12,45 @@ System::System(Vector<FamilyBindingBase*> uninitializedFamilies, Vector<int> mes
 {
 }
 
+System::~System()
+{
+	if (world) {
+		for (auto& queue: messageQueues) {
+			if (queue) {
+				world->removeMessageQueue(*queue);
+			}
+		}
+	}
+}
+
+bool SystemDependencies::isExclusive() const
+{
+	return !declared || (flags & int(SystemDependencyFlags::World)) != 0;
+}
+
+bool SystemDependencies::conflictsWith(const SystemDependencies& other) const
+{
+	if (isExclusive() || other.isExclusive()) {
+		return true;
+	}
+
+	// API, resources and messaging are treated as a single shared resource each
+	constexpr int sharedFlags = int(SystemDependencyFlags::API) | int(SystemDependencyFlags::Resources) | int(SystemDependencyFlags::Messages);
+	if ((flags & other.flags & sharedFlags) != 0) {
+		return true;
+	}
+
+	const auto intersects = [] (const auto& a, const auto& b)
+	{
+		return std::any_of(a.begin(), a.end(), [&] (const auto& v) { return std::find(b.begin(), b.end(), v) != b.end(); });
+	};
+
+	return intersects(componentsWritten, other.componentsWritten)
+		|| intersects(componentsWritten, other.componentsRead)
+		|| intersects(componentsRead, other.componentsWritten)
+		|| intersects(services, other.services);
+}
+
 size_t System::getEntityCount() const
 {
 	size_t n = 0;
@@ -31,6 +70,15 @@ bool System::tryInit()
 	return false;
 }
 
+void System::declareDependencies(Vector<int> componentsRead, Vector<int> componentsWritten, Vector<String> services, int flags)
+{
+	dependencies.componentsRead = std::move(componentsRead);
+	dependencies.componentsWritten = std::move(componentsWritten);
+	dependencies.services = std::move(services);
+	dependencies.flags = flags;
+	dependencies.declared = true;
+}
+
 void System::setCollectSamples(bool collect)
 {
 	collectSamples = collect;
@@ -47,69 +95,63 @@ void System::onAddedToWorld(World& w, int id) {
 
 void System::purgeMessages()
 {
-	if (!messagesSentTo.empty()) {
-		for (auto& target: messagesSentTo) {
-			// Purge all messages of this age
-			Entity* entity = world->tryGetRawEntity(target);
-
-			if (entity) {
-				std_ex::erase_if(entity->inbox, [&] (const MessageEntry& e) { return e.age == systemId; });
-			}
+	for (auto& queue: messageQueues) {
+		if (queue) {
+			queue->purge();
 		}
-		messagesSentTo.clear();
 	}
 }
 
 void System::processMessages()
 {
-	// This whole method is probably very inefficient.
-	struct MessageBox
-	{
-		Vector<Message*> msg;
-		Vector<size_t> elemIdx;
-	};
-	FlatMap<int, MessageBox> inboxes;
-
-	if (!families.empty()) {
-		auto& fam = *families[0];
-		size_t sz = fam.count();
-		for (size_t i = 0; i < sz; i++) {
-			FamilyBase* elem = reinterpret_cast<FamilyBase*>(fam.getElement(i));
-			Entity* entity = world->tryGetRawEntity(elem->entityId);
-			if (entity) {
-				for (const auto& msg: entity->inbox) {
-					if (std::find(messageTypesReceived.begin(), messageTypesReceived.end(), msg.type) != messageTypesReceived.end()) {
-						auto& inbox = inboxes[msg.type];
-						inbox.msg.emplace_back(msg.msg.get());
-						inbox.elemIdx.emplace_back(i);
-					}
+	if (families.empty()) {
+		return;
+	}
+
+	// Messages are only delivered to entities in the main family, along with their index in it
+	const auto& family = *families[0]->family;
+	for (const int type: messageTypesReceived) {
+		receivedMessages.clear();
+		receivedIndices.clear();
+
+		for (const auto* queue: world->getMessageQueues(type)) {
+			const auto msgs = queue->getMessages();
+			const auto targets = queue->getTargets();
+			for (size_t i = 0; i < msgs.size(); ++i) {
+				if (const auto idx = family.tryGetIndex(targets[i])) {
+					receivedMessages.push_back(msgs[i]);
+					receivedIndices.push_back(*idx);
 				}
 			}
 		}
-		for (auto& iter : inboxes) {
-			int id = iter.first;
-			auto& inbox = iter.second;
-			onMessagesReceived(id, inbox.msg.data(), inbox.elemIdx.data(), inbox.msg.size());
+
+		if (!receivedMessages.empty()) {
+			onMessagesReceived(type, receivedMessages.data(), receivedIndices.data(), receivedMessages.size());
 		}
 	}
 }
 
-void System::doSendMessage(EntityId entityId, std::unique_ptr<Message> msg, int id)
+EntityMessageQueue& System::getMessageQueue(int msgId, size_t size, size_t alignment)
 {
-	outbox.emplace_back(std::make_pair(entityId, MessageEntry(std::move(msg), id, systemId)));
+	Expects(msgId >= 0);
+	if (size_t(msgId) >= messageQueues.size()) {
+		messageQueues.resize(size_t(msgId) + 1);
+	}
+
+	auto& queue = messageQueues[msgId];
+	if (!queue) {
+		queue = std::make_unique<EntityMessageQueue>(msgId, size, alignment);
+		world->addMessageQueue(*queue);
+	}
+	return *queue;
 }
 
 void System::dispatchMessages()
 {
-	if (!outbox.empty()) {
-		for (auto& o: outbox) {
-			Entity* entity = world->tryGetRawEntity(o.first);
-			if (entity) {
-				entity->inbox.emplace_back(std::move(o.second));
-				messagesSentTo.push_back(o.first);
-			}
+	for (auto& queue: messageQueues) {
+		if (queue) {
+			queue->publish();
 		}
-		outbox.clear();
 	}
 }
 
@@ -1,10 +1,13 @@
 #include <iostream>
+#include <atomic>
 #include <chrono>
 #include <halley/support/exception.h>
 #include <halley/data_structures/memory_pool.h>
 #include <halley/utils/utils.h>
+#include <halley/memory/frame_arena.h>
 #include "world.h"
 #include "system.h"
+#include "entity_command_buffer.h"
 #include "family.h"
 #include "halley/text/string_converter.h"
 #include "halley/support/debug.h"
@@ -16,6 +19,16 @@
 
 using namespace Halley;
 
+namespace {
+	std::atomic<uint64_t> nextWorldSerial = 1;
+
+	struct CachedCommandBuffer {
+		uint64_t worldSerial = 0;
+		EntityCommandBuffer* buffer = nullptr;
+	};
+	thread_local CachedCommandBuffer cachedCommandBuffer;
+}
+
 World::World(const HalleyAPI& api, Resources& resources, bool collectMetrics, CreateComponentFunction createComponent)
 	: api(api)
 	, resources(resources)
@@ -23,6 +36,7 @@ World::World(const HalleyAPI& api, Resources& resources, bool collectMetrics, Cr
 	, collectMetrics(collectMetrics)
 	, maskStorage(FamilyMask::MaskStorageInterface::createStorage())
 	, componentDeleterTable(std::make_shared<ComponentDeleterTable>())
+	, worldSerial(nextWorldSerial++)
 {
 	for (auto& t: timer) {
 		t.setNumSamples(isDevMode() ? 300 : 30);
@@ -58,6 +72,8 @@ std::unique_ptr<World> World::make(const HalleyAPI& api, Resources& resources, c
 {
 	auto world = std::make_unique<World>(api, resources, devMode, CreateEntityFunctions::getCreateComponent());
 	const auto& sceneConfig = resources.get<ConfigFile>(sceneName)->getRoot();
+	world->setArchetypeStorageEnabled(sceneConfig["archetypeStorage"].asBool(false));
+	world->setParallelSystemsEnabled(sceneConfig["parallelSystems"].asBool(false));
 	world->loadSystems(sceneConfig, CreateEntityFunctions::getCreateSystem());
 	return world;
 }
@@ -70,6 +86,7 @@ System& World::addSystem(std::unique_ptr<System> system, TimeLine timelineType)
 	auto& ref = *system.get();
 	auto& timeline = getSystems(timelineType);
 	timeline.emplace_back(std::move(system));
+	systemBatches[static_cast<int>(timelineType)].clear();
 	ref.onAddedToWorld(*this, int(timeline.size()));
 	return ref;
 }
@@ -80,6 +97,9 @@ void World::removeSystem(System& system)
 		for (size_t i = 0; i < sys.size(); i++) {
 			if (sys[i].get() == &system) {
 				sys.erase(sys.begin() + i);
+				for (auto& batches: systemBatches) {
+					batches.clear();
+				}
 				return;
 			}
 		}
@@ -197,6 +217,13 @@ EntityRef World::createEntity(UUID uuid, String name, std::optional<EntityRef> p
 
 	entitiesPendingCreation.push_back(entity);
 	allocateEntity(entity);
+	auto& indexed = uuidMap[uuid];
+	if (indexed.isValid()) {
+		if (const auto* prev = tryGetRawEntity(indexed); prev && prev->isAlive()) {
+			sharedUUIDs.insert(uuid);
+		}
+	}
+	indexed = entity->entityId;
 
 	auto e = EntityRef(*entity, *this);
 	e.setName(std::move(name));
@@ -231,8 +258,7 @@ void World::doDestroyEntity(EntityId id)
 
 void World::doDestroyEntity(Entity* e)
 {
-	e->destroy();
-	entityDirty = true;
+	e->destroy(*this);
 }
 
 EntityRef World::getEntity(EntityId id)
@@ -285,21 +311,49 @@ const Entity* World::tryGetRawEntity(EntityId id) const
 
 std::optional<EntityRef> World::findEntity(const UUID& id, bool includePending)
 {
-	for (auto& e: entities) {
-		if (e->getInstanceUUID() == id && e->isAlive()) {
+	const auto iter = uuidMap.find(id);
+	if (iter != uuidMap.end()) {
+		auto* e = tryGetRawEntity(iter->second);
+		if (e && e->isAlive()) {
+			if (includePending || isSpawned(*e)) {
+				return EntityRef(*e, *this);
+			}
+		}
+	}
+
+	if (sharedUUIDs.find(id) != sharedUUIDs.end()) {
+		// The newest one is gone or not spawned yet, but an older one might still be around
+		if (auto* e = findEntityByScan(id, includePending, nullptr)) {
 			return EntityRef(*e, *this);
 		}
 	}
+	
+	return std::optional<EntityRef>();
+}
+
+bool World::isSpawned(const Entity& entity) const
+{
+	// Entities that haven't spawned yet aren't in the entity list
+	return entity.worldIndex < entities.size() && entities[entity.worldIndex] == &entity;
+}
+
+Entity* World::findEntityByScan(const UUID& id, bool includePending, const Entity* exclude) const
+{
+	for (auto* e: entities) {
+		if (e != exclude && e->getInstanceUUID() == id && e->isAlive()) {
+			return e;
+		}
+	}
 
 	if (includePending) {
-		for (auto& e : entitiesPendingCreation) {
-			if (e->getInstanceUUID() == id && e->isAlive()) {
-				return EntityRef(*e, *this);
+		for (auto* e: entitiesPendingCreation) {
+			if (e != exclude && e->getInstanceUUID() == id && e->isAlive()) {
+				return e;
 			}
 		}
 	}
-	
-	return std::optional<EntityRef>();
+
+	return nullptr;
 }
 
 size_t World::numEntities() const
@@ -351,14 +405,100 @@ std::vector<ConstEntityRef> World::getTopLevelEntities() const
 	return result;
 }
 
-void World::onEntityDirty()
+EntityCommandBuffer& World::getCommandBuffer()
 {
+	// Remember the last buffer used by this thread, so the common case doesn't need the lock
+	auto& cached = cachedCommandBuffer;
+	if (cached.worldSerial == worldSerial) {
+		return *cached.buffer;
+	}
+
+	std::lock_guard<std::mutex> lock(commandBuffersMutex);
+	const auto threadId = std::this_thread::get_id();
+	EntityCommandBuffer* buffer = nullptr;
+	for (auto& [id, b]: commandBuffers) {
+		if (id == threadId) {
+			buffer = b.get();
+			break;
+		}
+	}
+	if (!buffer) {
+		buffer = commandBuffers.emplace_back(threadId, std::make_unique<EntityCommandBuffer>()).second.get();
+	}
+
+	cached.worldSerial = worldSerial;
+	cached.buffer = buffer;
+	return *buffer;
+}
+
+void World::playbackCommandBuffers()
+{
+	commandPlayback.clear();
+	{
+		std::lock_guard<std::mutex> lock(commandBuffersMutex);
+		for (auto& [id, buffer]: commandBuffers) {
+			for (size_t i = 0; i < buffer->size(); ++i) {
+				commandPlayback.emplace_back(buffer->getSortKey(i), std::make_pair(buffer.get(), i));
+			}
+		}
+	}
+	if (commandPlayback.empty()) {
+		return;
+	}
+
+	std::stable_sort(commandPlayback.begin(), commandPlayback.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+
+	auto clearBuffers = [&] ()
+	{
+		for (auto& [id, buffer]: commandBuffers) {
+			buffer->clear();
+		}
+		commandPlayback.clear();
+	};
+
+	try {
+		for (auto& [key, cmd]: commandPlayback) {
+			cmd.first->execute(*this, cmd.second);
+		}
+	} catch (...) {
+		clearBuffers();
+		throw;
+	}
+	clearBuffers();
+}
+
+void World::addMessageQueue(EntityMessageQueue& queue)
+{
+	const auto type = size_t(queue.getMessageType());
+	if (type >= messageQueues.size()) {
+		messageQueues.resize(type + 1);
+	}
+	messageQueues[type].push_back(&queue);
+}
+
+void World::removeMessageQueue(EntityMessageQueue& queue)
+{
+	auto& queues = messageQueues.at(size_t(queue.getMessageType()));
+	queues.erase(std::remove(queues.begin(), queues.end(), &queue), queues.end());
+}
+
+gsl::span<EntityMessageQueue* const> World::getMessageQueues(int messageType) const
+{
+	if (messageType < 0 || size_t(messageType) >= messageQueues.size()) {
+		return {};
+	}
+	return messageQueues[messageType];
+}
+
+void World::onEntityDirty(Entity& entity)
+{
+	dirtyEntities.push_back(&entity);
 	entityDirty = true;
 }
 
-void World::setEntityReloaded()
+void World::setEntityReloaded(Entity& entity)
 {
-	entityReloaded = true;
+	reloadedEntities.push_back(&entity);
 	entityDirty = true;
 }
 
@@ -409,10 +549,65 @@ bool World::isEditor() const
 	return editor;
 }
 
+void World::setArchetypeStorageEnabled(bool enabled)
+{
+	if (enabled == isArchetypeStorageEnabled()) {
+		return;
+	}
+	if (!entities.empty() || !entitiesPendingCreation.empty()) {
+		throw Exception("Archetype storage must be set before any entities are created.", HalleyExceptions::Entity);
+	}
+
+	archetypeStorage = enabled ? std::make_unique<ArchetypeStorage>(*maskStorage, *componentDeleterTable) : std::unique_ptr<ArchetypeStorage>();
+	for (auto& family: families) {
+		family->archetypeStorage = archetypeStorage.get();
+	}
+}
+
+bool World::isArchetypeStorageEnabled() const
+{
+	return static_cast<bool>(archetypeStorage);
+}
+
+ArchetypeStorage* World::getArchetypeStorage() const
+{
+	return archetypeStorage.get();
+}
+
+void World::setParallelSystemsEnabled(bool enabled)
+{
+	parallelSystems = enabled;
+}
+
+bool World::isParallelSystemsEnabled() const
+{
+	return parallelSystems;
+}
+
 void World::deleteEntity(Entity* entity)
 {
 	Expects (entity);
+
+	// Only drop the index entry if it wasn't taken over by another entity with the same UUID
+	const auto uuidIter = uuidMap.find(entity->instanceUUID);
+	if (uuidIter != uuidMap.end() && uuidIter->second == entity->entityId) {
+		uuidMap.erase(uuidIter);
+
+		// Hand the entry over to an older entity with the same UUID, if any is left
+		const auto sharedIter = sharedUUIDs.find(entity->instanceUUID);
+		if (sharedIter != sharedUUIDs.end()) {
+			if (const auto* other = findEntityByScan(entity->instanceUUID, true, entity)) {
+				uuidMap[entity->instanceUUID] = other->entityId;
+			} else {
+				sharedUUIDs.erase(sharedIter);
+			}
+		}
+	}
+
 	entity->destroyComponents(*componentDeleterTable);
+	if (archetypeStorage) {
+		archetypeStorage->removeEntity(*entity);
+	}
 	entity->~Entity();
 	PoolAllocator<Entity>::free(entity);
 }
@@ -434,6 +629,7 @@ void World::step(TimeLine timeline, Time elapsed)
 		t.beginSample();
 	}
 
+	playbackCommandBuffers();
 	spawnPending();
 
 	initSystems();
@@ -472,16 +668,37 @@ void World::spawnPending()
 		HALLEY_DEBUG_TRACE();
 		for (auto& e : entitiesPendingCreation) {
 			e->onReady();
+			e->worldIndex = static_cast<uint32_t>(entities.size());
+			entities.push_back(e);
 		}
-		std::move(entitiesPendingCreation.begin(), entitiesPendingCreation.end(), std::insert_iterator<decltype(entities)>(entities, entities.end()));
 		entitiesPendingCreation.clear();
-		entityDirty = true;
 		HALLEY_DEBUG_TRACE();
 	}
 
 	updateEntities();
 }
 
+World::FamilyTodo& World::getFamilyTodo(FamilyMaskType mask)
+{
+	const auto iter = familyTodoIndices.find(mask);
+	if (iter != familyTodoIndices.end()) {
+		return familyTodos[iter->second];
+	}
+
+	if (familyTodoCount == familyTodos.size()) {
+		familyTodos.emplace_back();
+	}
+	const size_t idx = familyTodoCount++;
+	familyTodoIndices[mask] = idx;
+
+	auto& todo = familyTodos[idx];
+	todo.mask = mask;
+	todo.toAdd.clear();
+	todo.toRemove.clear();
+	todo.toReload.clear();
+	return todo;
+}
+
 void World::updateEntities()
 {
 	if (!entityDirty) {
@@ -491,87 +708,90 @@ void World::updateEntities()
 	entityDirty = false;
 
 	HALLEY_DEBUG_TRACE();
-	size_t nEntities = entities.size();
-
-	std::vector<size_t> entitiesRemoved;
+	familyTodoCount = 0;
+	familyTodoIndices.clear();
+	entitiesRemoved.clear();
 
-	struct FamilyTodo {
-		std::vector<std::pair<FamilyMaskType, Entity*>> toAdd;
-		std::vector<std::pair<FamilyMaskType, Entity*>> toRemove;
-		std::vector<std::pair<FamilyMaskType, Entity*>> toReload;
-	};
-	std::map<FamilyMaskType, FamilyTodo> pending;
-
-	// Update all entities
+	// Update entities that were marked dirty since the last update
 	// This loop should be as fast as reasonably possible
-	for (size_t i = 0; i < nEntities; i++) {
-		auto& entity = *entities[i];
-		if (i + 20 < nEntities) { // Watch out for sign! Don't subtract!
-			prefetchL2(entities[i + 20]);
+	const size_t nDirty = dirtyEntities.size();
+	for (size_t i = 0; i < nDirty; i++) {
+		auto& entity = *dirtyEntities[i];
+		if (i + 20 < nDirty) { // Watch out for sign! Don't subtract!
+			prefetchL2(dirtyEntities[i + 20]);
 		}
 
-		// Check if it needs any sort of updating
-		if (entity.needsRefresh()) {
-			// First of all, let's check if it's dead
-			if (!entity.isAlive()) {
-				// Remove from systems
-				pending[entity.getMask()].toRemove.emplace_back(FamilyMaskType(), &entity);
-				entitiesRemoved.push_back(i);
-			} else {
-				// It's alive, so check old and new system inclusions
-				FamilyMaskType oldMask = entity.getMask();
-				entity.refresh(*maskStorage, *componentDeleterTable);
-				FamilyMaskType newMask = entity.getMask();
-
-				// Did it change?
-				if (oldMask != newMask) {
-					pending[oldMask].toRemove.emplace_back(newMask, &entity);
-					pending[newMask].toAdd.emplace_back(oldMask, &entity);
-				}
+		// First of all, let's check if it's dead
+		if (!entity.isAlive()) {
+			// Remove from systems
+			getFamilyTodo(entity.getMask()).toRemove.emplace_back(FamilyMaskType(), &entity);
+			entitiesRemoved.push_back(&entity);
+		} else {
+			// It's alive, so check old and new system inclusions
+			FamilyMaskType oldMask = entity.getMask();
+			const bool replaced = entity.refresh(*maskStorage, *componentDeleterTable);
+			FamilyMaskType newMask = entity.getMask();
+			const bool relocated = archetypeStorage && archetypeStorage->placeEntity(entity);
+
+			// Did it change?
+			if (oldMask != newMask) {
+				getFamilyTodo(oldMask).toRemove.emplace_back(newMask, &entity);
+				getFamilyTodo(newMask).toAdd.emplace_back(oldMask, &entity);
+			} else if (replaced || relocated) {
+				// Same families, but their component pointers are stale
+				getFamilyTodo(newMask).toAdd.emplace_back(oldMask, &entity);
 			}
 		}
 	}
+	dirtyEntities.clear();
 
-	if (entityReloaded) {
-		for (size_t i = 0; i < nEntities; i++) {
-			auto& entity = *entities[i];
-			if (entity.reloaded && entity.isAlive()) {
-				pending[entity.getMask()].toReload.emplace_back(entity.getMask(), &entity);
-				entity.reloaded = false;
-			}
+	// Entities that aren't in any family yet keep their flag until they can be delivered
+	size_t nStillReloaded = 0;
+	for (auto* e: reloadedEntities) {
+		auto& entity = *e;
+		if (!isSpawned(entity)) {
+			reloadedEntities[nStillReloaded++] = &entity;
+			continue;
+		}
+		if (entity.isAlive()) {
+			getFamilyTodo(entity.getMask()).toReload.emplace_back(entity.getMask(), &entity);
 		}
+		entity.reloaded = false;
+	}
+	reloadedEntities.resize(nStillReloaded);
+	if (!reloadedEntities.empty()) {
+		entityDirty = true;
 	}
-
-	entityReloaded = false;
 
 	HALLEY_DEBUG_TRACE();
 	// Go through every family adding/removing entities as needed
-	for (auto& todo: pending) {
-		for (auto* fam: getFamiliesFor(todo.first)) {
+	for (size_t i = 0; i < familyTodoCount; ++i) {
+		auto& todo = familyTodos[i];
+		for (auto* fam: getFamiliesFor(todo.mask)) {
 			const auto& famMask = fam->inclusionMask;
 			const auto& optFamMask = fam->optionalMask;
 			auto& ms = *maskStorage;
 			
-			for (auto& e: todo.second.toRemove) {
+			for (auto& e: todo.toRemove) {
 				// Only remove if the entity is not about to be re-added
 				const auto& newMask = e.first;
 				if (!newMask.contains(famMask, ms)) {
 					fam->removeEntity(*e.second);
 				}
 			}
-			for (auto& e: todo.second.toAdd) {
+			for (auto& e: todo.toAdd) {
 				// Only add if the entity was not already in this
 				const auto& oldMask = e.first;
-				const auto& newMask = todo.first;
+				const auto& newMask = todo.mask;
 				if (!oldMask.contains(famMask, ms)) {
 					fam->addEntity(*e.second);
-				} else if (optFamMask.unionChangedBetween(oldMask, newMask, ms)) {
-					// Needs refreshing of optional references
+				} else if (archetypeStorage || oldMask == newMask || optFamMask.unionChangedBetween(oldMask, newMask, ms)) {
+					// Needs refreshing of optional references, or components were replaced or moved to a different archetype
 					fam->refreshEntity(*e.second);
 				}
 			}
 
-			for (auto& e : todo.second.toReload) {
+			for (auto& e : todo.toReload) {
 				fam->reloadEntity(*e.second);
 			}
 		}
@@ -584,22 +804,20 @@ void World::updateEntities()
 	}
 	
 	HALLEY_DEBUG_TRACE();
-	// Actually remove dead entities
-	if (!entitiesRemoved.empty()) {
-		size_t livingEntityCount = entities.size();
-		for (int i = int(entitiesRemoved.size()); --i >= 0; ) {
-			size_t idx = entitiesRemoved[i];
-			auto& entity = *entities[idx];
-
-			// Remove
-			entityMap.freeId(entity.getEntityId().value);
-			deleteEntity(&entity);
-
-			// Put it at the back of the array, so it's removed when the array gets resized
-			std::swap(entities[idx], entities[--livingEntityCount]);
+	// Actually remove dead entities, moving the last entity into each vacated slot
+	for (auto* entity: entitiesRemoved) {
+		const size_t idx = entity->worldIndex;
+		Expects(idx < entities.size() && entities[idx] == entity);
+		if (idx != entities.size() - 1) {
+			entities[idx] = entities.back();
+			entities[idx]->worldIndex = static_cast<uint32_t>(idx);
 		}
-		entities.resize(livingEntityCount);
+		entities.pop_back();
+
+		entityMap.freeId(entity->getEntityId().value);
+		deleteEntity(entity);
 	}
+	entitiesRemoved.clear();
 
 	HALLEY_DEBUG_TRACE();
 }
@@ -618,12 +836,87 @@ void World::initSystems()
 
 void World::updateSystems(TimeLine timeline, Time elapsed)
 {
+	if (parallelSystems && Executors::getCPU().threadCount() > 0) {
+		updateSystemsParallel(timeline, elapsed);
+		return;
+	}
+
 	for (auto& system : getSystems(timeline)) {
 		system->doUpdate(elapsed);
+		playbackCommandBuffers();
+		spawnPending();
+	}
+}
+
+void World::updateSystemsParallel(TimeLine timeline, Time elapsed)
+{
+	for (auto& batch: getSystemBatches(timeline)) {
+		if (batch.size() == 1) {
+			batch[0]->doUpdate(elapsed);
+		} else {
+			// Run the first system on this thread while the others go to the CPU pool
+			FrameVector<std::exception_ptr> errors(batch.size());
+			FrameVector<Future<void>> futures;
+			futures.reserve(batch.size() - 1);
+			for (size_t i = 1; i < batch.size(); ++i) {
+				futures.push_back(Concurrent::execute(Executors::getCPU(), [system = batch[i], elapsed, error = &errors[i]] ()
+				{
+					try {
+						system->doUpdate(elapsed);
+					} catch (...) {
+						*error = std::current_exception();
+					}
+				}));
+			}
+
+			try {
+				batch[0]->doUpdate(elapsed);
+			} catch (...) {
+				errors[0] = std::current_exception();
+			}
+			Concurrent::whenAll(futures.begin(), futures.end()).wait();
+
+			for (auto& error: errors) {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+		}
+
+		// Sync point: structural changes only become visible between batches
+		playbackCommandBuffers();
 		spawnPending();
 	}
 }
 
+const Vector<Vector<System*>>& World::getSystemBatches(TimeLine timeline)
+{
+	auto& batches = systemBatches[static_cast<int>(timeline)];
+	const auto& timelineSystems = getSystems(timeline);
+	if (!batches.empty() || timelineSystems.empty()) {
+		return batches;
+	}
+
+	// Each system goes into the batch right after the last earlier system it conflicts with
+	// This keeps the declared order between any two systems that touch the same data
+	const size_t n = timelineSystems.size();
+	Vector<size_t> level(n, 0);
+	for (size_t j = 0; j < n; ++j) {
+		const auto& deps = timelineSystems[j]->getDependencies();
+		for (size_t i = 0; i < j; ++i) {
+			if (level[i] + 1 > level[j] && deps.conflictsWith(timelineSystems[i]->getDependencies())) {
+				level[j] = level[i] + 1;
+			}
+		}
+		if (level[j] >= batches.size()) {
+			batches.resize(level[j] + 1);
+		}
+		batches[level[j]].push_back(timelineSystems[j].get());
+	}
+
+	return batches;
+}
+
 void World::renderSystems(RenderContext& rc) const
 {
 	for (auto& system : getSystems(TimeLine::Render)) {
@@ -639,6 +932,8 @@ Family& World::addFamily(std::unique_ptr<Family> family) noexcept
 
 void World::onAddFamily(Family& family) noexcept
 {
+	family.archetypeStorage = archetypeStorage.get();
+
 	// Add any existing entities to this new family
 	size_t nEntities = entities.size();
 	for (size_t i = 0; i < nEntities; i++) {
@@ -48,7 +48,11 @@ namespace Halley {
 		};
 	}
 
+	class UIParent;
+
 	class UISizerEntry {
+		friend class UISizer;
+
 	public:
 		UISizerEntry();
 		UISizerEntry(UIElementPtr widget, float proportion, Vector4f border, int fillFlags, Vector2f position);
@@ -78,11 +82,13 @@ namespace Halley {
 		mutable bool enabled = true;
 		Vector4f border;
 		Vector2f position;
+		UIParent* parent = nullptr; // Marked as needing layout when a setter changes something
+
+		void markParentAsNeedingLayout();
 	};
 
 	class UIWidget;
 	class UISizer;
-	class UIParent;
 
 	class IUISizer {
 	public:
@@ -134,6 +140,7 @@ namespace Halley {
 		{
 			std::sort(entries.begin(), entries.end(), f);
 			sortChildrenBySizerOrder();
+			markParentAsNeedingLayout();
 		}
 
 	private:
@@ -148,6 +155,7 @@ namespace Halley {
 		UIParent* curParent = nullptr;
 
 		void reparentEntry(UISizerEntry& entry);
+		void markParentAsNeedingLayout(); // Entries changed, so the parent's cached layout is stale
 		void unparentEntry(UISizerEntry& entry);
 
 		Vector2f computeMinimumSize(bool includeProportional) const;
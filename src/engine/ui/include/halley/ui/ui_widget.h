@@ -164,6 +164,13 @@ namespace Halley {
 		bool needsLayout() const;
 		void markAsNeedingLayout() final override;
 
+		// Static widgets, and everything inside them, skip their per-frame update until something asks for one:
+		// a layout change, being moved, an event reaching one of their handlers, mouse/focus/gamepad interaction, or markAsNeedingUpdate()
+		// Only use it on panels whose update() doesn't poll anything, and that don't rely on validators
+		void setStatic(bool s);
+		bool isStatic() const;
+		void markAsNeedingUpdate() const final override;
+
 		virtual bool canReceiveFocus() const;
 
 		virtual void onAddedToRoot(UIRoot& root);
@@ -239,6 +246,10 @@ namespace Halley {
 
 		mutable Vector2f layoutSize;
 		mutable int layoutNeeded = 1;
+		bool subtreeLayoutNeeded = true; // Unlike layoutNeeded, only cleared once the children have been placed
+		std::optional<Rect4f> lastLayoutRect;
+		Vector2f lastLayoutOrigin;
+		mutable bool updateNeeded = true;
 
 		std::shared_ptr<UIEventHandler> eventHandler;
 		std::shared_ptr<UIValidator> validator;
@@ -264,6 +275,7 @@ namespace Halley {
 		bool destroying = false;
 		bool canSendEvents = true;
 		bool dontClipChildren = false;
+		bool staticWidget = false;
 	};
 
 	template <typename F>
@@ -100,6 +100,8 @@ bool UIParent::isWaitingToSpawnChildren() const
 
 void UIParent::markAsNeedingLayout() {}
 
+void UIParent::markAsNeedingUpdate() const {}
+
 std::vector<std::shared_ptr<UIWidget>>& UIParent::getChildren()
 {
 	/*
@@ -72,6 +72,11 @@ void UIRoot::update(Time t, UIInputType activeInputType, spInputDevice mouse, sp
 
 	updateKeyboardInput();
 
+	if (const auto focus = currentFocus.lock()) {
+		// Focused widgets might be reacting to the keyboard every frame, even inside static panels
+		focus->markAsNeedingUpdate();
+	}
+
 	do {
 		// Spawn new widgets
 		addNewChildren(activeInputType);
@@ -150,6 +155,7 @@ void UIRoot::updateGamepadInput(const spInputDevice& input)
 	}
 
 	for (auto& target: inputTargets) {
+		target->markAsNeedingUpdate();
 		auto& b = *target->gamepadInputButtons;
 		auto& results = target->gamepadInputResults;
 		results.reset();
@@ -364,6 +370,7 @@ void UIRoot::updateMouse(const spInputDevice& mouse)
 	// Mouse position
 	const std::shared_ptr<UIWidget> mousePosTarget = exclusive ? exclusive : actuallyUnderMouse;
 	if (mousePosTarget) {
+		mousePosTarget->markAsNeedingUpdate();
 		mousePosTarget->onMouseOver(mousePos);
 		if (toolTip) {
 			toolTip->showToolTipForWidget(*mousePosTarget, mousePos);
@@ -83,17 +83,33 @@ void UISizerEntry::updateEnabled() const
 
 void UISizerEntry::setBorder(const Vector4f& b)
 {
-	border = b;
+	if (border != b) {
+		border = b;
+		markParentAsNeedingLayout();
+	}
 }
 
 void UISizerEntry::setProportion(float prop)
 {
-	proportion = prop;
+	if (proportion != prop) {
+		proportion = prop;
+		markParentAsNeedingLayout();
+	}
 }
 
 void UISizerEntry::setPosition(Vector2f pos)
 {
-	position = pos;
+	if (position != pos) {
+		position = pos;
+		markParentAsNeedingLayout();
+	}
+}
+
+void UISizerEntry::markParentAsNeedingLayout()
+{
+	if (parent) {
+		parent->markAsNeedingLayout();
+	}
 }
 
 Vector4f UISizerEntry::getBorder() const
@@ -170,21 +186,27 @@ void UISizer::add(std::shared_ptr<IUIElement> element, float proportion, Vector4
 {
 	entries.emplace_back(UISizerEntry(element, proportion, border, fillFlags, position));
 	reparentEntry(entries.back());
+	markParentAsNeedingLayout();
 }
 
 void UISizer::addSpacer(float size)
 {
 	entries.emplace_back(UISizerEntry({}, 0, Vector4f(type == UISizerType::Horizontal ? size : 0.0f, type == UISizerType::Vertical ? size : 0.0f, 0.0f, 0.0f), {}, {}));
+	reparentEntry(entries.back());
+	markParentAsNeedingLayout();
 }
 
 void UISizer::addStretchSpacer(float proportion)
 {
 	entries.emplace_back(UISizerEntry({}, proportion, {}, {}, {}));
+	reparentEntry(entries.back());
+	markParentAsNeedingLayout();
 }
 
 void UISizer::remove(IUIElement& element)
 {
 	entries.erase(std::remove_if(entries.begin(), entries.end(), [&] (const UISizerEntry& e) { return e.getPointer().get() == &element; }), entries.end());
+	markParentAsNeedingLayout();
 }
 
 void UISizer::reparent(UIParent& parent)
@@ -205,6 +227,7 @@ void UISizer::reparent(UIParent& parent)
 
 void UISizer::reparentEntry(UISizerEntry& entry)
 {
+	entry.parent = curParent;
 	if (curParent != nullptr) {
 		auto widget = std::dynamic_pointer_cast<UIWidget>(entry.getPointer());
 		if (widget) {
@@ -258,6 +281,7 @@ void UISizer::updateEnabled() const
 void UISizer::swapItems(int idxA, int idxB)
 {
 	std::swap(entries[idxA], entries[idxB]);
+	markParentAsNeedingLayout();
 }
 
 void UISizer::clear()
@@ -274,6 +298,7 @@ void UISizer::clear()
 		}
 	}
 	entries.clear();
+	markParentAsNeedingLayout();
 }
 
 bool UISizer::isActive() const
@@ -289,6 +314,7 @@ bool UISizer::isActive() const
 void UISizer::setColumnProportions(const std::vector<float>& values)
 {
 	columnProportions = values;
+	markParentAsNeedingLayout();
 }
 
 void UISizer::setEvenColumns()
@@ -297,12 +323,14 @@ void UISizer::setEvenColumns()
 	for (auto& c: columnProportions) {
 		c = 1.0f;
 	}
+	markParentAsNeedingLayout();
 }
 
 
 void UISizer::setRowProportions(const std::vector<float>& values)
 {
 	rowProportions = values;
+	markParentAsNeedingLayout();
 }
 
 Vector2f UISizer::computeMinimumSizeBox(bool includeProportional) const
@@ -609,6 +637,13 @@ float UISizer::getRowProportion(int row) const
 	return 0.0f;
 }
 
+void UISizer::markParentAsNeedingLayout()
+{
+	if (curParent) {
+		curParent->markAsNeedingLayout();
+	}
+}
+
 void UISizer::sortChildrenBySizerOrder()
 {
 	auto& children = curParent->getChildren();
@@ -59,6 +59,11 @@ void UIWidget::doDraw(UIPainter& painter) const
 
 void UIWidget::doUpdate(UIWidgetUpdateType updateType, Time t, UIInputType inputType, JoystickType joystickType)
 {
+	if (staticWidget && !updateNeeded) {
+		return;
+	}
+	updateNeeded = false;
+
 	if (updateType == UIWidgetUpdateType::Full || updateType == UIWidgetUpdateType::First) {
 		setInputType(inputType);
 		setJoystickType(joystickType);
@@ -76,6 +81,10 @@ void UIWidget::doUpdate(UIWidgetUpdateType updateType, Time t, UIInputType input
 
 	if (isActive()) {
 		updateBehaviours(t);
+		if (!behaviours.empty()) {
+			// Behaviours animate over time, so keep static ancestors updating while there are any
+			markAsNeedingUpdate();
+		}
 		update(t, positionUpdated);
 		positionUpdated = false;
 
@@ -137,6 +146,16 @@ Vector2f UIWidget::getLayoutMinimumSize(bool force) const
 void UIWidget::setRect(Rect4f rect)
 {
 	setWidgetRect(rect);
+
+	// If nothing in this subtree changed since it was last placed in the same spot, the children are already where they should be
+	const auto origin = getLayoutOriginPosition();
+	if (!subtreeLayoutNeeded && lastLayoutRect == rect && lastLayoutOrigin == origin) {
+		return;
+	}
+	subtreeLayoutNeeded = false;
+	lastLayoutRect = rect;
+	lastLayoutOrigin = origin;
+
 	if (sizer) {
 		auto border = getInnerBorder();
 		auto p0 = getLayoutOriginPosition();
@@ -343,6 +362,7 @@ void UIWidget::setPosition(Vector2f pos)
 	
 	position = pos;
 	positionUpdated = true;
+	markAsNeedingUpdate();
 }
 
 void UIWidget::setMinSize(Vector2f size)
@@ -365,7 +385,10 @@ void UIWidget::setInnerBorder(Vector4f border)
 
 void UIWidget::setMouseOver(bool mo)
 {
-	mouseOver = mo;
+	if (mouseOver != mo) {
+		mouseOver = mo;
+		markAsNeedingUpdate();
+	}
 }
 
 void UIWidget::pressMouse(Vector2f mousePos, int button)
@@ -622,6 +645,8 @@ void UIWidget::destroy()
 		}
 		if (ok) {
 			forceDestroy();
+		} else {
+			markAsNeedingUpdate(); // Behaviours get to finish first
 		}
 	}
 }
@@ -630,6 +655,7 @@ void UIWidget::forceDestroy()
 {
 	destroying = true;
 	alive = false;
+	markAsNeedingUpdate(); // So the parent gets to remove it
 }
 
 bool UIWidget::isDescendentOf(const UIWidget& ancestor) const
@@ -791,6 +817,7 @@ void UIWidget::sendEvent(UIEvent event) const
 	if (canSendEvents) {
 		if (eventHandler && eventHandler->canHandle(event)) {
 			eventHandler->queue(event);
+			markAsNeedingUpdate();
 		} else if (parent) {
 			parent->sendEvent(std::move(event));
 		}
@@ -801,6 +828,7 @@ void UIWidget::sendEventDown(const UIEvent& event) const
 {
 	if (eventHandler && eventHandler->canHandle(event)) {
 		eventHandler->queue(event);
+		markAsNeedingUpdate();
 	} else {
 		for (const auto& c: getChildren()) {
 			c->sendEventDown(event);
@@ -828,6 +856,8 @@ bool UIWidget::needsLayout() const
 void UIWidget::markAsNeedingLayout()
 {
 	layoutNeeded = 1;
+	subtreeLayoutNeeded = true;
+	updateNeeded = true;
 	if (parent) {
 		parent->markAsNeedingLayout();
 	}
@@ -836,6 +866,26 @@ void UIWidget::markAsNeedingLayout()
 	}
 }
 
+void UIWidget::setStatic(bool s)
+{
+	staticWidget = s;
+	markAsNeedingUpdate();
+}
+
+bool UIWidget::isStatic() const
+{
+	return staticWidget;
+}
+
+void UIWidget::markAsNeedingUpdate() const
+{
+	// Always walks all the way up, as ancestors clear their flag before their children get updated
+	updateNeeded = true;
+	if (parent) {
+		parent->markAsNeedingUpdate();
+	}
+}
+
 bool UIWidget::canReceiveFocus() const
 {
 	return false;
@@ -881,6 +931,9 @@ void UIWidget::setWidgetRect(Rect4f rect)
 		size = rect.getSize();
 		positionUpdated = true;
 	}
+	if (positionUpdated) {
+		markAsNeedingUpdate();
+	}
 }
 
 void UIWidget::resetInputResults()
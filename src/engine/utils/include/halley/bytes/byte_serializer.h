@@ -476,6 +476,7 @@ namespace Halley {
 		}
 
 		size_t getPosition() const { return pos; }
+		size_t getBytesRemaining() const;
 
 	private:
 		size_t pos = 0;
@@ -514,6 +515,5 @@ namespace Halley {
 		void deserializeVariableInteger(uint64_t& val, bool& sign, bool isSigned);
 
 		void ensureSufficientBytesRemaining(size_t bytes);
-		size_t getBytesRemaining() const;
 	};
 }
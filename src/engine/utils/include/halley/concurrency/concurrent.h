@@ -1,6 +1,13 @@
 #pragma once
 #include <array>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
 #include <halley/text/halleystring.h>
 #include "executor.h"
 #include "future.h"
@@ -41,28 +48,130 @@ namespace Halley
 			return future.getFuture();
 		}
 
-		template <typename T, typename F>
-		void foreach(ExecutionQueue& e, T begin, T end, F f)
+		namespace Detail {
+			template <typename F>
+			class ParallelForState {
+			public:
+				ParallelForState(F f, size_t begin, size_t end, size_t minGrainSize, size_t participants)
+					: f(std::move(f))
+					, next(begin)
+					, remaining(end - begin)
+					, end(end)
+					, minGrainSize(minGrainSize)
+					, participants(participants)
+				{}
+
+				void run()
+				{
+					while (true) {
+						// Guided scheduling: grab a share of what's left, so chunks shrink as the work runs out
+						size_t start = next.load();
+						size_t count;
+						do {
+							if (start >= end) {
+								return;
+							}
+							count = std::min(end - start, std::max(minGrainSize, (end - start) / (2 * participants)));
+						} while (!next.compare_exchange_weak(start, start + count));
+
+						// Once something has thrown, the rest of the chunks are only accounted for, not run
+						if (!failed.load()) {
+							try {
+								for (size_t i = start; i < start + count; ++i) {
+									f(i);
+								}
+							} catch (...) {
+								std::unique_lock<std::mutex> lock(mutex);
+								if (!error) {
+									error = std::current_exception();
+								}
+								failed.store(true);
+							}
+						}
+
+						if (remaining.fetch_sub(count) == count) {
+							std::unique_lock<std::mutex> lock(mutex);
+							condition.notify_all();
+						}
+					}
+				}
+
+				void wait()
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					if (ExecutionQueue::isWorkerThread()) {
+						// Keep running other tasks, as the last chunks might be waiting on something queued for this thread (e.g. main thread loads)
+						while (remaining.load() != 0) {
+							lock.unlock();
+							const bool helped = ExecutionQueue::tryHelpOnCurrentThread();
+							lock.lock();
+							if (!helped && remaining.load() != 0) {
+								condition.wait_for(lock, std::chrono::milliseconds(1));
+							}
+						}
+					} else {
+						condition.wait(lock, [&] () { return remaining.load() == 0; });
+					}
+					if (error) {
+						std::rethrow_exception(error);
+					}
+				}
+
+			private:
+				F f;
+				std::atomic<size_t> next;
+				std::atomic<size_t> remaining;
+				std::atomic<bool> failed = false;
+				std::exception_ptr error;
+				size_t end;
+				size_t minGrainSize;
+				size_t participants;
+				std::mutex mutex;
+				std::condition_variable condition;
+			};
+		}
+
+		// Calls f(i) for every i in [begin, end), splitting the range across the queue's threads and the calling thread
+		// If f throws, the first exception is rethrown once every thread has stopped using f; some indices might not have been run
+		template <typename F>
+		void parallelFor(ExecutionQueue& e, size_t begin, size_t end, F f, size_t minGrainSize = 1)
 		{
+			if (end <= begin) {
+				return;
+			}
+
+			minGrainSize = std::max(minGrainSize, size_t(1));
 			const size_t n = end - begin;
-			constexpr size_t maxThreads = 8;
-			size_t nThreads = std::max(size_t(1), std::min(maxThreads, e.threadCount()));
-			std::array<Future<void>, maxThreads> futures;
-
-			size_t prevEnd = 0;
-			for (size_t j = 0; j < nThreads; ++j) {
-				size_t curStart = prevEnd;
-				size_t curEnd = n * (j + 1) / nThreads;
-				prevEnd = curEnd;
-
-				futures[j] = execute([begin, f, curStart, curEnd]() {
-					for (auto i = begin + curStart; i < begin + curEnd; ++i) {
-						f(*i);
-					}
-				});
+			const size_t maxChunks = (n + minGrainSize - 1) / minGrainSize;
+			const size_t nHelpers = std::min(e.threadCount(), maxChunks - 1);
+			if (nHelpers == 0) {
+				for (size_t i = begin; i < end; ++i) {
+					f(i);
+				}
+				return;
 			}
 
-			whenAll(futures.data(), futures.data() + nThreads).wait();
+			// Helpers that only get to run after all work is done simply find nothing left to do, so the state is shared
+			auto state = std::make_shared<Detail::ParallelForState<F>>(std::move(f), begin, end, minGrainSize, nHelpers + 1);
+			for (size_t i = 0; i < nHelpers; ++i) {
+				e.addToQueue([state] () { state->run(); });
+			}
+			state->run();
+			state->wait();
+		}
+
+		template <typename F>
+		void parallelFor(size_t begin, size_t end, F f, size_t minGrainSize = 1)
+		{
+			parallelFor(ExecutionQueue::getDefault(), begin, end, std::move(f), minGrainSize);
+		}
+
+		template <typename T, typename F>
+		void foreach(ExecutionQueue& e, T begin, T end, F f)
+		{
+			parallelFor(e, 0, size_t(end - begin), [begin, f] (size_t i) {
+				f(*(begin + i));
+			});
 		}
 
 		template <typename T, typename F>
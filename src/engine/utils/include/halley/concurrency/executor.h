@@ -6,16 +6,26 @@
 #include <functional>
 #include <atomic>
 #include <vector>
+#include <array>
+#include <memory>
 #include "halley/text/halleystring.h"
 
 namespace Halley
 {
 	using TaskBase = std::function<void()>;
 
+	// Work-stealing task queue
+	// Each worker thread owns a local deque: tasks it spawns go there and are popped LIFO, while idle workers steal FIFO from each other
+	// Tasks coming from threads that aren't workers of this queue go into a shared injection deque
 	class ExecutionQueue
 	{
 	public:
 		ExecutionQueue();
+		~ExecutionQueue();
+
+		ExecutionQueue(const ExecutionQueue& other) = delete;
+		ExecutionQueue& operator=(const ExecutionQueue& other) = delete;
+
 		void addToQueue(TaskBase task);
 
 		TaskBase getNext();
@@ -26,16 +36,46 @@ namespace Halley
 		void onDetached();
 		void abort();
 
+		// Registers the calling thread as a worker, giving it a local deque
+		void attachWorkerThread();
+
+		// Runs one pending task if the calling thread is a worker of some queue and there's anything to run
+		// Used to keep workers busy while they wait on futures, instead of blocking
+		static bool tryHelpOnCurrentThread();
+
+		// Whether the calling thread is a worker of some queue
+		static bool isWorkerThread();
+
+		// How many tasks the calling thread has started on top of the one it was running, by helping while waiting
+		static int getHelpDepth();
+
 		static ExecutionQueue& getDefault();
 
 	private:
-		std::deque<TaskBase> queue;
-		std::mutex mutex;
+		static constexpr size_t maxWorkers = 64;
+
+		struct Worker {
+			std::mutex mutex;
+			std::deque<TaskBase> tasks;
+		};
+
+		Worker injection;
+		std::array<std::unique_ptr<Worker>, maxWorkers> workers;
+		std::atomic<size_t> numWorkers;
+		std::mutex workerRegistrationMutex;
+
+		std::mutex sleepMutex;
 		std::condition_variable condition;
+		std::atomic<int> sleeping;
 
 		std::atomic<int> attachedCount;
-		std::atomic<bool> hasTasks;
+		std::atomic<int> pendingTasks;
 		std::atomic<bool> aborted;
+
+		bool tryGetTask(int workerIdx, TaskBase& task);
+		bool tryPopBack(Worker& worker, TaskBase& task);
+		bool tryPopFront(Worker& worker, TaskBase& task);
+		int getCurrentWorkerIndex() const;
 	};
 
 	class Executors
@@ -43,6 +83,7 @@ namespace Halley
 	public:
 		static Executors& get();
 		static void setInstance(Executors& e);
+		static bool hasInstance() { return instance != nullptr; }
 
 		static ExecutionQueue& getCPU() { return instance->cpu; }
 		static ExecutionQueue& getCPUAux() { return instance->cpuAux; }
@@ -7,6 +7,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 #include <halley/support/exception.h>
 
 namespace Halley
@@ -97,8 +98,23 @@ namespace Halley
 		{
 			if (!available) {
 				std::unique_lock<std::mutex> lock(mutex);
+				if (!ExecutionQueue::isWorkerThread()) {
+					while (!available) {
+						condition.wait(lock);
+					}
+					return;
+				}
+
 				while (!available) {
-					condition.wait(lock);
+					// Worker threads run other pending tasks while they wait, rather than blocking a pool thread
+					// Don't wait on a future while holding a lock that other tasks might take, as they may end up running here
+					lock.unlock();
+					const bool helped = ExecutionQueue::tryHelpOnCurrentThread();
+					lock.lock();
+
+					if (!helped && !available) {
+						condition.wait_for(lock, std::chrono::milliseconds(1));
+					}
 				}
 			}
 		}
@@ -477,7 +493,12 @@ namespace Halley
 
 		auto promise = Promise<R>();
 		data->addContinuation([promise, f, executor](typename TaskHelper<T>::DataType v) mutable {
-			TaskQueueHelper<R>::enqueueOn(executor.get(), MovableFunction<R>(f, std::move(v)), promise);
+			if constexpr (std::is_void_v<T>) {
+				// Continuations of void futures take no arguments
+				TaskQueueHelper<R>::enqueueOn(executor.get(), MovableFunction<R>(std::function<R()>(f)), promise);
+			} else {
+				TaskQueueHelper<R>::enqueueOn(executor.get(), MovableFunction<R>(f, std::move(v)), promise);
+			}
 		});
 		return promise.getFuture();
 	}
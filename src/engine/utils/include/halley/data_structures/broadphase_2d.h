@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <gsl/span>
+#include "halley/maths/rect.h"
+#include "halley/maths/ray.h"
+#include "hash_map.h"
+#include "vector.h"
+
+namespace Halley {
+	class ExecutionQueue;
+
+	// Loose grid of axis-aligned boxes, for finding what's near something without testing every pair
+	// Each box lives in the single cell containing its centre, and queries widen their search by the largest half-size inserted
+	// All queries are const and write into caller-provided buffers, so any number of threads can query at once, as long as nothing modifies it meanwhile
+	class Broadphase2D {
+	public:
+		using Id = uint64_t;
+
+		struct RaycastResult {
+			Id id;
+			float distance;
+		};
+
+		// Cells should be roughly the size of the typical object, or of the typical query, whichever is larger
+		explicit Broadphase2D(float cellSize = 128.0f);
+
+		void add(Id id, Rect4f bounds);
+		void addBulk(gsl::span<const std::pair<Id, Rect4f>> entries);
+		void update(Id id, Rect4f bounds); // Adds it if it's not present
+		bool remove(Id id);
+		void clear();
+
+		// Recomputes the search margin after large objects have been removed or shrunk
+		void shrinkMargin();
+
+		size_t size() const { return entries.size(); }
+		bool contains(Id id) const;
+		std::optional<Rect4f> getBounds(Id id) const;
+
+		// Results are appended to the given vectors, in no particular order
+		void queryOverlaps(Rect4f area, Vector<Id>& results) const;
+		void queryRadius(Vector2f centre, float radius, Vector<Id>& results) const; // Boxes overlapping the circle
+		std::optional<RaycastResult> raycast(Ray ray, float maxDistance) const; // Nearest box hit, ray.dir must be normalised, maxDistance can be infinite
+
+		// Runs many queries in parallel on the queue, results[i] is cleared and then filled for the i-th query
+		void queryOverlaps(gsl::span<const Rect4f> areas, gsl::span<Vector<Id>> results, ExecutionQueue& queue) const;
+		void queryRadius(gsl::span<const std::pair<Vector2f, float>> circles, gsl::span<Vector<Id>> results, ExecutionQueue& queue) const;
+		void raycast(gsl::span<const std::pair<Ray, float>> rays, gsl::span<std::optional<RaycastResult>> results, ExecutionQueue& queue) const;
+
+	private:
+		struct Entry {
+			Rect4f bounds;
+			Id id;
+			Vector2i cell;
+			uint32_t posInCell;
+		};
+
+		float cellSize;
+		float invCellSize;
+		Vector2f margin; // Largest half-size of anything added
+		Vector<Entry> entries;
+		HashMap<Id, uint32_t> idToEntry;
+		HashMap<Vector2i, Vector<uint32_t>> cells;
+		std::optional<Rect4i> occupiedCells; // Contains every non-empty cell, but isn't shrunk as cells empty
+
+		Vector2i getCell(Vector2f pos) const;
+		void insertIntoCell(uint32_t entryIdx);
+		void removeFromCell(uint32_t entryIdx);
+
+		template <typename F>
+		void forEachCandidate(Rect4f area, F f) const;
+	};
+}
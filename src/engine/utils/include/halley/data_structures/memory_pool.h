@@ -1,8 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <mutex>
 #include "flat_map.h"
 
 namespace Halley {
+	// Fixed-size block allocator, safe to use from any thread
+	// Each thread keeps a small cache of free blocks, so the shared pool (and its lock) is only touched in batches
 	class SizePool
 	{
 	public:
@@ -13,9 +18,15 @@ namespace Halley {
 		void* alloc();
 		void free(void* p);
 
+		// Moves blocks between the shared pool and a thread cache, used when a cache runs empty or overflows
+		void allocBatch(void** blocks, size_t n);
+		void freeBatch(void* const* blocks, size_t n);
+
 	private:
 		void* pimpl;
 		size_t size;
+		size_t id;
+		std::mutex mutex;
 	};
 
 	// yo dawg
@@ -25,9 +36,14 @@ namespace Halley {
 		static SizePool* getPool(size_t size);
 
 	private:
+		constexpr static size_t maxDirectSize = 1024;
+
 		static PoolPool& get();
 
+		// Sizes up to maxDirectSize are looked up without locking; pools are never destroyed, so once set an entry is stable
+		std::array<std::atomic<SizePool*>, maxDirectSize + 1> directPools = {};
 		FlatMap<size_t, SizePool*> pools;
+		std::mutex mutex;
 	};
 
 	template <typename T>
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include "halley/resources/resource_data.h"
+
+namespace Halley
+{
+	class String;
+
+	// Reads a file through a read-only memory mapping, so the whole file can be viewed without copying
+	// The mapping itself is shared and immutable, so any number of readers (and views returned by getMappedData)
+	// can use it concurrently; each reader only holds its own position
+	class MemoryMappedFileReader final : public ResourceDataReader
+	{
+	public:
+		// Returns null if the file can't be opened or mapped, or if mapping isn't supported on this platform
+		static std::unique_ptr<MemoryMappedFileReader> open(const String& path);
+		static bool isSupported();
+
+		MemoryMappedFileReader(std::shared_ptr<const char> mapping, size_t size);
+
+		size_t size() const override;
+		int read(gsl::span<gsl::byte> dst) override;
+		void seek(int64_t pos, int whence) override;
+		size_t tell() const override;
+		void close() override;
+		std::shared_ptr<const char> getMappedData() const override;
+
+	private:
+		std::shared_ptr<const char> mapping;
+		size_t fileSize = 0;
+		size_t pos = 0;
+	};
+}
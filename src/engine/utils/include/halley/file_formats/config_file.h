@@ -32,6 +32,7 @@ namespace Halley
 
 		static std::unique_ptr<ConfigFile> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::ConfigFile; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 
 		void reload(Resource&& resource) override;
 
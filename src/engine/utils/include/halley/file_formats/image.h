@@ -68,6 +68,7 @@ namespace Halley {
 		gsl::span<const int> getPixels4BPP() const;
 		gsl::span<const int> getPixelRow4BPP(int x0, int x1, int y) const;
 		size_t getByteSize() const;
+		size_t getMemoryUsage() const override { return getByteSize(); }
 
 		static unsigned int convertRGBAToInt(unsigned int r, unsigned int g, unsigned int b, unsigned int a=255);
 		static void convertIntToRGBA(unsigned int col, unsigned int& r, unsigned int& g, unsigned int& b, unsigned int& a);
@@ -95,6 +96,7 @@ namespace Halley {
 
 		static std::unique_ptr<Image> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Image; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		void reload(Resource&& resource) override;
 
 		Image& operator=(const Image& o) = delete;
@@ -18,6 +18,7 @@ namespace Halley
 
 		static std::unique_ptr<TextFile> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::TextFile; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		void reload(Resource&& resource) override;
 
 	private:
@@ -13,6 +13,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "bytes/fuzzer.h"
 
 #include "data_structures/bin_pack.h"
+#include "data_structures/broadphase_2d.h"
 #include "data_structures/dynamic_grid.h"
 #include "data_structures/hash_map.h"
 #include "data_structures/mapped_pool.h"
@@ -27,6 +28,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "data_structures/vector.h"
 
 #include "file/directory_monitor.h"
+#include "file/memory_mapped_file.h"
 #include "file/path.h"
 
 #include "file_formats/binary_file.h"
@@ -60,6 +62,8 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "maths/vector4.h"
 #include "maths/uuid.h"
 
+#include "memory/frame_arena.h"
+
 #include "os/os.h"
 
 #include "navigation/navmesh.h"
@@ -68,6 +72,9 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "navigation/navigation_query.h"
 #include "navigation/navigation_path.h"
 #include "navigation/navigation_path_follower.h"
+#include "navigation/navigation_flow_field.h"
+#include "navigation/pathfinding_scratch.h"
+#include "navigation/pathfinding_service.h"
 
 #include "plugin/plugin.h"
 
@@ -1,10 +1,9 @@
 #pragma once
 
+// HAS_AVX only means the intrinsics can be compiled; code using them must check for CPU support at runtime
 #if defined(_M_X64) || defined(__x86_64__)
 	#define HAS_SSE
-	#if !defined(__linux__)
-		#define HAS_AVX
-	#endif
+	#define HAS_AVX
 #endif
 
 #if defined(_M_IX86) || defined(__i386)
@@ -21,7 +20,7 @@
 	//#include <nmmintrin.h> // SSE4.1
 #endif
 
-#ifdef HAS_AVS
+#ifdef HAS_AVX
 	#include <immintrin.h>
 #endif
 
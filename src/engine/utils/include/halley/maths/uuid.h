@@ -26,6 +26,7 @@ namespace Halley {
         static UUID generate();
         static UUID generateFromUUIDs(const UUID& one, const UUID& two);
     	bool isValid() const;
+		uint64_t getHash() const;
 
         gsl::span<const gsl::byte> getBytes() const;
 		gsl::span<gsl::byte> getBytes();
@@ -38,6 +39,17 @@ namespace Halley {
     };
 }
 
+namespace std {
+	template<>
+	struct hash<Halley::UUID>
+	{
+		size_t operator()(const Halley::UUID& v) const noexcept
+		{
+			return static_cast<size_t>(v.getHash());
+		}
+	};
+}
+
 namespace natvis {
     struct x4lo {
     	uint8_t v: 4;
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Halley {
+	// Linear allocator for memory that only lives until the end of the current frame
+	// Allocation just bumps a pointer, and everything is released at once when the frame ends
+	// Memory is kept between frames, so once it has grown to fit a frame's peak usage it no longer calls malloc
+	class FrameArena {
+	public:
+		explicit FrameArena(size_t initialSize = 64 * 1024);
+
+		FrameArena(const FrameArena& other) = delete;
+		FrameArena& operator=(const FrameArena& other) = delete;
+
+		void* allocate(size_t size, size_t alignment);
+
+		// Only the most recent allocation can actually be given back; anything else is reclaimed on reset
+		void deallocate(void* ptr, size_t size);
+
+		void reset();
+
+		// Changes on every reset, so allocators can tell that the memory they handed out has been reclaimed
+		uint64_t getGeneration() const { return generation; }
+
+		size_t getBytesUsed() const { return bytesUsed; }
+		size_t getPeakBytesUsed() const { return peakBytesUsed; }
+		size_t getCapacity() const;
+		size_t getBlockAllocations() const { return blockAllocations; }
+
+		// The calling thread's arena, reset lazily the first time it's used on each frame
+		// Memory from it must not be kept past the end of the frame, not even by tasks still running on other threads
+		static FrameArena& getThreadArena();
+
+		// Called by Core at frame boundaries
+		static void beginFrame();
+		static uint64_t getFrameNumber();
+
+		// Number of global operator new calls during the last complete frame
+		// Only counted when built with HALLEY_TRACK_ALLOCATIONS, always zero otherwise
+		static bool isTrackingAllocations();
+		static uint64_t getAllocationCount();
+		static uint64_t getLastFrameAllocationCount();
+
+	private:
+		struct Block {
+			std::unique_ptr<std::byte[]> data;
+			size_t size = 0;
+		};
+
+		std::vector<Block> blocks;
+		size_t curBlock = 0;
+		size_t curOffset = 0;
+		size_t bytesUsed = 0;
+		size_t peakBytesUsed = 0;
+		size_t blockAllocations = 0;
+		uint64_t frameNumber = 0;
+		uint64_t generation = 0;
+
+		void addBlock(size_t size);
+	};
+
+	// STL allocator adapter, e.g. std::vector<int, FrameAllocator<int>>
+	// Binds to the arena it's constructed with, so containers can be filled from other threads
+	// Containers using it must be destroyed before the frame ends (or before their arena is reset), as the same memory is handed out again
+	// on the next frame, and a container kept alive past that would share it. Debug builds assert this.
+	template <typename T>
+	class FrameAllocator {
+	public:
+		using value_type = T;
+
+		FrameAllocator() noexcept
+			: arena(&FrameArena::getThreadArena())
+			, generation(arena->getGeneration())
+			, frame(FrameArena::getFrameNumber())
+		{}
+
+		explicit FrameAllocator(FrameArena& arena) noexcept
+			: arena(&arena)
+			, generation(arena.getGeneration())
+		{}
+
+		template <typename U>
+		FrameAllocator(const FrameAllocator<U>& other) noexcept
+			: arena(other.arena)
+			, generation(other.generation)
+			, frame(other.frame)
+		{}
+
+		T* allocate(size_t n)
+		{
+			assert(isCurrent() && "Frame containers must not outlive the frame they were created in");
+			return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* ptr, size_t n) noexcept
+		{
+			assert(isCurrent() && "Frame containers must not outlive the frame they were created in");
+			arena->deallocate(ptr, n * sizeof(T));
+		}
+
+		// False once the arena has been reset, or once a new frame has started for thread arenas (which are only reset lazily)
+		bool isCurrent() const noexcept
+		{
+			return arena->getGeneration() == generation && (frame == 0 || frame == FrameArena::getFrameNumber());
+		}
+
+		template <typename U>
+		bool operator==(const FrameAllocator<U>& other) const noexcept { return arena == other.arena; }
+
+		template <typename U>
+		bool operator!=(const FrameAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+	private:
+		template <typename U> friend class FrameAllocator;
+
+		FrameArena* arena;
+		uint64_t generation = 0;
+		uint64_t frame = 0; // Only set when bound to the thread arena
+	};
+
+	template <typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "halley/maths/vector2.h"
+#include "halley/data_structures/hash_map.h"
+
+namespace Halley {
+	class NavmeshSet;
+	class Navmesh;
+
+	// Distances to a single destination from every polygon of a NavmeshSet, so any number of agents heading there can share one search
+	// The portal graph is solved once up front; the per-polygon field of each region is only computed when an agent in that region first samples it
+	// When the set's connectivity changes (see NavmeshSet::getConnectivityVersion), the portal distances are recomputed and only regions whose exits changed are dropped
+	// The NavmeshSet must outlive this, and can't be modified while it's being sampled
+	class NavigationFlowField {
+	public:
+		NavigationFlowField(const NavmeshSet& navmeshSet, Vector2f destination, int destinationSubWorld);
+
+		Vector2f getDestination() const { return destination; }
+		int getDestinationSubWorld() const { return destinationSubWorld; }
+
+		// Returns the point an agent at pos should head to next, or empty if the destination can't be reached from there
+		// If that point is closer than threshold, the one after it is returned instead, so agents don't stall on polygon edges
+		// Safe to call from multiple threads; only computing a region for the first time, or catching up with the NavmeshSet, takes a lock
+		std::optional<Vector2f> sample(Vector2f pos, int subWorld, float threshold = 0) const;
+		std::optional<float> getDistance(Vector2f pos, int subWorld) const;
+
+	private:
+		struct Seed {
+			uint16_t node;
+			uint16_t edge;
+			float cost;
+
+			bool operator==(const Seed& other) const;
+			bool operator!=(const Seed& other) const;
+		};
+
+		struct Cell {
+			Vector2f nextPoint;
+			Vector2f crossDirection; // Out of this polygon, across the edge containing nextPoint; zero if nextPoint is the destination
+			float distance = std::numeric_limits<float>::infinity();
+		};
+
+		struct RegionField {
+			Vector2i gridPos;
+			int subWorld = 0;
+			size_t numNodes = 0;
+			std::vector<Seed> seeds;
+			std::vector<Cell> cells;
+		};
+
+		// Never modified once published, so readers can keep using one while a newer one is being built
+		struct Snapshot {
+			uint32_t version = 0;
+			std::optional<uint16_t> destinationRegion;
+			std::vector<float> portalDistances;
+			HashMap<uint16_t, std::shared_ptr<const RegionField>> regions;
+		};
+
+		const NavmeshSet& navmeshSet;
+		Vector2f destination;
+		int destinationSubWorld = 0;
+
+		mutable std::shared_ptr<const Snapshot> snapshot; // Only accessed with std::atomic_load and std::atomic_store
+		mutable std::mutex buildMutex;
+
+		std::shared_ptr<const Snapshot> getSnapshot(std::optional<uint16_t> withRegion) const;
+		bool isUpToDate(const Snapshot& snap, std::optional<uint16_t> withRegion) const;
+		void updateSnapshot(Snapshot& snap) const;
+		void computePortalDistances(Snapshot& snap) const;
+		std::vector<Seed> getSeeds(const Snapshot& snap, uint16_t regionId) const;
+		const Cell* getCell(std::shared_ptr<const Snapshot>& snap, Vector2f pos, int subWorld) const;
+		std::shared_ptr<const RegionField> makeRegionField(const Snapshot& snap, uint16_t regionId) const;
+		void computeRegionField(const Navmesh& navmesh, RegionField& field) const;
+	};
+}
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <memory>
 #include "navigation_path.h"
 
 namespace Halley {
 	class NavmeshSet;
+	class NavigationFlowField;
 
 	class NavigationPathFollower {
 	public:
@@ -15,6 +17,11 @@ namespace Halley {
 		void setPath(std::optional<NavigationPath> p);
 		const std::optional<NavigationPath>& getPath() const;
 
+		// Heads to the flow field's destination instead of following a path of its own; replaces any current path
+		// Flow fields are shared between agents and aren't serialized
+		void setFlowField(std::shared_ptr<const NavigationFlowField> field);
+		const std::shared_ptr<const NavigationFlowField>& getFlowField() const;
+
 		void update(Vector2f curPos, int curSubWorld, const NavmeshSet& navmeshSet, float threshold);
 		
 		Vector2f getNextPosition() const;
@@ -28,9 +35,12 @@ namespace Halley {
 		size_t nextRegionIdx = 0;
 		std::optional<NavigationPath> path;
 		bool needsToReEvaluatePath = false;
+		std::shared_ptr<const NavigationFlowField> flowField;
+		Vector2f flowFieldNextPos;
 
 		void goToNextRegion(const NavmeshSet& navmeshSet);
 		void reEvaluatePath(const NavmeshSet& navmeshSet);
+		void updateFlowField(float threshold);
 	};
 
 	template<>
@@ -2,6 +2,7 @@
 
 #include "navigation_path.h"
 #include "navigation_query.h"
+#include "pathfinding_scratch.h"
 #include "halley/maths/polygon.h"
 #include "halley/maths/base_transform.h"
 
@@ -125,6 +126,8 @@ namespace Halley {
 			const std::vector<State>& state;
 		};
 
+		using Scratch = PathfindingScratch<State, NodeId, NodeComparator>;
+
 		std::vector<Node> nodes;
 		std::vector<Polygon> polygons;
 		std::vector<Portal> portals;
@@ -144,7 +147,7 @@ namespace Halley {
 		float totalArea = 0;
 
 		std::optional<std::vector<NodeAndConn>> pathfind(int fromId, int toId) const;
-		std::vector<NodeAndConn> makeResult(const std::vector<State>& state, int startId, int endId) const;
+		std::vector<NodeAndConn> makeResult(Scratch& state, int startId, int endId) const;
 		std::optional<NavigationPath> makePath(const NavigationQuery& query, const std::vector<NodeAndConn>& nodePath) const;
 		void postProcessPath(std::vector<Vector2f>& points, NavigationQuery::PostProcessingType type) const;
 
@@ -2,11 +2,49 @@
 
 #include "navmesh.h"
 #include "navmesh_set.h"
+#include "halley/data_structures/tree_map.h"
 
 namespace Halley {
+	class ExecutionQueue;
+
 	class NavmeshGenerator {
 	public:
+		// Obstacles are expanded and grid cells are generated in parallel on the queue (the default CPU queue if not given)
 		static NavmeshSet generate(const NavmeshBounds& bounds, gsl::span<const Polygon> obstacles, gsl::span<const Polygon> regions, int subWorld, float agentSize);
+		static NavmeshSet generate(const NavmeshBounds& bounds, gsl::span<const Polygon> obstacles, gsl::span<const Polygon> regions, int subWorld, float agentSize, ExecutionQueue& queue);
+
+		// Everything needed to generate one world chunk, which is then added to the world's NavmeshSet at gridPos (see NavmeshSet::addChunk)
+		struct ChunkInput {
+			Vector2i gridPos;
+			Vector2f origin;
+			NavmeshBounds bounds;
+			std::vector<Polygon> obstacles;
+			std::vector<Polygon> regions;
+			int subWorld = 0;
+			float agentSize = 0;
+
+			ChunkInput(Vector2i gridPos, Vector2f origin, NavmeshBounds bounds, int subWorld, float agentSize);
+
+			uint64_t getHash() const;
+		};
+
+		// Remembers what each chunk was last generated from, so updateChunks only rebuilds the ones that changed
+		class ChunkCache {
+		public:
+			void clear() { hashes.clear(); }
+
+		private:
+			friend class NavmeshGenerator;
+			TreeMap<std::pair<Vector2i, int>, uint64_t> hashes;
+		};
+
+		// Chunks are independent, so they're all generated concurrently; results are in the same order as the input
+		static std::vector<NavmeshSet> generateChunks(gsl::span<const ChunkInput> chunks, ExecutionQueue& queue);
+
+		// Regenerates only the chunks whose input changed since the last update with this cache, replaces them in world, and relinks it
+		// chunks is the whole world, so chunks generated by a previous update but missing from it are removed from world
+		// Returns the number of chunks rebuilt or removed
+		static size_t updateChunks(NavmeshSet& world, gsl::span<const ChunkInput> chunks, ChunkCache& cache, ExecutionQueue& queue);
 
 	private:
 		class NavmeshNode {
@@ -29,11 +67,13 @@ namespace Halley {
 		constexpr static size_t maxPolygonSides = 8;
 
 		static std::vector<Polygon> generateByPolygonSubtraction(gsl::span<const Polygon> inputPolygons, gsl::span<const Polygon> obstacles, Circle bounds);
-		static std::vector<Polygon> preProcessObstacles(gsl::span<const Polygon> obstacles, float agentSize);
+		static std::vector<Polygon> preProcessObstacles(gsl::span<const Polygon> obstacles, float agentSize, ExecutionQueue& queue);
 		static Polygon makeAgentMask(float agentSize);
 
 		static std::vector<NavmeshNode> toNavmeshNode(std::vector<Polygon> polygons);
 		static void generateConnectivity(gsl::span<NavmeshNode> polygons);
+		static void generateConnectivityBetweenCells(gsl::span<NavmeshNode> polygons, gsl::span<const size_t> cellStarts, size_t side1Divisions);
+		static void connectPolygonEdge(gsl::span<NavmeshNode> polygons, size_t polyAIdx, size_t edgeAIdx, size_t polyBStart, size_t polyBEnd);
 		static void postProcessPolygons(std::vector<NavmeshNode>& polygons, float maxSize);
 		static void removeDeadPolygons(std::vector<NavmeshNode>& polygons);
 
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <list>
+#include <mutex>
 #include "navmesh.h"
+#include "halley/data_structures/hash_map.h"
 #include "navigation_query.h"
 #include "navigation_path.h"
 
 namespace Halley {
 	class NavmeshSet {
+		friend class NavigationFlowField;
+
 	public:
 		NavmeshSet();
 		NavmeshSet(const ConfigNode& nodeData);
@@ -14,6 +19,8 @@ namespace Halley {
 
 		void add(Navmesh navmesh);
 		void addChunk(NavmeshSet navmeshSet, Vector2f origin, Vector2i gridPosition);
+		void replaceChunk(NavmeshSet navmeshSet, Vector2f origin, Vector2i gridPosition, int subWorld); // Call linkNavmeshes after replacing all changed chunks
+		void removeChunk(Vector2i gridPosition, int subWorld); // Ditto
 		void addRaw(NavmeshSet navmeshSet);
 		void clear();
 		void clearSubWorld(int subWorld);
@@ -30,6 +37,15 @@ namespace Halley {
 
 		std::pair<uint16_t, uint16_t> getPortalDestination(uint16_t region, uint16_t edge) const;
 
+		// Changes whenever navmeshes are linked or removed, i.e. whenever anything derived from the portal graph needs updating
+		uint32_t getConnectivityVersion() const { return connectivityVersion; }
+
+		// Routes between distant regions are cached by region pair, keeping up to maxEntries of the most recently used ones
+		// The cache is dropped whenever connectivity changes; 0 disables it
+		void setRegionPathCacheSize(size_t maxEntries);
+		size_t getRegionPathCacheHits() const;
+		size_t getRegionPathCacheMisses() const;
+
 	private:
 		struct PortalConnection {
 			uint16_t portalId;
@@ -86,12 +102,61 @@ namespace Halley {
 			const std::vector<State>& state;
 		};
 
+		using Scratch = PathfindingScratch<State, NodeId, NodeComparator>;
+
+		class RegionPathCache {
+		public:
+			RegionPathCache() = default;
+			RegionPathCache(const RegionPathCache& other);
+			RegionPathCache& operator=(const RegionPathCache& other);
+
+			std::optional<std::vector<NodeAndConn>> get(uint32_t key, uint32_t version);
+			void put(uint32_t key, uint32_t version, std::vector<NodeAndConn> path);
+			void setMaxSize(size_t size);
+
+			size_t getHits() const;
+			size_t getMisses() const;
+
+		private:
+			using LRUList = std::list<uint32_t>;
+			struct Entry {
+				std::vector<NodeAndConn> path;
+				LRUList::iterator lruPos;
+			};
+
+			mutable std::mutex mutex;
+			HashMap<uint32_t, Entry> entries;
+			LRUList lru; // Most recently used first
+			size_t maxSize = 4096;
+			uint32_t version = 0;
+			size_t hits = 0;
+			size_t misses = 0;
+
+			void clearIfStale(uint32_t curVersion);
+		};
+
+		class ConnectivityVersion {
+		public:
+			ConnectivityVersion() = default;
+			ConnectivityVersion(const ConnectivityVersion& other) = default;
+			ConnectivityVersion& operator=(const ConnectivityVersion& other);
+
+			ConnectivityVersion& operator++() { ++value; return *this; }
+			operator uint32_t() const { return value; }
+
+		private:
+			uint32_t value = 0;
+		};
+
 		std::vector<Navmesh> navmeshes;
 		std::vector<PortalNode> portalNodes;
 		std::vector<RegionNode> regionNodes;
+		ConnectivityVersion connectivityVersion;
+		mutable RegionPathCache regionPathCache;
 
 		void tryLinkNavMeshes(uint16_t idxA, uint16_t idxB);
 
+		std::vector<NavigationPath::RegionNode> getRegionPath(Vector2f startPos, Vector2f endPos, uint16_t fromRegionId, uint16_t toRegionId) const;
 		std::vector<NavigationPath::RegionNode> findRegionPath(Vector2f startPos, Vector2f endPos, uint16_t fromRegionId, uint16_t toRegionId) const;
 	};
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "halley/data_structures/priority_queue.h"
+
+namespace Halley {
+	// Search state for A*, reused between queries made on the same thread
+	// Instead of clearing the whole state array before each query, entries are stamped with the query generation and reset the first time they're touched
+	template <typename State, typename NodeId, typename Comparator>
+	class PathfindingScratch {
+	public:
+		PathfindingScratch()
+			: openSet(Comparator(states))
+		{}
+
+		PathfindingScratch(const PathfindingScratch& other) = delete;
+		PathfindingScratch& operator=(const PathfindingScratch& other) = delete;
+
+		void begin(size_t nNodes)
+		{
+			if (states.size() < nNodes) {
+				states.resize(nNodes);
+				generations.resize(nNodes, 0);
+			}
+			if (++generation == 0) {
+				std::fill(generations.begin(), generations.end(), 0);
+				generation = 1;
+			}
+			openSet.clear();
+		}
+
+		State& operator[](size_t id)
+		{
+			if (generations[id] != generation) {
+				generations[id] = generation;
+				states[id] = State{};
+			}
+			return states[id];
+		}
+
+		PriorityQueue<NodeId, Comparator>& getOpenSet() { return openSet; }
+
+	private:
+		std::vector<State> states;
+		std::vector<uint32_t> generations;
+		uint32_t generation = 0;
+		PriorityQueue<NodeId, Comparator> openSet;
+	};
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <mutex>
+#include "navigation_path.h"
+#include "navigation_query.h"
+#include "halley/concurrency/future.h"
+#include "halley/data_structures/vector.h"
+
+namespace Halley {
+	class NavmeshSet;
+	class ExecutionQueue;
+
+	// Runs navigation queries against a NavmeshSet on worker threads, in batches of queriesPerTask
+	// The NavmeshSet must outlive the service, and must not be changed (e.g. by linkNavmeshes) while queries are still running; call wait() first
+	class PathfindingService {
+	public:
+		explicit PathfindingService(const NavmeshSet& navmeshSet, size_t queriesPerTask = 16);
+		PathfindingService(const NavmeshSet& navmeshSet, ExecutionQueue& queue, size_t queriesPerTask = 16);
+		~PathfindingService();
+
+		PathfindingService(const PathfindingService& other) = delete;
+		PathfindingService& operator=(const PathfindingService& other) = delete;
+
+		Future<std::optional<NavigationPath>> pathfind(NavigationQuery query);
+		Vector<Future<std::optional<NavigationPath>>> pathfind(Vector<NavigationQuery> queries);
+
+		void wait();
+
+	private:
+		const NavmeshSet& navmeshSet;
+		ExecutionQueue& queue;
+		size_t queriesPerTask;
+
+		std::mutex mutex;
+		Vector<Future<void>> tasks;
+	};
+}
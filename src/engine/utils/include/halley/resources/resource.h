@@ -135,10 +135,18 @@ namespace Halley
 		void setAssetId(String name);
 		const String& getAssetId() const { return assetId; }
 		virtual void onLoaded(Resources& resources);
+
+		// Resources are constructed on the main thread unless their type hides this with one returning true
+		// Only do that if loadResource and onLoaded just decode data and get other resources through Resources
+		constexpr static bool canLoadOnAnyThread() { return false; }
 		
 		int getAssetVersion() const { return assetVersion; }
 		void reloadResource(Resource&& resource);
 
+		// Approximate memory held by this resource, used for resource memory budgets
+		// When this returns 0, the size of the data it was loaded from is used instead
+		virtual size_t getMemoryUsage() const { return 0; }
+
 	protected:
 		virtual void reload(Resource&& resource);
 
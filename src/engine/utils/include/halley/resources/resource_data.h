@@ -41,6 +41,10 @@ namespace Halley {
 		virtual size_t tell() const = 0;
 		virtual void close() = 0;
 
+		// Readers backed by memory that outlives them (e.g. a mapped file) can expose all of it, for zero-copy access
+		// The returned pointer keeps that memory alive; returns null for readers that don't support this
+		virtual std::shared_ptr<const char> getMappedData() const { return {}; }
+
 		Bytes readAll();
 	};
 
@@ -59,8 +63,10 @@ namespace Halley {
 	public:
 		ResourceDataStatic(String path);
 		ResourceDataStatic(const void* data, size_t size, String path, bool owning = true);
+		ResourceDataStatic(std::shared_ptr<const char> data, size_t size, String path);
 
 		void set(const void* data, size_t size, bool owning = true);
+		void set(std::shared_ptr<const char> data, size_t size);
 		bool isLoaded() const;
 
 		const void* getData() const;
@@ -136,6 +142,7 @@ namespace Halley {
 		const HalleyAPI* api;
 		const Metadata* metadata;
 		bool loaded = false;
+		size_t bytesLoaded = 0;
 	};
 
 }
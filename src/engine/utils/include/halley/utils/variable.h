@@ -170,6 +170,7 @@ namespace Halley {
 		void deserialize(Deserializer& s);
 
 		constexpr static AssetType getAssetType() { return AssetType::VariableTable; }
+		constexpr static bool canLoadOnAnyThread() { return true; }
 		static std::unique_ptr<VariableTable> loadResource(ResourceLoader& loader);
 		void reload(Resource&& resource) override;
 
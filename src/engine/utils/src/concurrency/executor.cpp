@@ -1,3 +1,4 @@
+#include <iterator>
 #include <halley/concurrency/concurrent.h>
 #include <halley/concurrency/executor.h>
 #include <halley/support/exception.h>
@@ -8,52 +9,183 @@ using namespace Halley;
 
 Executors* Executors::instance = nullptr;
 
+namespace {
+	thread_local ExecutionQueue* currentQueue = nullptr;
+	thread_local int currentWorkerIdx = -1;
+	thread_local int helpDepth = 0;
+}
+
 ExecutionQueue::ExecutionQueue()
-	: aborted(false)
+	: numWorkers(0)
+	, sleeping(0)
+	, attachedCount(0)
+	, pendingTasks(0)
+	, aborted(false)
 {
-	hasTasks.store(false);
 }
 
+ExecutionQueue::~ExecutionQueue() = default;
+
 TaskBase ExecutionQueue::getNext()
 {
-	std::unique_lock<std::mutex> lock(mutex);
-	while (queue.empty()) {
-		if (!aborted) {
-			condition.wait(lock);
-		}
+	const int workerIdx = getCurrentWorkerIndex();
+	TaskBase task;
+
+	while (true) {
 		if (aborted) {
-			queue.clear();
 			return TaskBase([] () {});
 		}
-	}
 
-	TaskBase value = queue.front();
-	queue.pop_front();
-	return value;
+		if (tryGetTask(workerIdx, task)) {
+			return task;
+		}
+
+		// Nothing to run or steal, so sleep until something is added
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		++sleeping;
+		condition.wait(lock, [&] () { return pendingTasks.load() > 0 || aborted.load(); });
+		--sleeping;
+	}
 }
 
 std::vector<TaskBase> ExecutionQueue::getAll()
 {
-	std::unique_lock<std::mutex> lock(mutex);
-	hasTasks.store(false);
-	std::vector<TaskBase> tasks(queue.begin(), queue.end());
-	queue.clear();
+	std::vector<TaskBase> tasks;
+
+	const auto drain = [&] (Worker& worker)
+	{
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		std::move(worker.tasks.begin(), worker.tasks.end(), std::back_inserter(tasks));
+		worker.tasks.clear();
+	};
+
+	drain(injection);
+	const size_t n = numWorkers.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		drain(*workers[i]);
+	}
+
+	pendingTasks -= int(tasks.size());
 	return tasks;
 }
 
 void ExecutionQueue::addToQueue(TaskBase task)
 {
 #if HAS_THREADS
-	std::unique_lock<std::mutex> lock(mutex);
-	queue.emplace_back(task);
-	hasTasks.store(true);
+	const int workerIdx = getCurrentWorkerIndex();
+	auto& target = workerIdx >= 0 ? *workers[workerIdx] : injection;
+	{
+		std::unique_lock<std::mutex> lock(target.mutex);
+		target.tasks.emplace_back(std::move(task));
+	}
+	++pendingTasks;
 
-	condition.notify_one();
+	// Only touch the sleep mutex if someone might be sleeping on it
+	if (sleeping.load() > 0) {
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		condition.notify_one();
+	}
 #else
 	task();
 #endif
 }
 
+void ExecutionQueue::attachWorkerThread()
+{
+	std::unique_lock<std::mutex> lock(workerRegistrationMutex);
+	const size_t idx = numWorkers.load();
+	if (idx >= maxWorkers) {
+		// Still works, just without a local deque
+		return;
+	}
+
+	workers[idx] = std::make_unique<Worker>();
+	numWorkers.store(idx + 1, std::memory_order_release);
+
+	currentQueue = this;
+	currentWorkerIdx = int(idx);
+}
+
+bool ExecutionQueue::tryHelpOnCurrentThread()
+{
+	if (!currentQueue) {
+		return false;
+	}
+
+	TaskBase task;
+	if (currentQueue->tryGetTask(currentWorkerIdx, task)) {
+		++helpDepth;
+		try {
+			task();
+		} catch (...) {
+			--helpDepth;
+			throw;
+		}
+		--helpDepth;
+		return true;
+	}
+	return false;
+}
+
+bool ExecutionQueue::isWorkerThread()
+{
+	return currentQueue != nullptr;
+}
+
+int ExecutionQueue::getHelpDepth()
+{
+	return helpDepth;
+}
+
+bool ExecutionQueue::tryGetTask(int workerIdx, TaskBase& task)
+{
+	bool found = (workerIdx >= 0 && tryPopBack(*workers[workerIdx], task)) || tryPopFront(injection, task);
+
+	if (!found) {
+		// Steal the oldest task from someone else, starting from our neighbour so thieves spread out
+		const size_t n = numWorkers.load(std::memory_order_acquire);
+		const size_t start = workerIdx >= 0 ? size_t(workerIdx) + 1 : 0;
+		for (size_t i = 0; i < n && !found; ++i) {
+			const size_t victim = (start + i) % n;
+			if (int(victim) != workerIdx) {
+				found = tryPopFront(*workers[victim], task);
+			}
+		}
+	}
+
+	if (found) {
+		--pendingTasks;
+	}
+	return found;
+}
+
+bool ExecutionQueue::tryPopBack(Worker& worker, TaskBase& task)
+{
+	std::unique_lock<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) {
+		return false;
+	}
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	return true;
+}
+
+bool ExecutionQueue::tryPopFront(Worker& worker, TaskBase& task)
+{
+	std::unique_lock<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) {
+		return false;
+	}
+	task = std::move(worker.tasks.front());
+	worker.tasks.pop_front();
+	return true;
+}
+
+int ExecutionQueue::getCurrentWorkerIndex() const
+{
+	return currentQueue == this ? currentWorkerIdx : -1;
+}
+
 Executors& Executors::get()
 {
 	if (!instance) {
@@ -85,7 +217,7 @@ void ExecutionQueue::onDetached()
 void ExecutionQueue::abort()
 {
 	{
-		std::unique_lock<std::mutex> lock(mutex);
+		std::unique_lock<std::mutex> lock(sleepMutex);
 		if (aborted) {
 			return;
 		}
@@ -129,6 +261,8 @@ bool Executor::runPending()
 void Executor::runForever()
 {
 #if HAS_THREADS
+	queue.attachWorkerThread();
+
 	try {
 		while (running)	{
 			auto next = queue.getNext();
@@ -0,0 +1,347 @@
+#include "halley/data_structures/broadphase_2d.h"
+#include "halley/concurrency/concurrent.h"
+#include <cmath>
+#include <limits>
+
+using namespace Halley;
+
+namespace {
+	// Unlike Rect4f::overlaps, touching counts, so that zero-sized boxes (points) can be found
+	bool overlapsInclusive(const Rect4f& a, const Rect4f& b)
+	{
+		return !(a.getBottomRight().x < b.getTopLeft().x || b.getBottomRight().x < a.getTopLeft().x || a.getBottomRight().y < b.getTopLeft().y || b.getBottomRight().y < a.getTopLeft().y);
+	}
+
+	bool overlapsCircle(const Rect4f& box, Vector2f centre, float radius)
+	{
+		const auto p1 = box.getTopLeft();
+		const auto p2 = box.getBottomRight();
+		const auto closest = Vector2f(clamp(centre.x, p1.x, p2.x), clamp(centre.y, p1.y, p2.y));
+		return (closest - centre).squaredLength() <= radius * radius;
+	}
+
+	std::optional<float> castBox(const Ray& ray, const Rect4f& box, float maxDistance)
+	{
+		float tMin = 0;
+		float tMax = maxDistance;
+		for (int axis = 0; axis < 2; ++axis) {
+			const float p = axis == 0 ? ray.p.x : ray.p.y;
+			const float d = axis == 0 ? ray.dir.x : ray.dir.y;
+			const float lo = axis == 0 ? box.getTopLeft().x : box.getTopLeft().y;
+			const float hi = axis == 0 ? box.getBottomRight().x : box.getBottomRight().y;
+
+			if (std::abs(d) < 0.000001f) {
+				if (p < lo || p > hi) {
+					return {};
+				}
+			} else {
+				float t1 = (lo - p) / d;
+				float t2 = (hi - p) / d;
+				if (t1 > t2) {
+					std::swap(t1, t2);
+				}
+				tMin = std::max(tMin, t1);
+				tMax = std::min(tMax, t2);
+				if (tMin > tMax) {
+					return {};
+				}
+			}
+		}
+		return tMin;
+	}
+}
+
+Broadphase2D::Broadphase2D(float cellSize)
+	: cellSize(cellSize)
+	, invCellSize(1.0f / cellSize)
+{
+	Expects(cellSize > 0);
+}
+
+void Broadphase2D::add(Id id, Rect4f bounds)
+{
+	if (idToEntry.find(id) != idToEntry.end()) {
+		update(id, bounds);
+		return;
+	}
+
+	const auto idx = static_cast<uint32_t>(entries.size());
+	entries.push_back(Entry{ bounds, id, getCell(bounds.getCenter()), 0 });
+	idToEntry[id] = idx;
+	insertIntoCell(idx);
+
+	const auto halfSize = bounds.getSize() * 0.5f;
+	margin = Vector2f(std::max(margin.x, halfSize.x), std::max(margin.y, halfSize.y));
+}
+
+void Broadphase2D::addBulk(gsl::span<const std::pair<Id, Rect4f>> newEntries)
+{
+	entries.reserve(entries.size() + newEntries.size());
+	idToEntry.reserve(idToEntry.size() + newEntries.size());
+	for (const auto& [id, bounds]: newEntries) {
+		add(id, bounds);
+	}
+}
+
+void Broadphase2D::update(Id id, Rect4f bounds)
+{
+	const auto iter = idToEntry.find(id);
+	if (iter == idToEntry.end()) {
+		add(id, bounds);
+		return;
+	}
+
+	const auto idx = iter->second;
+	auto& entry = entries[idx];
+	entry.bounds = bounds;
+
+	const auto newCell = getCell(bounds.getCenter());
+	if (newCell != entry.cell) {
+		removeFromCell(idx);
+		entry.cell = newCell;
+		insertIntoCell(idx);
+	}
+
+	const auto halfSize = bounds.getSize() * 0.5f;
+	margin = Vector2f(std::max(margin.x, halfSize.x), std::max(margin.y, halfSize.y));
+}
+
+bool Broadphase2D::remove(Id id)
+{
+	const auto iter = idToEntry.find(id);
+	if (iter == idToEntry.end()) {
+		return false;
+	}
+
+	const auto idx = iter->second;
+	idToEntry.erase(iter);
+	removeFromCell(idx);
+
+	// Swap with the last entry to keep them packed
+	const auto lastIdx = static_cast<uint32_t>(entries.size() - 1);
+	if (idx != lastIdx) {
+		auto& last = entries[lastIdx];
+		cells[last.cell][last.posInCell] = idx;
+		idToEntry[last.id] = idx;
+		entries[idx] = last;
+	}
+	entries.pop_back();
+
+	return true;
+}
+
+void Broadphase2D::clear()
+{
+	entries.clear();
+	idToEntry.clear();
+	cells.clear();
+	occupiedCells.reset();
+	margin = Vector2f();
+}
+
+void Broadphase2D::shrinkMargin()
+{
+	margin = Vector2f();
+	for (const auto& entry: entries) {
+		const auto halfSize = entry.bounds.getSize() * 0.5f;
+		margin = Vector2f(std::max(margin.x, halfSize.x), std::max(margin.y, halfSize.y));
+	}
+}
+
+bool Broadphase2D::contains(Id id) const
+{
+	return idToEntry.find(id) != idToEntry.end();
+}
+
+std::optional<Rect4f> Broadphase2D::getBounds(Id id) const
+{
+	const auto iter = idToEntry.find(id);
+	if (iter == idToEntry.end()) {
+		return {};
+	}
+	return entries[iter->second].bounds;
+}
+
+void Broadphase2D::queryOverlaps(Rect4f area, Vector<Id>& results) const
+{
+	forEachCandidate(area, [&] (const Entry& entry)
+	{
+		if (overlapsInclusive(entry.bounds, area)) {
+			results.push_back(entry.id);
+		}
+	});
+}
+
+void Broadphase2D::queryRadius(Vector2f centre, float radius, Vector<Id>& results) const
+{
+	const auto area = Rect4f(centre - Vector2f(radius, radius), centre + Vector2f(radius, radius));
+	forEachCandidate(area, [&] (const Entry& entry)
+	{
+		if (overlapsCircle(entry.bounds, centre, radius)) {
+			results.push_back(entry.id);
+		}
+	});
+}
+
+std::optional<Broadphase2D::RaycastResult> Broadphase2D::raycast(Ray ray, float maxDistance) const
+{
+	std::optional<RaycastResult> best;
+	if (entries.empty() || !occupiedCells) {
+		return best;
+	}
+
+	// Walk the cells along the ray, checking every cell close enough to hold a box reaching into the current one
+	const auto reach = Vector2i(static_cast<int>(std::ceil(margin.x * invCellSize)), static_cast<int>(std::ceil(margin.y * invCellSize)));
+	const auto bounds = occupiedCells.value();
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+
+	auto cell = getCell(ray.p);
+	const auto step = Vector2i(ray.dir.x > 0 ? 1 : (ray.dir.x < 0 ? -1 : 0), ray.dir.y > 0 ? 1 : (ray.dir.y < 0 ? -1 : 0));
+	const auto tDelta = Vector2f(step.x != 0 ? cellSize / std::abs(ray.dir.x) : infinity, step.y != 0 ? cellSize / std::abs(ray.dir.y) : infinity);
+	auto tNext = Vector2f(
+		step.x != 0 ? ((cell.x + (step.x > 0 ? 1 : 0)) * cellSize - ray.p.x) / ray.dir.x : infinity,
+		step.y != 0 ? ((cell.y + (step.y > 0 ? 1 : 0)) * cellSize - ray.p.y) / ray.dir.y : infinity);
+
+	std::optional<Rect4i> prevArea;
+	float t = 0;
+	while (t <= maxDistance && (!best || t <= best->distance)) {
+		const auto area = Rect4i(cell - reach, cell + reach);
+
+		// Once the ray is past every occupied cell, moving away from them, there's nothing left to hit (this also ends walks with infinite maxDistance)
+		const bool pastX = (area.getLeft() > bounds.getRight() && step.x >= 0) || (area.getRight() < bounds.getLeft() && step.x <= 0);
+		const bool pastY = (area.getTop() > bounds.getBottom() && step.y >= 0) || (area.getBottom() < bounds.getTop() && step.y <= 0);
+		if (pastX || pastY) {
+			break;
+		}
+
+		for (int y = area.getTop(); y <= area.getBottom(); ++y) {
+			for (int x = area.getLeft(); x <= area.getRight(); ++x) {
+				const auto cur = Vector2i(x, y);
+				if (prevArea && prevArea->getLeft() <= x && x <= prevArea->getRight() && prevArea->getTop() <= y && y <= prevArea->getBottom()) {
+					continue;
+				}
+
+				const auto iter = cells.find(cur);
+				if (iter == cells.end()) {
+					continue;
+				}
+				for (const auto idx: iter->second) {
+					const auto& entry = entries[idx];
+					const auto hit = castBox(ray, entry.bounds, best ? best->distance : maxDistance);
+					if (hit && (!best || hit.value() < best->distance)) {
+						best = RaycastResult{ entry.id, hit.value() };
+					}
+				}
+			}
+		}
+		prevArea = area;
+
+		if (step == Vector2i()) {
+			break;
+		}
+		if (tNext.x < tNext.y) {
+			t = tNext.x;
+			tNext.x += tDelta.x;
+			cell.x += step.x;
+		} else {
+			t = tNext.y;
+			tNext.y += tDelta.y;
+			cell.y += step.y;
+		}
+	}
+
+	return best;
+}
+
+void Broadphase2D::queryOverlaps(gsl::span<const Rect4f> areas, gsl::span<Vector<Id>> results, ExecutionQueue& queue) const
+{
+	Expects(areas.size() == results.size());
+	Concurrent::parallelFor(queue, 0, areas.size(), [&] (size_t i)
+	{
+		results[i].clear();
+		queryOverlaps(areas[i], results[i]);
+	}, 16);
+}
+
+void Broadphase2D::queryRadius(gsl::span<const std::pair<Vector2f, float>> circles, gsl::span<Vector<Id>> results, ExecutionQueue& queue) const
+{
+	Expects(circles.size() == results.size());
+	Concurrent::parallelFor(queue, 0, circles.size(), [&] (size_t i)
+	{
+		results[i].clear();
+		queryRadius(circles[i].first, circles[i].second, results[i]);
+	}, 16);
+}
+
+void Broadphase2D::raycast(gsl::span<const std::pair<Ray, float>> rays, gsl::span<std::optional<RaycastResult>> results, ExecutionQueue& queue) const
+{
+	Expects(rays.size() == results.size());
+	Concurrent::parallelFor(queue, 0, rays.size(), [&] (size_t i)
+	{
+		results[i] = raycast(rays[i].first, rays[i].second);
+	}, 16);
+}
+
+Vector2i Broadphase2D::getCell(Vector2f pos) const
+{
+	return Vector2i(static_cast<int>(std::floor(pos.x * invCellSize)), static_cast<int>(std::floor(pos.y * invCellSize)));
+}
+
+void Broadphase2D::insertIntoCell(uint32_t entryIdx)
+{
+	auto& entry = entries[entryIdx];
+	auto& list = cells[entry.cell];
+	entry.posInCell = static_cast<uint32_t>(list.size());
+	list.push_back(entryIdx);
+
+	const auto cellRect = Rect4i(entry.cell, entry.cell);
+	occupiedCells = occupiedCells ? occupiedCells->merge(cellRect) : cellRect;
+}
+
+void Broadphase2D::removeFromCell(uint32_t entryIdx)
+{
+	const auto& entry = entries[entryIdx];
+	const auto iter = cells.find(entry.cell);
+	auto& list = iter->second;
+
+	const auto lastIdx = list.back();
+	list[entry.posInCell] = lastIdx;
+	entries[lastIdx].posInCell = entry.posInCell;
+	list.pop_back();
+
+	if (list.empty()) {
+		cells.erase(iter);
+	}
+}
+
+template <typename F>
+void Broadphase2D::forEachCandidate(Rect4f area, F f) const
+{
+	// Anything overlapping the area has its centre within margin of it
+	const auto c0 = getCell(area.getTopLeft() - margin);
+	const auto c1 = getCell(area.getBottomRight() + margin);
+	const int64_t nCells = int64_t(c1.x - c0.x + 1) * int64_t(c1.y - c0.y + 1);
+
+	if (nCells > static_cast<int64_t>(cells.size())) {
+		// Huge area, cheaper to go through the occupied cells
+		for (const auto& [cell, list]: cells) {
+			if (cell.x >= c0.x && cell.x <= c1.x && cell.y >= c0.y && cell.y <= c1.y) {
+				for (const auto idx: list) {
+					f(entries[idx]);
+				}
+			}
+		}
+		return;
+	}
+
+	for (int y = c0.y; y <= c1.y; ++y) {
+		for (int x = c0.x; x <= c1.x; ++x) {
+			const auto iter = cells.find(Vector2i(x, y));
+			if (iter != cells.end()) {
+				for (const auto idx: iter->second) {
+					f(entries[idx]);
+				}
+			}
+		}
+	}
+}
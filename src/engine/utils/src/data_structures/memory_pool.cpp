@@ -1,20 +1,93 @@
+#include <algorithm>
 #include <boost/pool/pool.hpp>
 #include "halley/data_structures/memory_pool.h"
+#include "halley/data_structures/vector.h"
 
 using namespace Halley;
 
+namespace {
+	constexpr size_t batchSize = 32;
+	constexpr size_t maxCachedBlocks = batchSize * 2;
+
+	// Every pool that ever existed, by id, so thread caches can tell whether their pool is still alive when the thread exits
+	std::mutex& getRegistryMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	Vector<SizePool*>& getRegistry()
+	{
+		static auto* registry = new Vector<SizePool*>();
+		return *registry;
+	}
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct ThreadCache {
+		FreeBlock* head = nullptr;
+		size_t count = 0;
+	};
+
+	struct ThreadCaches {
+		Vector<ThreadCache> caches; // Indexed by pool id
+
+		~ThreadCaches()
+		{
+			std::lock_guard<std::mutex> lock(getRegistryMutex());
+			auto& registry = getRegistry();
+			for (size_t id = 0; id < caches.size(); ++id) {
+				auto* pool = id < registry.size() ? registry[id] : nullptr;
+				if (!pool) {
+					continue;
+				}
+
+				std::array<void*, batchSize> blocks;
+				size_t n = 0;
+				for (auto* block = caches[id].head; block; ) {
+					auto* next = block->next;
+					blocks[n++] = block;
+					if (n == batchSize) {
+						pool->freeBatch(blocks.data(), n);
+						n = 0;
+					}
+					block = next;
+				}
+				pool->freeBatch(blocks.data(), n);
+			}
+		}
+	};
+
+	ThreadCache& getThreadCache(size_t id)
+	{
+		static thread_local ThreadCaches threadCaches;
+		auto& caches = threadCaches.caches;
+		if (id >= caches.size()) {
+			caches.resize(id + 1);
+		}
+		return caches[id];
+	}
+}
+
 PoolPool& PoolPool::get()
 {
-	static PoolPool* pools = nullptr;
-	if (!pools) {
-		pools = new PoolPool();
-	}
+	static PoolPool* pools = new PoolPool();
 	return *pools;
 }
 
 SizePool* PoolPool::getPool(size_t size)
 {
-	auto& pools = get().pools;
+	auto& pp = get();
+	if (size <= maxDirectSize) {
+		if (auto* pool = pp.directPools[size].load(std::memory_order_acquire)) {
+			return pool;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(pp.mutex);
+	auto& pools = pp.pools;
 	auto iter = pools.find(size);
 	if (iter != pools.end()) {
 		return iter->second;
@@ -22,6 +95,9 @@ SizePool* PoolPool::getPool(size_t size)
 
 	auto pool = new SizePool(size);
 	pools[size] = pool;
+	if (size <= maxDirectSize) {
+		pp.directPools[size].store(pool, std::memory_order_release);
+	}
 	return pool;
 }
 
@@ -30,20 +106,83 @@ typedef boost::pool<boost::default_user_allocator_malloc_free> PoolType;
 SizePool::SizePool(size_t size)
 	: size(size)
 {
-	pimpl = new PoolType(size);
+	// Free blocks are threaded into a list through their first bytes
+	pimpl = new PoolType(std::max(size, sizeof(FreeBlock)));
+
+	std::lock_guard<std::mutex> lock(getRegistryMutex());
+	auto& registry = getRegistry();
+	id = registry.size();
+	registry.push_back(this);
 }
 
 SizePool::~SizePool()
 {
+	{
+		std::lock_guard<std::mutex> lock(getRegistryMutex());
+		getRegistry()[id] = nullptr;
+	}
 	delete reinterpret_cast<PoolType*>(pimpl);
 }
 
 void* SizePool::alloc()
 {
-	return reinterpret_cast<PoolType*>(pimpl)->malloc();
+	auto& cache = getThreadCache(id);
+	if (!cache.head) {
+		std::array<void*, batchSize> blocks;
+		allocBatch(blocks.data(), batchSize);
+		for (auto* block: blocks) {
+			auto* freeBlock = static_cast<FreeBlock*>(block);
+			freeBlock->next = cache.head;
+			cache.head = freeBlock;
+		}
+		cache.count += batchSize;
+	}
+
+	auto* result = cache.head;
+	cache.head = result->next;
+	--cache.count;
+	return result;
 }
 
 void SizePool::free(void* p)
 {
-	reinterpret_cast<PoolType*>(pimpl)->free(p);
+	auto& cache = getThreadCache(id);
+	auto* block = static_cast<FreeBlock*>(p);
+	block->next = cache.head;
+	cache.head = block;
+	++cache.count;
+
+	if (cache.count > maxCachedBlocks) {
+		std::array<void*, batchSize> blocks;
+		for (auto& b: blocks) {
+			b = cache.head;
+			cache.head = cache.head->next;
+		}
+		cache.count -= batchSize;
+		freeBatch(blocks.data(), batchSize);
+	}
+}
+
+void SizePool::allocBatch(void** blocks, size_t n)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& pool = *reinterpret_cast<PoolType*>(pimpl);
+	for (size_t i = 0; i < n; ++i) {
+		blocks[i] = pool.malloc();
+		if (!blocks[i]) {
+			for (size_t j = 0; j < i; ++j) {
+				pool.free(blocks[j]);
+			}
+			throw std::bad_alloc();
+		}
+	}
+}
+
+void SizePool::freeBatch(void* const* blocks, size_t n)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& pool = *reinterpret_cast<PoolType*>(pimpl);
+	for (size_t i = 0; i < n; ++i) {
+		pool.free(blocks[i]);
+	}
 }
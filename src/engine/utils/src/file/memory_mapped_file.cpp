@@ -0,0 +1,106 @@
+#include "halley/file/memory_mapped_file.h"
+#include "halley/text/halleystring.h"
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HALLEY_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Halley;
+
+std::unique_ptr<MemoryMappedFileReader> MemoryMappedFileReader::open(const String& path)
+{
+#ifdef HALLEY_HAS_MMAP
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return {};
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		::close(fd);
+		return {};
+	}
+
+	const size_t size = size_t(st.st_size);
+	void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping keeps the file alive
+	if (addr == MAP_FAILED) {
+		return {};
+	}
+
+	auto mapping = std::shared_ptr<const char>(static_cast<const char*>(addr), [size] (const char* p)
+	{
+		munmap(const_cast<char*>(p), size);
+	});
+	return std::make_unique<MemoryMappedFileReader>(std::move(mapping), size);
+#else
+	return {};
+#endif
+}
+
+bool MemoryMappedFileReader::isSupported()
+{
+#ifdef HALLEY_HAS_MMAP
+	return true;
+#else
+	return false;
+#endif
+}
+
+MemoryMappedFileReader::MemoryMappedFileReader(std::shared_ptr<const char> mapping, size_t size)
+	: mapping(std::move(mapping))
+	, fileSize(size)
+{
+}
+
+size_t MemoryMappedFileReader::size() const
+{
+	return fileSize;
+}
+
+int MemoryMappedFileReader::read(gsl::span<gsl::byte> dst)
+{
+	const size_t toRead = pos < fileSize ? std::min(fileSize - pos, size_t(dst.size())) : 0;
+	if (toRead > 0) {
+		memcpy(dst.data(), mapping.get() + pos, toRead);
+		pos += toRead;
+	}
+	return int(toRead);
+}
+
+void MemoryMappedFileReader::seek(int64_t offset, int whence)
+{
+	switch (whence) {
+	case SEEK_SET:
+		pos = size_t(offset);
+		break;
+	case SEEK_CUR:
+		pos = size_t(int64_t(pos) + offset);
+		break;
+	case SEEK_END:
+		pos = size_t(int64_t(fileSize) + offset);
+		break;
+	}
+}
+
+size_t MemoryMappedFileReader::tell() const
+{
+	return pos;
+}
+
+void MemoryMappedFileReader::close()
+{
+	mapping.reset();
+	fileSize = 0;
+	pos = 0;
+}
+
+std::shared_ptr<const char> MemoryMappedFileReader::getMappedData() const
+{
+	return mapping;
+}
@@ -109,6 +109,16 @@ bool UUID::isValid() const
 	return false;
 }
 
+uint64_t UUID::getHash() const
+{
+	// UUIDs are mostly random already, so folding the two halves together is enough
+	uint64_t a;
+	uint64_t b;
+	memcpy(&a, bytes.data(), 8);
+	memcpy(&b, bytes.data() + 8, 8);
+	return a ^ (b * 0x9E3779B97F4A7C15ull);
+}
+
 gsl::span<const gsl::byte> UUID::getBytes() const
 {
 	return gsl::as_bytes(gsl::span<const Byte>(bytes));
@@ -0,0 +1,163 @@
+#include "halley/memory/frame_arena.h"
+#include "halley/utils/utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace Halley;
+
+namespace {
+	std::atomic<uint64_t> globalFrameNumber = 1;
+	std::atomic<uint64_t> allocationCount = 0;
+	std::atomic<uint64_t> allocationCountAtFrameStart = 0;
+	std::atomic<uint64_t> lastFrameAllocationCount = 0;
+}
+
+#ifdef HALLEY_TRACK_ALLOCATIONS
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* result = std::malloc(size == 0 ? 1 : size)) {
+		return result;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+FrameArena::FrameArena(size_t initialSize)
+{
+	addBlock(initialSize);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	size = std::max(size, size_t(1));
+
+	auto tryFit = [&] () -> void*
+	{
+		auto& block = blocks[curBlock];
+		const size_t offset = alignUp(curOffset, alignment);
+		if (offset + size <= block.size) {
+			bytesUsed += offset + size - curOffset;
+			peakBytesUsed = std::max(peakBytesUsed, bytesUsed);
+			curOffset = offset + size;
+			return block.data.get() + offset;
+		}
+		return nullptr;
+	};
+
+	if (void* result = tryFit()) {
+		return result;
+	}
+
+	// Move on to the next block, making one big enough if needed
+	while (curBlock + 1 < blocks.size()) {
+		++curBlock;
+		curOffset = 0;
+		if (void* result = tryFit()) {
+			return result;
+		}
+	}
+	addBlock(std::max(blocks.back().size * 2, size + alignment));
+	++curBlock;
+	curOffset = 0;
+	return tryFit();
+}
+
+void FrameArena::deallocate(void* ptr, size_t size)
+{
+	auto* start = static_cast<std::byte*>(ptr);
+	auto* blockStart = blocks[curBlock].data.get();
+	if (start >= blockStart && start + std::max(size, size_t(1)) == blockStart + curOffset) {
+		const size_t offset = static_cast<size_t>(start - blockStart);
+		bytesUsed -= curOffset - offset;
+		curOffset = offset;
+	}
+}
+
+void FrameArena::reset()
+{
+	if (blocks.size() > 1) {
+		// The last frame didn't fit, so replace all blocks with a single one that would have fit it
+		const size_t total = getCapacity();
+		blocks.clear();
+		addBlock(total);
+	}
+	curBlock = 0;
+	curOffset = 0;
+	bytesUsed = 0;
+	++generation;
+}
+
+size_t FrameArena::getCapacity() const
+{
+	size_t total = 0;
+	for (const auto& block: blocks) {
+		total += block.size;
+	}
+	return total;
+}
+
+void FrameArena::addBlock(size_t size)
+{
+	Block block;
+	block.data.reset(new std::byte[size]);
+	block.size = size;
+	blocks.push_back(std::move(block));
+	++blockAllocations;
+}
+
+FrameArena& FrameArena::getThreadArena()
+{
+	static thread_local FrameArena arena;
+	const auto frame = globalFrameNumber.load(std::memory_order_acquire);
+	if (arena.frameNumber != frame) {
+		arena.reset();
+		arena.frameNumber = frame;
+	}
+	return arena;
+}
+
+void FrameArena::beginFrame()
+{
+	const auto count = allocationCount.load(std::memory_order_relaxed);
+	lastFrameAllocationCount = count - allocationCountAtFrameStart.exchange(count);
+
+	globalFrameNumber.fetch_add(1, std::memory_order_acq_rel);
+	getThreadArena();
+}
+
+uint64_t FrameArena::getFrameNumber()
+{
+	return globalFrameNumber.load(std::memory_order_acquire);
+}
+
+bool FrameArena::isTrackingAllocations()
+{
+#ifdef HALLEY_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t FrameArena::getAllocationCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t FrameArena::getLastFrameAllocationCount()
+{
+	return lastFrameAllocationCount.load(std::memory_order_relaxed);
+}
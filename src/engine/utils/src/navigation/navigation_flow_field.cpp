@@ -0,0 +1,285 @@
+#include "halley/navigation/navigation_flow_field.h"
+#include "halley/navigation/navmesh_set.h"
+#include <queue>
+using namespace Halley;
+
+namespace {
+	constexpr uint16_t noEdge = std::numeric_limits<uint16_t>::max();
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+
+	using OpenEntry = std::pair<float, uint16_t>;
+	using OpenSet = std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<>>;
+}
+
+bool NavigationFlowField::Seed::operator==(const Seed& other) const
+{
+	return node == other.node && edge == other.edge && cost == other.cost;
+}
+
+bool NavigationFlowField::Seed::operator!=(const Seed& other) const
+{
+	return !(*this == other);
+}
+
+NavigationFlowField::NavigationFlowField(const NavmeshSet& navmeshSet, Vector2f destination, int destinationSubWorld)
+	: navmeshSet(navmeshSet)
+	, destination(destination)
+	, destinationSubWorld(destinationSubWorld)
+{
+	auto snap = std::make_shared<Snapshot>();
+	snap->version = navmeshSet.getConnectivityVersion();
+	computePortalDistances(*snap);
+	snapshot = std::move(snap);
+}
+
+std::optional<Vector2f> NavigationFlowField::sample(Vector2f pos, int subWorld, float threshold) const
+{
+	auto snap = getSnapshot({});
+
+	constexpr int maxSteps = 4;
+	Vector2f probe = pos;
+	for (int i = 0; true; ++i) {
+		const auto* cell = getCell(snap, probe, subWorld);
+		if (!cell || cell->distance == infinity) {
+			return {};
+		}
+		if ((cell->nextPoint - pos).length() >= threshold || cell->crossDirection == Vector2f() || i == maxSteps - 1) {
+			return cell->nextPoint;
+		}
+
+		// Close enough already, look at the polygon on the other side of that edge
+		probe = cell->nextPoint + cell->crossDirection * 0.01f;
+	}
+}
+
+std::optional<float> NavigationFlowField::getDistance(Vector2f pos, int subWorld) const
+{
+	auto snap = getSnapshot({});
+	const auto* cell = getCell(snap, pos, subWorld);
+	if (!cell || cell->distance == infinity) {
+		return {};
+	}
+	return cell->distance + (cell->nextPoint - pos).length();
+}
+
+std::shared_ptr<const NavigationFlowField::Snapshot> NavigationFlowField::getSnapshot(std::optional<uint16_t> withRegion) const
+{
+	auto snap = std::atomic_load(&snapshot);
+	if (isUpToDate(*snap, withRegion)) {
+		return snap;
+	}
+
+	std::unique_lock<std::mutex> lock(buildMutex);
+
+	// Might have been built while waiting for the lock
+	snap = std::atomic_load(&snapshot);
+	if (isUpToDate(*snap, withRegion)) {
+		return snap;
+	}
+
+	auto newSnap = std::make_shared<Snapshot>(*snap);
+	if (newSnap->version != navmeshSet.getConnectivityVersion()) {
+		updateSnapshot(*newSnap);
+	}
+	if (withRegion && newSnap->regions.find(*withRegion) == newSnap->regions.end()) {
+		newSnap->regions[*withRegion] = makeRegionField(*newSnap, *withRegion);
+	}
+
+	std::shared_ptr<const Snapshot> result = std::move(newSnap);
+	std::atomic_store(&snapshot, result);
+	return result;
+}
+
+bool NavigationFlowField::isUpToDate(const Snapshot& snap, std::optional<uint16_t> withRegion) const
+{
+	return snap.version == navmeshSet.getConnectivityVersion() && (!withRegion || snap.regions.find(*withRegion) != snap.regions.end());
+}
+
+void NavigationFlowField::updateSnapshot(Snapshot& snap) const
+{
+	snap.version = navmeshSet.getConnectivityVersion();
+	computePortalDistances(snap);
+
+	// Keep the fields of regions that are still the same navmesh and reach the destination through the same exits
+	const auto& navmeshes = navmeshSet.getNavmeshes();
+	for (auto iter = snap.regions.begin(); iter != snap.regions.end(); ) {
+		const auto regionId = iter->first;
+		const auto& field = *iter->second;
+		bool keep = regionId < navmeshes.size();
+		if (keep) {
+			const auto& navmesh = navmeshes[regionId];
+			keep = navmesh.getWorldGridPos() == field.gridPos && navmesh.getSubWorld() == field.subWorld && navmesh.getNumNodes() == field.numNodes && getSeeds(snap, regionId) == field.seeds;
+		}
+
+		if (keep) {
+			++iter;
+		} else {
+			iter = snap.regions.erase(iter);
+		}
+	}
+}
+
+void NavigationFlowField::computePortalDistances(Snapshot& snap) const
+{
+	const auto& portals = navmeshSet.portalNodes;
+	auto& portalDistances = snap.portalDistances;
+	portalDistances.assign(portals.size(), infinity);
+
+	const size_t destIdx = navmeshSet.getNavMeshIdxAt(destination, destinationSubWorld);
+	if (destIdx == std::numeric_limits<size_t>::max()) {
+		snap.destinationRegion = {};
+		return;
+	}
+	const auto destinationRegion = static_cast<uint16_t>(destIdx);
+	snap.destinationRegion = destinationRegion;
+
+	// Dijkstra backwards from the destination, over portals as nodes
+	OpenSet openSet;
+	for (size_t i = 0; i < portals.size(); ++i) {
+		if (portals[i].toRegion == destinationRegion) {
+			portalDistances[i] = (portals[i].pos - destination).length();
+			openSet.emplace(portalDistances[i], static_cast<uint16_t>(i));
+		}
+	}
+
+	while (!openSet.empty()) {
+		const auto [dist, portalId] = openSet.top();
+		openSet.pop();
+		if (dist > portalDistances[portalId]) {
+			continue;
+		}
+
+		// Anything entering the region this portal leaves from can continue through it
+		const auto& portal = portals[portalId];
+		for (const auto exitId: navmeshSet.regionNodes[portal.fromRegion].portals) {
+			const uint16_t enterId = exitId ^ 1; // Portals are created in pairs, one for each direction
+			const float newDist = dist + (portals[enterId].pos - portal.pos).length();
+			if (newDist < portalDistances[enterId]) {
+				portalDistances[enterId] = newDist;
+				openSet.emplace(newDist, enterId);
+			}
+		}
+	}
+}
+
+std::vector<NavigationFlowField::Seed> NavigationFlowField::getSeeds(const Snapshot& snap, uint16_t regionId) const
+{
+	std::vector<Seed> seeds;
+	const auto& navmesh = navmeshSet.getNavmeshes()[regionId];
+
+	if (snap.destinationRegion == regionId) {
+		if (const auto node = navmesh.getNodeAt(destination)) {
+			seeds.push_back(Seed{ node.value(), noEdge, 0.0f });
+		}
+	}
+
+	if (regionId < navmeshSet.regionNodes.size()) {
+		const auto& nodes = navmesh.getNodes();
+		for (const auto exitId: navmeshSet.regionNodes[regionId].portals) {
+			const float dist = snap.portalDistances[exitId];
+			if (dist == infinity) {
+				continue;
+			}
+
+			const auto& portal = navmesh.getPortals()[navmeshSet.portalNodes[exitId].fromPortal];
+			for (const auto& conn: portal.connections) {
+				seeds.push_back(Seed{ conn.node, conn.connectionIdx, dist + (nodes[conn.node].pos - portal.pos).length() });
+			}
+		}
+	}
+
+	return seeds;
+}
+
+const NavigationFlowField::Cell* NavigationFlowField::getCell(std::shared_ptr<const Snapshot>& snap, Vector2f pos, int subWorld) const
+{
+	const size_t regionIdx = navmeshSet.getNavMeshIdxAt(pos, subWorld);
+	if (regionIdx == std::numeric_limits<size_t>::max()) {
+		return nullptr;
+	}
+
+	const auto node = navmeshSet.getNavmeshes()[regionIdx].getNodeAt(pos);
+	if (!node) {
+		return nullptr;
+	}
+
+	const auto regionId = static_cast<uint16_t>(regionIdx);
+	if (snap->regions.find(regionId) == snap->regions.end()) {
+		snap = getSnapshot(regionId);
+	}
+	return &snap->regions.at(regionId)->cells[node.value()];
+}
+
+std::shared_ptr<const NavigationFlowField::RegionField> NavigationFlowField::makeRegionField(const Snapshot& snap, uint16_t regionId) const
+{
+	const auto& navmesh = navmeshSet.getNavmeshes()[regionId];
+	auto field = std::make_shared<RegionField>();
+	field->gridPos = navmesh.getWorldGridPos();
+	field->subWorld = navmesh.getSubWorld();
+	field->numNodes = navmesh.getNumNodes();
+	field->seeds = getSeeds(snap, regionId);
+	computeRegionField(navmesh, *field);
+	return field;
+}
+
+void NavigationFlowField::computeRegionField(const Navmesh& navmesh, RegionField& field) const
+{
+	const auto& nodes = navmesh.getNodes();
+	field.cells.assign(nodes.size(), Cell());
+
+	auto setCrossing = [&] (Cell& cell, uint16_t node, uint16_t edgeIdx)
+	{
+		const auto edge = navmesh.getPolygon(node).getEdge(edgeIdx);
+		cell.nextPoint = 0.5f * (edge.a + edge.b);
+		auto normal = (edge.b - edge.a).orthoLeft().normalized();
+		if (normal.dot(cell.nextPoint - nodes[node].pos) < 0) {
+			normal = -normal;
+		}
+		cell.crossDirection = normal;
+	};
+
+	OpenSet openSet;
+	for (const auto& seed: field.seeds) {
+		auto& cell = field.cells[seed.node];
+		if (seed.cost < cell.distance) {
+			cell.distance = seed.cost;
+			if (seed.edge == noEdge) {
+				cell.nextPoint = destination;
+				cell.crossDirection = Vector2f();
+			} else {
+				setCrossing(cell, seed.node, seed.edge);
+			}
+			openSet.emplace(seed.cost, seed.node);
+		}
+	}
+
+	// Connections are symmetric, so walking them forwards from the seeds finds the shortest way back to them
+	while (!openSet.empty()) {
+		const auto [dist, nodeId] = openSet.top();
+		openSet.pop();
+		if (dist > field.cells[nodeId].distance) {
+			continue;
+		}
+
+		const auto& node = nodes[nodeId];
+		for (size_t i = 0; i < node.nConnections; ++i) {
+			if (!node.connections[i]) {
+				continue;
+			}
+			const auto neighbourId = node.connections[i].value();
+			const float newDist = dist + node.costs[i];
+			auto& neighbour = field.cells[neighbourId];
+			if (newDist < neighbour.distance) {
+				const auto& neighbourNode = nodes[neighbourId];
+				for (size_t j = 0; j < neighbourNode.nConnections; ++j) {
+					if (neighbourNode.connections[j] && neighbourNode.connections[j].value() == nodeId) {
+						neighbour.distance = newDist;
+						setCrossing(neighbour, neighbourId, static_cast<uint16_t>(j));
+						openSet.emplace(newDist, neighbourId);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
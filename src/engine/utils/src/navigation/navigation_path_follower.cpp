@@ -1,6 +1,7 @@
 #include "halley/navigation/navigation_path_follower.h"
 
 #include "halley/navigation/navmesh_set.h"
+#include "halley/navigation/navigation_flow_field.h"
 #include "halley/support/logger.h"
 using namespace Halley;
 
@@ -44,6 +45,7 @@ void NavigationPathFollower::setPath(std::optional<NavigationPath> p)
 	path = std::move(p);
 	nextPathIdx = 0;
 	nextRegionIdx = 0;
+	flowField.reset();
 }
 
 const std::optional<NavigationPath>& NavigationPathFollower::getPath() const
@@ -51,11 +53,28 @@ const std::optional<NavigationPath>& NavigationPathFollower::getPath() const
 	return path;
 }
 
+void NavigationPathFollower::setFlowField(std::shared_ptr<const NavigationFlowField> field)
+{
+	setPath({});
+	flowField = std::move(field);
+	flowFieldNextPos = curPos;
+}
+
+const std::shared_ptr<const NavigationFlowField>& NavigationPathFollower::getFlowField() const
+{
+	return flowField;
+}
+
 void NavigationPathFollower::update(Vector2f curPos, int curSubWorld, const NavmeshSet& navmeshSet, float threshold)
 {
 	this->curPos = curPos;
 	this->curSubWorld = curSubWorld;
 
+	if (flowField) {
+		updateFlowField(threshold);
+		return;
+	}
+
 	if (!path) {
 		return;
 	}
@@ -123,8 +142,27 @@ void NavigationPathFollower::reEvaluatePath(const NavmeshSet& navmeshSet)
 	setPath(navmeshSet.pathfind(query));
 }
 
+void NavigationPathFollower::updateFlowField(float threshold)
+{
+	if (curSubWorld == flowField->getDestinationSubWorld() && (flowField->getDestination() - curPos).length() < threshold) {
+		// Arrived
+		flowField.reset();
+		return;
+	}
+
+	if (const auto next = flowField->sample(curPos, curSubWorld, threshold)) {
+		flowFieldNextPos = next.value();
+	} else {
+		Logger::logWarning("Flow field destination can't be reached.");
+		flowField.reset();
+	}
+}
+
 Vector2f NavigationPathFollower::getNextPosition() const
 {
+	if (flowField) {
+		return flowFieldNextPos;
+	}
 	return path->path.size() > nextPathIdx ? path->path[nextPathIdx] : curPos;
 }
 
@@ -135,7 +173,7 @@ size_t NavigationPathFollower::getNextPathIdx() const
 
 bool NavigationPathFollower::isDone() const
 {
-	return !path;
+	return !path && !flowField;
 }
 
 ConfigNode ConfigNodeSerializer<NavigationPathFollower>::serialize(const NavigationPathFollower& follower, const ConfigNodeSerializationContext& context)
@@ -217,7 +217,7 @@ std::optional<NavigationPath> Navmesh::pathfind(const NavigationQuery& query) co
 	return makePath(query, nodePath.value());
 }
 
-std::vector<Navmesh::NodeAndConn> Navmesh::makeResult(const std::vector<State>& state, int startId, int endId) const
+std::vector<Navmesh::NodeAndConn> Navmesh::makeResult(Scratch& state, int startId, int endId) const
 {
 	std::vector<NodeAndConn> result;
 	for (NodeAndConn curNode(endId); true; curNode = state[curNode.node].cameFrom) {
@@ -238,13 +238,12 @@ std::optional<std::vector<Navmesh::NodeAndConn>> Navmesh::pathfind(int fromId, i
 		return {};
 	}
 
-	// State map. Using vector for perf, trading space for CPU.
-	// TODO: measure this vs unordered_map or some other hashtable, it's not impossible that it'd perform better (compact memory)
-	std::vector<State> state(nodes.size(), State{});
+	// State map, kept per thread so it's not allocated and cleared for every query
+	thread_local Scratch state;
+	state.begin(nodes.size());
 
 	// Open set
-	auto openSet = PriorityQueue<NodeId, NodeComparator>(NodeComparator(state));
-	openSet.reserve(std::min(static_cast<size_t>(100), nodes.size()));
+	auto& openSet = state.getOpenSet();
 
 	// Define heuristic function
 	const Vector2f endPos = nodes[toId].pos;
@@ -1,43 +1,103 @@
 #include "halley/navigation/navmesh_generator.h"
 #include "halley/navigation/navmesh_set.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/utils/hash.h"
+#include <set>
 using namespace Halley;
 
-NavmeshSet NavmeshGenerator::generate(const NavmeshBounds& bounds, gsl::span<const Polygon> rawObstacles, gsl::span<const Polygon> regions, int subWorld, float agentSize)
+NavmeshGenerator::ChunkInput::ChunkInput(Vector2i gridPos, Vector2f origin, NavmeshBounds bounds, int subWorld, float agentSize)
+	: gridPos(gridPos)
+	, origin(origin)
+	, bounds(std::move(bounds))
+	, subWorld(subWorld)
+	, agentSize(agentSize)
 {
-	auto obstacles = preProcessObstacles(rawObstacles, agentSize);
+}
+
+uint64_t NavmeshGenerator::ChunkInput::getHash() const
+{
+	Hash::Hasher hasher;
+	auto feedPolygons = [&] (const std::vector<Polygon>& polygons)
+	{
+		hasher.feed(polygons.size());
+		for (const auto& p: polygons) {
+			const auto& vertices = p.getVertices();
+			hasher.feed(vertices.size());
+			hasher.feedBytes(gsl::as_bytes(gsl::span<const Vector2f>(vertices.data(), vertices.size())));
+		}
+	};
+
+	hasher.feed(bounds.origin);
+	hasher.feed(bounds.side0);
+	hasher.feed(bounds.side1);
+	hasher.feed(bounds.side0Divisions);
+	hasher.feed(bounds.side1Divisions);
+	hasher.feed(bounds.scaleFactor);
+	hasher.feed(origin);
+	hasher.feed(subWorld);
+	hasher.feed(agentSize);
+	feedPolygons(obstacles);
+	feedPolygons(regions);
+	return hasher.digest();
+}
+
+NavmeshSet NavmeshGenerator::generate(const NavmeshBounds& bounds, gsl::span<const Polygon> obstacles, gsl::span<const Polygon> regions, int subWorld, float agentSize)
+{
+	if (!Executors::hasInstance()) {
+		// No worker threads (e.g. in tools), so just generate on this thread
+		ExecutionQueue serial;
+		return generate(bounds, obstacles, regions, subWorld, agentSize, serial);
+	}
+	return generate(bounds, obstacles, regions, subWorld, agentSize, ExecutionQueue::getDefault());
+}
+
+NavmeshSet NavmeshGenerator::generate(const NavmeshBounds& bounds, gsl::span<const Polygon> rawObstacles, gsl::span<const Polygon> regions, int subWorld, float agentSize, ExecutionQueue& queue)
+{
+	auto obstacles = preProcessObstacles(rawObstacles, agentSize, queue);
 
 	const auto u = bounds.side0 / bounds.side0Divisions;
 	const auto v = bounds.side1 / bounds.side1Divisions;
 	const float maxSize = (u - v).length() * 0.6f;
 
+	// Cells only depend on the obstacles, so they can all be generated at once
+	const size_t nCells = bounds.side0Divisions * bounds.side1Divisions;
+	std::vector<std::vector<NavmeshNode>> cells(nCells);
+	Concurrent::parallelFor(queue, 0, nCells, [&] (size_t cellIdx)
+	{
+		const size_t i = cellIdx / bounds.side1Divisions;
+		const size_t j = cellIdx % bounds.side1Divisions;
+		const auto cell = Polygon(VertexList{{
+			bounds.origin + (i + 1) * u + j * v,
+			bounds.origin + (i + 1) * u + (j + 1) * v,
+			bounds.origin + i * u + (j + 1) * v,
+			bounds.origin + i * u + j * v
+		}});
+
+		auto cellPolygons = toNavmeshNode(generateByPolygonSubtraction(gsl::span<const Polygon>(&cell, 1), obstacles, cell.getBoundingCircle()));
+		generateConnectivity(cellPolygons);
+		postProcessPolygons(cellPolygons, maxSize);
+		cells[cellIdx] = std::move(cellPolygons);
+	});
+
+	// Concatenate in cell order, so the result doesn't depend on scheduling
 	std::vector<NavmeshNode> polygons;
-	
-	for (size_t i = 0; i < bounds.side0Divisions; ++i) {
-		for (size_t j = 0; j < bounds.side1Divisions; ++j) {
-			const auto cell = Polygon(VertexList{{
-				bounds.origin + (i + 1) * u + j * v,
-				bounds.origin + (i + 1) * u + (j + 1) * v,
-				bounds.origin + i * u + (j + 1) * v,
-				bounds.origin + i * u + j * v
-			}});
-
-			auto cellPolygons = toNavmeshNode(generateByPolygonSubtraction(gsl::span<const Polygon>(&cell, 1), obstacles, cell.getBoundingCircle()));
-			generateConnectivity(cellPolygons);
-			postProcessPolygons(cellPolygons, maxSize);
-
-			const int startIdx = static_cast<int>(polygons.size());
-			for (auto& p: cellPolygons) {
-				polygons.emplace_back(std::move(p));
-				for (auto& c: polygons.back().connections) {
-					if (c != -1) {
-						c += startIdx;
-					}
+	std::vector<size_t> cellStarts;
+	cellStarts.reserve(nCells + 1);
+	for (auto& cellPolygons: cells) {
+		const int startIdx = static_cast<int>(polygons.size());
+		cellStarts.push_back(polygons.size());
+		for (auto& p: cellPolygons) {
+			polygons.emplace_back(std::move(p));
+			for (auto& c: polygons.back().connections) {
+				if (c != -1) {
+					c += startIdx;
 				}
 			}
 		}
 	}
+	cellStarts.push_back(polygons.size());
 
-	generateConnectivity(polygons);
+	generateConnectivityBetweenCells(polygons, cellStarts, bounds.side1Divisions);
 	postProcessPolygons(polygons, maxSize);
 	applyRegions(polygons, regions);
 	const int nRegions = assignRegions(polygons);
@@ -49,6 +109,63 @@ NavmeshSet NavmeshGenerator::generate(const NavmeshBounds& bounds, gsl::span<con
 	return result;
 }
 
+std::vector<NavmeshSet> NavmeshGenerator::generateChunks(gsl::span<const ChunkInput> chunks, ExecutionQueue& queue)
+{
+	std::vector<NavmeshSet> result(chunks.size());
+	Concurrent::parallelFor(queue, 0, chunks.size(), [&] (size_t i)
+	{
+		const auto& chunk = chunks[i];
+		result[i] = generate(chunk.bounds, chunk.obstacles, chunk.regions, chunk.subWorld, chunk.agentSize, queue);
+	});
+	return result;
+}
+
+size_t NavmeshGenerator::updateChunks(NavmeshSet& world, gsl::span<const ChunkInput> chunks, ChunkCache& cache, ExecutionQueue& queue)
+{
+	std::vector<ChunkInput> changed;
+	std::vector<uint64_t> hashes;
+	std::set<std::pair<Vector2i, int>> present;
+	for (const auto& chunk: chunks) {
+		const auto key = std::make_pair(chunk.gridPos, chunk.subWorld);
+		present.insert(key);
+		const auto hash = chunk.getHash();
+		const auto iter = cache.hashes.find(key);
+		if (iter == cache.hashes.end() || iter->second != hash) {
+			changed.push_back(chunk);
+			hashes.push_back(hash);
+		}
+	}
+
+	// Chunks that were generated before but are no longer part of the world
+	size_t removed = 0;
+	for (auto iter = cache.hashes.begin(); iter != cache.hashes.end();) {
+		if (present.find(iter->first) == present.end()) {
+			world.removeChunk(iter->first.first, iter->first.second);
+			iter = cache.hashes.erase(iter);
+			++removed;
+		} else {
+			++iter;
+		}
+	}
+
+	if (changed.empty()) {
+		if (removed > 0) {
+			world.linkNavmeshes();
+		}
+		return removed;
+	}
+
+	auto results = generateChunks(changed, queue);
+	for (size_t i = 0; i < changed.size(); ++i) {
+		const auto& chunk = changed[i];
+		world.replaceChunk(std::move(results[i]), chunk.origin, chunk.gridPos, chunk.subWorld);
+		cache.hashes[std::make_pair(chunk.gridPos, chunk.subWorld)] = hashes[i];
+	}
+	world.linkNavmeshes();
+
+	return changed.size() + removed;
+}
+
 std::vector<Polygon> NavmeshGenerator::generateByPolygonSubtraction(gsl::span<const Polygon> inputPolygons, gsl::span<const Polygon> obstacles, Circle bounds)
 {
 	// Start with the given input polygons
@@ -104,7 +221,7 @@ std::vector<Polygon> NavmeshGenerator::generateByPolygonSubtraction(gsl::span<co
 	return output;
 }
 
-std::vector<Polygon> NavmeshGenerator::preProcessObstacles(gsl::span<const Polygon> obstacles, float agentSize)
+std::vector<Polygon> NavmeshGenerator::preProcessObstacles(gsl::span<const Polygon> obstacles, float agentSize, ExecutionQueue& queue)
 {
 	std::vector<Polygon> result;
 
@@ -124,10 +241,12 @@ std::vector<Polygon> NavmeshGenerator::preProcessObstacles(gsl::span<const Polyg
 
 	// Expand based on agent size
 	const auto agentMask = makeAgentMask(agentSize);
-	for (auto& o: result) {
+	Concurrent::parallelFor(queue, 0, result.size(), [&] (size_t i)
+	{
+		auto& o = result[i];
 		o = o.convolution(agentMask);
 		o.simplify(2.0f);
-	}
+	});
 	
 	return result;
 }
@@ -164,28 +283,57 @@ void NavmeshGenerator::generateConnectivity(gsl::span<NavmeshNode> polygons)
 
 		for (size_t edgeAIdx = 0; edgeAIdx < a.connections.size(); ++edgeAIdx) {
 			if (a.connections[edgeAIdx] == -1) {
-				auto edgeA = a.polygon.getEdge(edgeAIdx);
-				
-				for (size_t polyBIdx = polyAIdx + 1; polyBIdx < polygons.size(); ++polyBIdx) {
-					NavmeshNode& b = polygons[polyBIdx];
-
-					auto edgeBIdx = b.polygon.findEdge(edgeA, 0.0001f);
-					if (edgeBIdx) {
-						//auto edgeB = b.polygon.getEdge(edgeBIdx.value());
-						//assert(b.connections[edgeBIdx.value()] == -1);
-
-						if (b.connections[edgeBIdx.value()] == -1) {
-							// Establish connection
-							a.connections[edgeAIdx] = static_cast<int>(polyBIdx);
-							b.connections[edgeBIdx.value()] = static_cast<int>(polyAIdx);
-						}
-					}
+				connectPolygonEdge(polygons, polyAIdx, edgeAIdx, polyAIdx + 1, polygons.size());
+			}
+		}
+	}
+}
+
+void NavmeshGenerator::generateConnectivityBetweenCells(gsl::span<NavmeshNode> polygons, gsl::span<const size_t> cellStarts, size_t side1Divisions)
+{
+	// Polygons never cross cell boundaries, so they can only share edges with polygons in the same cell or the next one along either side
+	const size_t nCells = cellStarts.size() - 1;
+	for (size_t cellIdx = 0; cellIdx < nCells; ++cellIdx) {
+		const size_t j = cellIdx % side1Divisions;
+		const size_t nextSide1 = j + 1 < side1Divisions ? cellIdx + 1 : nCells;
+		const size_t nextSide0 = cellIdx + side1Divisions;
+
+		for (size_t polyAIdx = cellStarts[cellIdx]; polyAIdx < cellStarts[cellIdx + 1]; ++polyAIdx) {
+			NavmeshNode& a = polygons[polyAIdx];
+			for (size_t edgeAIdx = 0; edgeAIdx < a.connections.size(); ++edgeAIdx) {
+				if (a.connections[edgeAIdx] == -1) {
+					connectPolygonEdge(polygons, polyAIdx, edgeAIdx, polyAIdx + 1, cellStarts[cellIdx + 1]);
+				}
+				if (a.connections[edgeAIdx] == -1 && nextSide1 < nCells) {
+					connectPolygonEdge(polygons, polyAIdx, edgeAIdx, cellStarts[nextSide1], cellStarts[nextSide1 + 1]);
+				}
+				if (a.connections[edgeAIdx] == -1 && nextSide0 < nCells) {
+					connectPolygonEdge(polygons, polyAIdx, edgeAIdx, cellStarts[nextSide0], cellStarts[nextSide0 + 1]);
 				}
 			}
 		}
 	}
 }
 
+void NavmeshGenerator::connectPolygonEdge(gsl::span<NavmeshNode> polygons, size_t polyAIdx, size_t edgeAIdx, size_t polyBStart, size_t polyBEnd)
+{
+	NavmeshNode& a = polygons[polyAIdx];
+	const auto edgeA = a.polygon.getEdge(edgeAIdx);
+
+	for (size_t polyBIdx = polyBStart; polyBIdx < polyBEnd; ++polyBIdx) {
+		NavmeshNode& b = polygons[polyBIdx];
+
+		auto edgeBIdx = b.polygon.findEdge(edgeA, 0.0001f);
+		if (edgeBIdx) {
+			if (b.connections[edgeBIdx.value()] == -1) {
+				// Establish connection
+				a.connections[edgeAIdx] = static_cast<int>(polyBIdx);
+				b.connections[edgeBIdx.value()] = static_cast<int>(polyAIdx);
+			}
+		}
+	}
+}
+
 void NavmeshGenerator::postProcessPolygons(std::vector<NavmeshNode>& polygons, float maxSize)
 {
 	// Go through each polygon and see if any of its neighbours can be merged with it.
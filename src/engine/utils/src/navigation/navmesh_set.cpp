@@ -35,6 +35,18 @@ void NavmeshSet::addChunk(NavmeshSet navmeshSet, Vector2f origin, Vector2i gridP
 	}
 }
 
+void NavmeshSet::replaceChunk(NavmeshSet navmeshSet, Vector2f origin, Vector2i gridPosition, int subWorld)
+{
+	removeChunk(gridPosition, subWorld);
+	addChunk(std::move(navmeshSet), origin, gridPosition);
+}
+
+void NavmeshSet::removeChunk(Vector2i gridPosition, int subWorld)
+{
+	navmeshes.erase(std::remove_if(navmeshes.begin(), navmeshes.end(), [&] (const Navmesh& nav) { return nav.getWorldGridPos() == gridPosition && nav.getSubWorld() == subWorld; }), navmeshes.end());
+	++connectivityVersion;
+}
+
 void NavmeshSet::addRaw(NavmeshSet navmeshSet)
 {
 	for (auto& navmesh: navmeshSet.navmeshes) {
@@ -45,11 +57,13 @@ void NavmeshSet::addRaw(NavmeshSet navmeshSet)
 void NavmeshSet::clear()
 {
 	navmeshes.clear();
+	++connectivityVersion;
 }
 
 void NavmeshSet::clearSubWorld(int subWorld)
 {
 	navmeshes.erase(std::remove_if(navmeshes.begin(), navmeshes.end(), [&] (const Navmesh& nav) { return nav.getSubWorld() == subWorld; }), navmeshes.end());
+	++connectivityVersion;
 }
 
 std::optional<NavigationPath> NavmeshSet::pathfind(const NavigationQuery& query) const
@@ -66,7 +80,7 @@ std::optional<NavigationPath> NavmeshSet::pathfind(const NavigationQuery& query)
 		return pathfindInRegion(query, static_cast<uint16_t>(fromRegion));
 	} else {
 		// Gotta path between regions first
-		auto regionPath = findRegionPath(query.from, query.to, static_cast<uint16_t>(fromRegion), static_cast<uint16_t>(toRegion));
+		auto regionPath = getRegionPath(query.from, query.to, static_cast<uint16_t>(fromRegion), static_cast<uint16_t>(toRegion));
 		if (regionPath.size() <= 1) {
 			// Failed
 			return {};
@@ -107,6 +121,7 @@ size_t NavmeshSet::getNavMeshIdxAt(Vector2f pos, int subWorld) const
 
 void NavmeshSet::linkNavmeshes()
 {
+	++connectivityVersion;
 	regionNodes.clear();
 	regionNodes.resize(navmeshes.size());
 	portalNodes.clear();
@@ -116,9 +131,31 @@ void NavmeshSet::linkNavmeshes()
 	}
 
 	// Link meshes
+	// Only meshes in the same or adjacent grid cells can link, so look those up by grid position rather than trying every pair
+	HashMap<Vector2i, std::vector<uint16_t>> byGridPos;
 	const uint16_t nMeshes = static_cast<uint16_t>(navmeshes.size());
 	for (uint16_t i = 0; i < nMeshes; ++i) {
-		for (uint16_t j = i + 1; j < nMeshes; ++j) {
+		byGridPos[navmeshes[i].getWorldGridPos()].push_back(i);
+	}
+
+	std::vector<uint16_t> candidates;
+	for (uint16_t i = 0; i < nMeshes; ++i) {
+		candidates.clear();
+		const auto gridPos = navmeshes[i].getWorldGridPos();
+		for (const auto& offset: { Vector2i(0, 0), Vector2i(1, 0), Vector2i(-1, 0), Vector2i(0, 1), Vector2i(0, -1) }) {
+			const auto iter = byGridPos.find(gridPos + offset);
+			if (iter != byGridPos.end()) {
+				for (const auto j: iter->second) {
+					if (j > i) {
+						candidates.push_back(j);
+					}
+				}
+			}
+		}
+
+		// Same order as trying all pairs, since portals are linked on a first come, first served basis
+		std::sort(candidates.begin(), candidates.end());
+		for (const auto j: candidates) {
 			tryLinkNavMeshes(i, j);
 		}
 	}
@@ -224,6 +261,45 @@ void NavmeshSet::tryLinkNavMeshes(uint16_t idxA, uint16_t idxB)
 	}
 }
 
+void NavmeshSet::setRegionPathCacheSize(size_t maxEntries)
+{
+	regionPathCache.setMaxSize(maxEntries);
+}
+
+size_t NavmeshSet::getRegionPathCacheHits() const
+{
+	return regionPathCache.getHits();
+}
+
+size_t NavmeshSet::getRegionPathCacheMisses() const
+{
+	return regionPathCache.getMisses();
+}
+
+std::vector<NavmeshSet::NodeAndConn> NavmeshSet::getRegionPath(Vector2f startPos, Vector2f endPos, NodeId fromRegionId, NodeId toRegionId) const
+{
+	if (fromRegionId >= navmeshes.size() || toRegionId >= navmeshes.size()) {
+		return {};
+	}
+
+	// Which portals are best to leave and enter through depends on the positions within the regions, so nearby queries are always searched
+	// Beyond that, reusing the route found for other positions in the same regions only changes the result marginally
+	constexpr int minCachedGridDistance = 3;
+	const int gridDistance = (navmeshes[fromRegionId].getWorldGridPos() - navmeshes[toRegionId].getWorldGridPos()).manhattanLength();
+	if (gridDistance < minCachedGridDistance) {
+		return findRegionPath(startPos, endPos, fromRegionId, toRegionId);
+	}
+
+	const uint32_t key = (static_cast<uint32_t>(fromRegionId) << 16) | toRegionId;
+	if (auto cached = regionPathCache.get(key, connectivityVersion)) {
+		return std::move(cached.value());
+	}
+
+	auto result = findRegionPath(startPos, endPos, fromRegionId, toRegionId);
+	regionPathCache.put(key, connectivityVersion, result);
+	return result;
+}
+
 std::vector<NavmeshSet::NodeAndConn> NavmeshSet::findRegionPath(Vector2f startPos, Vector2f endPos, NodeId fromRegionId, NodeId toRegionId) const
 {
 	// Ensure the query is valid
@@ -232,13 +308,12 @@ std::vector<NavmeshSet::NodeAndConn> NavmeshSet::findRegionPath(Vector2f startPo
 		return {};
 	}
 
-	// State map. Using vector for perf, trading space for CPU.
-	// TODO: measure this vs unordered_map or some other hashtable, it's not impossible that it'd perform better (compact memory)
-	std::vector<State> state(portalNodes.size(), State{});
+	// State map, kept per thread so it's not allocated and cleared for every query
+	thread_local Scratch state;
+	state.begin(portalNodes.size());
 
 	// Open set
-	auto openSet = PriorityQueue<NodeId, NodeComparator>(NodeComparator(state));
-	openSet.reserve(std::min(static_cast<size_t>(100), portalNodes.size()));
+	auto& openSet = state.getOpenSet();
 
 	// Define heuristic function
 	auto h = [&] (Vector2f pos) -> float
@@ -332,3 +407,89 @@ std::pair<uint16_t, uint16_t> NavmeshSet::getPortalDestination(uint16_t region,
 	
 	return { maxVal, maxVal };
 }
+
+NavmeshSet::ConnectivityVersion& NavmeshSet::ConnectivityVersion::operator=(const ConnectivityVersion& other)
+{
+	// Anything derived from the set being assigned to is now stale, and the other set's version is unrelated to what it last saw
+	++value;
+	return *this;
+}
+
+NavmeshSet::RegionPathCache::RegionPathCache(const RegionPathCache& other)
+	: maxSize(other.maxSize)
+{
+}
+
+NavmeshSet::RegionPathCache& NavmeshSet::RegionPathCache::operator=(const RegionPathCache& other)
+{
+	// Cached routes refer to region indices of the set they were found in, so they're never copied
+	std::unique_lock<std::mutex> lock(mutex);
+	entries.clear();
+	lru.clear();
+	maxSize = other.maxSize;
+	return *this;
+}
+
+std::optional<std::vector<NavmeshSet::NodeAndConn>> NavmeshSet::RegionPathCache::get(uint32_t key, uint32_t curVersion)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	clearIfStale(curVersion);
+
+	const auto iter = entries.find(key);
+	if (iter == entries.end()) {
+		++misses;
+		return {};
+	}
+
+	++hits;
+	lru.splice(lru.begin(), lru, iter->second.lruPos);
+	return iter->second.path;
+}
+
+void NavmeshSet::RegionPathCache::put(uint32_t key, uint32_t curVersion, std::vector<NodeAndConn> path)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	clearIfStale(curVersion);
+	if (maxSize == 0 || entries.find(key) != entries.end()) {
+		return;
+	}
+
+	while (entries.size() >= maxSize) {
+		entries.erase(lru.back());
+		lru.pop_back();
+	}
+
+	lru.push_front(key);
+	entries[key] = Entry{ std::move(path), lru.begin() };
+}
+
+void NavmeshSet::RegionPathCache::setMaxSize(size_t size)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	maxSize = size;
+	while (entries.size() > maxSize) {
+		entries.erase(lru.back());
+		lru.pop_back();
+	}
+}
+
+size_t NavmeshSet::RegionPathCache::getHits() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return hits;
+}
+
+size_t NavmeshSet::RegionPathCache::getMisses() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return misses;
+}
+
+void NavmeshSet::RegionPathCache::clearIfStale(uint32_t curVersion)
+{
+	if (version != curVersion) {
+		entries.clear();
+		lru.clear();
+		version = curVersion;
+	}
+}
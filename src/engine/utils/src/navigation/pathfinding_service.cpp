@@ -0,0 +1,81 @@
+#include "halley/navigation/pathfinding_service.h"
+#include "halley/navigation/navmesh_set.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/support/logger.h"
+using namespace Halley;
+
+PathfindingService::PathfindingService(const NavmeshSet& navmeshSet, size_t queriesPerTask)
+	: PathfindingService(navmeshSet, Executors::getCPU(), queriesPerTask)
+{
+}
+
+PathfindingService::PathfindingService(const NavmeshSet& navmeshSet, ExecutionQueue& queue, size_t queriesPerTask)
+	: navmeshSet(navmeshSet)
+	, queue(queue)
+	, queriesPerTask(std::max(queriesPerTask, size_t(1)))
+{
+}
+
+PathfindingService::~PathfindingService()
+{
+	wait();
+}
+
+Future<std::optional<NavigationPath>> PathfindingService::pathfind(NavigationQuery query)
+{
+	Vector<NavigationQuery> queries;
+	queries.push_back(std::move(query));
+	return pathfind(std::move(queries)).front();
+}
+
+Vector<Future<std::optional<NavigationPath>>> PathfindingService::pathfind(Vector<NavigationQuery> queries)
+{
+	Vector<Future<std::optional<NavigationPath>>> result;
+	result.reserve(queries.size());
+
+	std::unique_lock<std::mutex> lock(mutex);
+	tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [] (const Future<void>& f) { return f.isReady(); }), tasks.end());
+
+	for (size_t start = 0; start < queries.size(); start += queriesPerTask) {
+		const size_t end = std::min(start + queriesPerTask, queries.size());
+
+		Vector<std::pair<NavigationQuery, Promise<std::optional<NavigationPath>>>> batch;
+		batch.reserve(end - start);
+		for (size_t i = start; i < end; ++i) {
+			batch.emplace_back(std::move(queries[i]), Promise<std::optional<NavigationPath>>());
+			result.push_back(batch.back().second.getFuture());
+		}
+
+		// Navmesh and NavmeshSet keep their search state per thread, so queries on the same worker don't allocate it again
+		tasks.push_back(Concurrent::execute(queue, [this, batch = std::move(batch)] () mutable
+		{
+			// Every promise has to be set, or whoever is waiting on it will wait forever
+			for (auto& [query, promise]: batch) {
+				std::optional<NavigationPath> path;
+				try {
+					path = navmeshSet.pathfind(query);
+				} catch (const std::exception& e) {
+					Logger::logError("Error while pathfinding: " + String(e.what()));
+				} catch (...) {
+					Logger::logError("Unknown error while pathfinding");
+				}
+				promise.setValue(std::move(path));
+			}
+		}));
+	}
+
+	return result;
+}
+
+void PathfindingService::wait()
+{
+	Vector<Future<void>> pending;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		pending = std::move(tasks);
+		tasks.clear();
+	}
+	for (auto& task: pending) {
+		task.wait();
+	}
+}
@@ -11,6 +11,11 @@ DX11Texture::DX11Texture(DX11Video& video, Vector2i size)
 }
 
 DX11Texture::~DX11Texture()
+{
+	releaseResources();
+}
+
+void DX11Texture::releaseResources()
 {
 	if (samplerState) {
 		samplerState->Release();
@@ -66,6 +71,21 @@ static D3D11_TEXTURE_ADDRESS_MODE getAddressMode(TextureAddressMode mode)
 
 void DX11Texture::doLoad(TextureDescriptor& descriptor)
 {
+	if (texture && descriptor.canBeUpdated && !descriptor.pixelData.empty()) {
+		// Loading again into an updatable texture of the same shape just replaces its contents, keeping the views and sampler
+		D3D11_TEXTURE2D_DESC curDesc;
+		texture->GetDesc(&curDesc);
+		const int bpp = descriptor.format == TextureFormat::RGBA ? 4 : 1;
+		if (curDesc.Usage == D3D11_USAGE_DEFAULT && int(curDesc.Width) == size.x && int(curDesc.Height) == size.y && curDesc.Format == getDXFormat(descriptor.format)) {
+			video.getDeviceContext().UpdateSubresource(texture, 0, nullptr, descriptor.pixelData.getSpan().data(), descriptor.pixelData.getStrideOr(bpp * size.x), 0);
+			doneLoading();
+			return;
+		}
+	}
+
+	// Anything created by a previous load would otherwise leak
+	releaseResources();
+
 	int bpp = 0;
 
 	CD3D11_TEXTURE2D_DESC desc;
@@ -187,6 +207,21 @@ void DX11Texture::bind(DX11Video& video, int textureUnit, TextureSamplerType sam
 	video.getDeviceContext().PSSetSamplers(textureUnit, 1, samplers);
 }
 
+DXGI_FORMAT DX11Texture::getDXFormat(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::Indexed:
+	case TextureFormat::Red:
+		return DXGI_FORMAT_R8_UNORM;
+	case TextureFormat::RGBA:
+		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case TextureFormat::Depth:
+		return DXGI_FORMAT_R24G8_TYPELESS;
+	default:
+		return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
 DXGI_FORMAT DX11Texture::getFormat() const
 {
 	return format;
@@ -33,5 +33,8 @@ namespace Halley
 		ID3D11ShaderResourceView* srvAlt = nullptr;
 		ID3D11SamplerState* samplerState = nullptr;
 		DXGI_FORMAT format;
+
+		void releaseResources();
+		static DXGI_FORMAT getDXFormat(TextureFormat format);
 	};
 }
@@ -7,6 +7,7 @@
 #include "sdl_rw_ops.h"
 #include "halley/core/graphics/window.h"
 #include "halley/os/os.h"
+#include "halley/file/memory_mapped_file.h"
 #include "sdl_window.h"
 #include "sdl_gl_context.h"
 #include "input_sdl.h"
@@ -168,6 +169,14 @@ std::unique_ptr<ResourceDataReader> SystemSDL::getDataReader(String path, int64_
 	return SDLRWOps::fromPath(path, start, end);
 }
 
+std::unique_ptr<ResourceDataReader> SystemSDL::getMappedDataReader(String path)
+{
+	if (auto mapped = MemoryMappedFileReader::open(path)) {
+		return mapped;
+	}
+	return SDLRWOps::fromPath(path, 0, -1);
+}
+
 std::shared_ptr<Window> SystemSDL::createWindow(const WindowDefinition& windowDef)
 {
 	initVideo();
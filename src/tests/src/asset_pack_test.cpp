@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include "resources/asset_pack.h"
+#include "resources/asset_database.h"
+using namespace Halley;
+
+namespace {
+	Bytes makeBytes(const std::string& str)
+	{
+		Bytes result(str.size());
+		memcpy(result.data(), str.data(), str.size());
+		return result;
+	}
+
+	// Reads from memory, but without exposing it as a mapping, like a pack on disk
+	class CountingReader final : public ResourceDataReader {
+	public:
+		CountingReader(Bytes bytes, int& reads)
+			: bytes(std::move(bytes))
+			, reads(reads)
+		{}
+
+		size_t size() const override { return bytes.size(); }
+		size_t tell() const override { return pos; }
+		void close() override {}
+
+		int read(gsl::span<gsl::byte> dst) override
+		{
+			++reads;
+			const size_t n = std::min(size_t(dst.size()), bytes.size() - pos);
+			memcpy(dst.data(), bytes.data() + pos, n);
+			pos += n;
+			return int(n);
+		}
+
+		void seek(int64_t offset, int whence) override
+		{
+			if (whence == SEEK_SET) {
+				pos = size_t(offset);
+			} else if (whence == SEEK_CUR) {
+				pos = size_t(int64_t(pos) + offset);
+			} else {
+				pos = size_t(int64_t(bytes.size()) + offset);
+			}
+		}
+
+	private:
+		Bytes bytes;
+		int& reads;
+		size_t pos = 0;
+	};
+
+	String readAsset(AssetPack& pack, const String& name)
+	{
+		auto data = pack.getData(name, AssetType::ConfigFile, false);
+		const auto* staticData = dynamic_cast<ResourceDataStatic*>(data.get());
+		const auto span = staticData->getSpan();
+		return String(reinterpret_cast<const char*>(span.data()), span.size());
+	}
+}
+
+TEST(HalleyAssetPack, IndexSurvivesSerialization)
+{
+	AssetDatabase db;
+	db.addPackedAsset("b", AssetType::ConfigFile, 5, 3, Metadata());
+	db.addPackedAsset("a", AssetType::ConfigFile, 0, 5, Metadata());
+
+	AssetPack pack;
+	Deserializer::fromBytes(pack.getAssetDatabase(), Serializer::toBytes(db));
+	pack.getData() = makeBytes("helloabc");
+
+	ASSERT_EQ(pack.getAssetDatabase().getPackIndex().size(), size_t(2));
+	EXPECT_EQ(readAsset(pack, "a"), "hello");
+	EXPECT_EQ(readAsset(pack, "b"), "abc");
+}
+
+TEST(HalleyAssetPack, FallsBackToPathWithoutIndex)
+{
+	// Packs built before the index existed only have "pos:size" in the path
+	AssetPack pack;
+	pack.getAssetDatabase().addAsset("a", AssetType::ConfigFile, AssetDatabase::Entry("3:4", Metadata()));
+	pack.getData() = makeBytes("0123456789");
+
+	EXPECT_TRUE(pack.getAssetDatabase().getPackIndex().empty());
+	EXPECT_EQ(readAsset(pack, "a"), "3456");
+}
+
+TEST(HalleyAssetPack, PrefetchCoalescesReads)
+{
+	AssetPack source;
+	auto& db = source.getAssetDatabase();
+	db.addPackedAsset("a", AssetType::ConfigFile, 0, 5, Metadata());
+	db.addPackedAsset("b", AssetType::ConfigFile, 5, 3, Metadata());
+	db.addPackedAsset("c", AssetType::ConfigFile, 200000, 4, Metadata());
+	source.getData() = Bytes(200004);
+	memcpy(source.getData().data(), "helloabc", 8);
+	memcpy(source.getData().data() + 200000, "far!", 4);
+
+	int reads = 0;
+	AssetPack pack(std::make_unique<CountingReader>(source.writeOut(), reads));
+	reads = 0;
+
+	// a and b are next to each other, c is too far away to read with them
+	auto key = [] (const String& name) { return AssetDatabase::getKey(AssetType::ConfigFile, name); };
+	const Vector<uint64_t> keys = { key("a"), key("b"), key("c") };
+	EXPECT_TRUE(pack.prefetch(keys).isReady()); // No Executors, so it's read right away
+	EXPECT_EQ(reads, 2);
+	EXPECT_EQ(pack.getPrefetchedBytes(), size_t(8 + 4));
+
+	EXPECT_EQ(readAsset(pack, "a"), "hello");
+	EXPECT_EQ(readAsset(pack, "b"), "abc");
+	EXPECT_EQ(pack.getPrefetchedBytes(), size_t(4));
+
+	// Asking for c again keeps its block until both requests are done
+	EXPECT_TRUE(pack.prefetch({ key("c") }).isReady());
+	EXPECT_EQ(readAsset(pack, "c"), "far!");
+	EXPECT_EQ(pack.getPrefetchedBytes(), size_t(4));
+	EXPECT_EQ(readAsset(pack, "c"), "far!");
+	EXPECT_EQ(pack.getPrefetchedBytes(), size_t(0));
+	EXPECT_EQ(reads, 2);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include "audio_mixer.h"
+using namespace Halley;
+
+namespace {
+	Vector<AudioSamplePack> makePacks(Random& rng, size_t n, float range)
+	{
+		Vector<AudioSamplePack> result(n);
+		for (auto& pack: result) {
+			for (auto& sample: pack.samples) {
+				sample = rng.getFloat(-range, range);
+			}
+		}
+		return result;
+	}
+
+	void expectSame(const Vector<AudioSamplePack>& a, const Vector<AudioSamplePack>& b, float tolerance)
+	{
+		ASSERT_EQ(a.size(), b.size());
+		for (size_t i = 0; i < a.size(); ++i) {
+			for (size_t j = 0; j < AudioSamplePack::NumSamples; ++j) {
+				if (tolerance == 0) {
+					ASSERT_EQ(a[i].samples[j], b[i].samples[j]) << "pack " << i << ", sample " << j;
+				} else {
+					ASSERT_NEAR(a[i].samples[j], b[i].samples[j], tolerance) << "pack " << i << ", sample " << j;
+				}
+			}
+		}
+	}
+}
+
+TEST(HalleyAudioMixer, KernelsMatchScalar)
+{
+	auto mixers = AudioMixer::makeAllSupportedMixers();
+	auto& reference = *mixers[0];
+	Random rng(uint32_t(1234));
+
+	for (size_t m = 1; m < mixers.size(); ++m) {
+		auto& mixer = *mixers[m];
+		SCOPED_TRACE(mixer.getName());
+
+		// Mixing, with constant and interpolated gain
+		for (const auto [gain0, gain1]: { std::pair(0.7f, 0.7f), std::pair(0.2f, 1.3f) }) {
+			const auto src = makePacks(rng, 64, 1.0f);
+			auto expected = makePacks(rng, 64, 1.0f);
+			auto actual = expected;
+			reference.mixAudio(src, expected, gain0, gain1);
+			mixer.mixAudio(src, actual, gain0, gain1);
+			expectSame(expected, actual, 0.00001f);
+		}
+
+		// Interleaving, including an odd number of output packs
+		for (const size_t nPacks: { size_t(64), size_t(33) }) {
+			AudioBuffer left;
+			AudioBuffer right;
+			left.packs = makePacks(rng, (nPacks + 1) / 2, 1.0f);
+			right.packs = makePacks(rng, (nPacks + 1) / 2, 1.0f);
+			std::array<AudioBuffer*, 2> srcs = { &left, &right };
+			Vector<AudioSamplePack> expected(nPacks);
+			Vector<AudioSamplePack> actual(nPacks);
+			reference.interleaveChannels(expected, srcs);
+			mixer.interleaveChannels(actual, srcs);
+			expectSame(expected, actual, 0);
+		}
+
+		// Clamping
+		{
+			auto expected = makePacks(rng, 64, 2.0f);
+			auto actual = expected;
+			reference.compressRange(expected);
+			mixer.compressRange(actual);
+			expectSame(expected, actual, 0);
+		}
+
+		// Integer conversion, with lengths that leave a remainder and values out of range
+		{
+			Vector<float> src(1003);
+			for (auto& s: src) {
+				s = rng.getFloat(-1.5f, 1.5f);
+			}
+			src[0] = 1.0f;
+			src[1] = -1.0f;
+			src[2] = 100000.0f;
+			src[3] = -100000.0f;
+
+			Vector<short> expected16(src.size());
+			Vector<short> actual16(src.size());
+			reference.convertToInt16(src, expected16);
+			mixer.convertToInt16(src, actual16);
+			EXPECT_EQ(expected16, actual16);
+			EXPECT_EQ(expected16[0], 32767);
+			EXPECT_EQ(expected16[1], -32768);
+
+			Vector<int> expected32(src.size());
+			Vector<int> actual32(src.size());
+			reference.convertToInt32(src, expected32);
+			mixer.convertToInt32(src, actual32);
+			EXPECT_EQ(expected32, actual32);
+			EXPECT_GT(expected32[0], 2147483000);
+			EXPECT_EQ(expected32[1], std::numeric_limits<int>::min());
+		}
+	}
+}
+
+TEST(HalleyAudioMixer, MakeMixerPicksFastest)
+{
+	auto mixers = AudioMixer::makeAllSupportedMixers();
+	ASSERT_FALSE(mixers.empty());
+	EXPECT_STREQ(AudioMixer::makeMixer()->getName(), mixers.back()->getName());
+#if defined(_M_X64) || defined(__x86_64__)
+	EXPECT_GE(mixers.size(), size_t(2));
+#endif
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include <limits>
+using namespace Halley;
+
+namespace {
+	using Id = Broadphase2D::Id;
+
+	Rect4f makeBox(Random& rng)
+	{
+		const auto p = Vector2f(rng.getFloat(-1000, 1000), rng.getFloat(-1000, 1000));
+		const auto size = rng.getInt(int32_t(0), int32_t(9)) == 0 ? Vector2f(rng.getFloat(200, 600), rng.getFloat(200, 600)) : Vector2f(rng.getFloat(0, 60), rng.getFloat(0, 60));
+		return Rect4f(p, p + size);
+	}
+
+	bool overlaps(const Rect4f& a, const Rect4f& b)
+	{
+		return !(a.getBottomRight().x < b.getTopLeft().x || b.getBottomRight().x < a.getTopLeft().x || a.getBottomRight().y < b.getTopLeft().y || b.getBottomRight().y < a.getTopLeft().y);
+	}
+
+	std::optional<float> castBox(const Ray& ray, const Rect4f& box, float maxDistance)
+	{
+		float tMin = 0;
+		float tMax = maxDistance;
+		for (int axis = 0; axis < 2; ++axis) {
+			const float p = axis == 0 ? ray.p.x : ray.p.y;
+			const float d = axis == 0 ? ray.dir.x : ray.dir.y;
+			const float lo = axis == 0 ? box.getTopLeft().x : box.getTopLeft().y;
+			const float hi = axis == 0 ? box.getBottomRight().x : box.getBottomRight().y;
+			if (std::abs(d) < 0.000001f) {
+				if (p < lo || p > hi) {
+					return {};
+				}
+			} else {
+				const float t1 = std::min((lo - p) / d, (hi - p) / d);
+				const float t2 = std::max((lo - p) / d, (hi - p) / d);
+				tMin = std::max(tMin, t1);
+				tMax = std::min(tMax, t2);
+				if (tMin > tMax) {
+					return {};
+				}
+			}
+		}
+		return tMin;
+	}
+
+	// Reference implementations, testing every box
+	class BruteForce {
+	public:
+		HashMap<Id, Rect4f> boxes;
+
+		Vector<Id> queryOverlaps(Rect4f area) const
+		{
+			Vector<Id> result;
+			for (const auto& [id, box]: boxes) {
+				if (overlaps(box, area)) {
+					result.push_back(id);
+				}
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		}
+
+		std::optional<float> raycast(Ray ray, float maxDistance) const
+		{
+			std::optional<float> best;
+			for (const auto& [id, box]: boxes) {
+				const auto hit = castBox(ray, box, maxDistance);
+				if (hit && (!best || *hit < *best)) {
+					best = hit;
+				}
+			}
+			return best;
+		}
+	};
+
+	Vector<Id> sorted(Vector<Id> ids)
+	{
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	void checkQueries(const Broadphase2D& broadphase, const BruteForce& reference, Random& rng)
+	{
+		ASSERT_EQ(broadphase.size(), reference.boxes.size());
+
+		for (int i = 0; i < 50; ++i) {
+			const auto area = makeBox(rng);
+			Vector<Id> result;
+			broadphase.queryOverlaps(area, result);
+			EXPECT_EQ(sorted(result), reference.queryOverlaps(area));
+		}
+
+		for (int i = 0; i < 50; ++i) {
+			const float angle = rng.getFloat(0, float(2 * pi()));
+			const auto ray = Ray(Vector2f(rng.getFloat(-1500, 1500), rng.getFloat(-1500, 1500)), Vector2f(std::cos(angle), std::sin(angle)));
+			const float maxDistance = i % 2 == 0 ? std::numeric_limits<float>::infinity() : rng.getFloat(0, 800);
+
+			const auto result = broadphase.raycast(ray, maxDistance);
+			const auto expected = reference.raycast(ray, maxDistance);
+			ASSERT_EQ(result.has_value(), expected.has_value());
+			if (result) {
+				EXPECT_FLOAT_EQ(result->distance, *expected);
+				EXPECT_FLOAT_EQ(castBox(ray, reference.boxes.at(result->id), maxDistance).value(), *expected);
+			}
+		}
+	}
+}
+
+TEST(HalleyBroadphase, MatchesBruteForce)
+{
+	Random rng(uint32_t(777));
+	Broadphase2D broadphase(64.0f);
+	BruteForce reference;
+
+	for (Id id = 0; id < 300; ++id) {
+		const auto box = makeBox(rng);
+		broadphase.add(id, box);
+		reference.boxes[id] = box;
+	}
+	checkQueries(broadphase, reference, rng);
+
+	// Move some, across cells or not
+	for (Id id = 0; id < 300; id += 3) {
+		const auto box = id % 2 == 0 ? makeBox(rng) : reference.boxes[id] + Vector2f(rng.getFloat(-5, 5), rng.getFloat(-5, 5));
+		broadphase.update(id, box);
+		reference.boxes[id] = box;
+	}
+	checkQueries(broadphase, reference, rng);
+
+	// Remove some, then shrink the margin
+	for (Id id = 0; id < 300; id += 4) {
+		EXPECT_TRUE(broadphase.remove(id));
+		reference.boxes.erase(id);
+	}
+	EXPECT_FALSE(broadphase.remove(0));
+	broadphase.shrinkMargin();
+	checkQueries(broadphase, reference, rng);
+	for (const auto& [id, box]: reference.boxes) {
+		EXPECT_EQ(broadphase.getBounds(id), std::optional<Rect4f>(box));
+	}
+}
+
+TEST(HalleyBroadphase, RaycastWithInfiniteDistanceTerminates)
+{
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+	Broadphase2D broadphase(32.0f);
+	broadphase.add(1, Rect4f(Vector2f(100, 100), Vector2f(120, 120)));
+
+	// Pointing away from the only box, along an axis and diagonally
+	EXPECT_FALSE(broadphase.raycast(Ray(Vector2f(0, 110), Vector2f(-1, 0)), infinity).has_value());
+	EXPECT_FALSE(broadphase.raycast(Ray(Vector2f(0, 0), Vector2f(-1, -1).normalized()), infinity).has_value());
+	EXPECT_FALSE(broadphase.raycast(Ray(Vector2f(0, 0), Vector2f(1, 0)), infinity).has_value());
+
+	const auto hit = broadphase.raycast(Ray(Vector2f(0, 110), Vector2f(1, 0)), infinity);
+	ASSERT_TRUE(hit.has_value());
+	EXPECT_EQ(hit->id, Id(1));
+	EXPECT_FLOAT_EQ(hit->distance, 100.0f);
+
+	broadphase.clear();
+	EXPECT_FALSE(broadphase.raycast(Ray(Vector2f(0, 110), Vector2f(1, 0)), infinity).has_value());
+}
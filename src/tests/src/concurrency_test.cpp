@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+using namespace Halley;
+
+namespace {
+	ThreadPool::MakeThread makeThread()
+	{
+		return [] (String name, std::function<void()> f) { return std::thread(std::move(f)); };
+	}
+}
+
+TEST(HalleyConcurrency, ParallelFor)
+{
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 4, makeThread());
+
+	std::vector<int> values(100000, 0);
+	Concurrent::parallelFor(queue, 0, values.size(), [&] (size_t i) {
+		values[i] += int(i % 7);
+	});
+
+	for (size_t i = 0; i < values.size(); ++i) {
+		EXPECT_EQ(values[i], int(i % 7));
+	}
+}
+
+TEST(HalleyConcurrency, ParallelForWithoutThreads)
+{
+	ExecutionQueue queue;
+
+	std::atomic<int> total = 0;
+	Concurrent::parallelFor(queue, 10, 20, [&] (size_t i) {
+		total += int(i);
+	});
+
+	EXPECT_EQ(total.load(), 145);
+}
+
+TEST(HalleyConcurrency, NestedWaits)
+{
+	// More tasks waiting on sub-tasks than there are threads; waiting workers have to help for this to finish
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 2, makeThread());
+
+	std::vector<Future<int>> outer;
+	for (int i = 0; i < 16; ++i) {
+		outer.push_back(Concurrent::execute(queue, [&queue, i] () {
+			auto inner = Concurrent::execute(queue, [i] () { return i * 2; });
+			return inner.get() + 1;
+		}));
+	}
+
+	int total = 0;
+	for (auto& f: outer) {
+		total += f.get();
+	}
+	EXPECT_EQ(total, 16 * 15 + 16);
+}
+
+TEST(HalleyConcurrency, SizePoolAcrossThreads)
+{
+	// Blocks allocated on one thread and freed on another must all end up reusable
+	SizePool pool(24);
+	std::vector<std::vector<void*>> perThread(4);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < perThread.size(); ++t) {
+		threads.emplace_back([&pool, &blocks = perThread[t]] () {
+			for (int i = 0; i < 10000; ++i) {
+				blocks.push_back(pool.alloc());
+				memset(blocks.back(), 0xAB, 24);
+			}
+		});
+	}
+	for (auto& t: threads) {
+		t.join();
+	}
+	threads.clear();
+
+	std::set<void*> unique;
+	for (auto& blocks: perThread) {
+		unique.insert(blocks.begin(), blocks.end());
+	}
+	EXPECT_EQ(unique.size(), size_t(40000));
+
+	for (size_t t = 0; t < perThread.size(); ++t) {
+		threads.emplace_back([&pool, &blocks = perThread[(t + 1) % perThread.size()]] () {
+			for (auto* b: blocks) {
+				pool.free(b);
+			}
+		});
+	}
+	for (auto& t: threads) {
+		t.join();
+	}
+}
+
+TEST(HalleyConcurrency, ParallelForRethrows)
+{
+	// Every helper has to be done with the lambda (which references locals) before the exception reaches the caller
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 4, makeThread());
+
+	std::atomic<int> running = 0;
+	std::atomic<int> runningAtThrow = -1;
+	try {
+		Concurrent::parallelFor(queue, 0, 10000, [&] (size_t i) {
+			++running;
+			if (i == 5000) {
+				--running;
+				throw Exception("Test", HalleyExceptions::Utils);
+			}
+			--running;
+		});
+	} catch (const Exception&) {
+		runningAtThrow = running.load();
+	}
+
+	EXPECT_EQ(runningAtThrow.load(), 0);
+}
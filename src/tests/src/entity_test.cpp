@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+using namespace Halley;
+
+namespace {
+	ThreadPool::MakeThread makeThread()
+	{
+		return [] (String name, std::function<void()> f) { return std::thread(std::move(f)); };
+	}
+
+	class TestCoreAPI final : public CoreAPI {
+	public:
+		void quit(int exitCode) override {}
+		void setStage(StageID stage) override {}
+		void setStage(std::unique_ptr<Stage> stage) override {}
+		void initStage(Stage& stage) override {}
+		Stage& getCurrentStage() override { throw Exception("Not available in tests", HalleyExceptions::Core); }
+		HalleyStatics& getStatics() override { throw Exception("Not available in tests", HalleyExceptions::Core); }
+		const Environment& getEnvironment() override { throw Exception("Not available in tests", HalleyExceptions::Core); }
+		int64_t getTime(CoreAPITimer timer, TimeLine tl, StopwatchRollingAveraging::Mode mode) const override { return 0; }
+		void setTimerPaused(CoreAPITimer timer, TimeLine tl, bool paused) override {}
+		bool isDevMode() override { return false; }
+	};
+
+	// Equivalent to what codegen generates
+	class PositionComponent final : public Component {
+	public:
+		static constexpr int componentIndex{ 0 };
+		static const constexpr char* componentName{ "Position" };
+
+		Vector2f position;
+
+		PositionComponent() = default;
+		PositionComponent(Vector2f position) : position(position) {}
+	};
+
+	class VelocityComponent final : public Component {
+	public:
+		static constexpr int componentIndex{ 1 };
+		static const constexpr char* componentName{ "Velocity" };
+
+		Vector2f velocity;
+
+		VelocityComponent() = default;
+		VelocityComponent(Vector2f velocity) : velocity(velocity) {}
+	};
+
+	class MovingFamily : public FamilyBaseOf<MovingFamily> {
+	public:
+		PositionComponent& position;
+		const VelocityComponent& velocity;
+
+		using Type = FamilyType<PositionComponent, VelocityComponent>;
+
+	protected:
+		MovingFamily(PositionComponent& position, const VelocityComponent& velocity)
+			: position(position)
+			, velocity(velocity)
+		{}
+	};
+
+	class ReloadRecorder final : public FamilyBinding<MovingFamily> {
+	public:
+		Vector<EntityId> reloaded;
+
+		explicit ReloadRecorder(World& world)
+		{
+			bindFamily(*this, world);
+			// Unlike additions, reloads are delivered as pointers to the family elements
+			setOnEntitiesReloaded([this] (void* entities, size_t count)
+			{
+				for (size_t i = 0; i < count; ++i) {
+					reloaded.push_back(static_cast<MovingFamily**>(entities)[i]->entityId);
+				}
+			});
+		}
+	};
+
+	class EntityTest : public ::testing::TestWithParam<bool> {
+	protected:
+		TestCoreAPI core;
+		HalleyAPI api{};
+		std::unique_ptr<Resources> resources;
+		std::unique_ptr<World> world;
+
+		void SetUp() override
+		{
+			api.core = &core;
+			resources = std::make_unique<Resources>(nullptr, api, Resources::Options());
+			world = std::make_unique<World>(api, *resources, false, CreateComponentFunction());
+			world->setArchetypeStorageEnabled(GetParam());
+		}
+
+		void TearDown() override
+		{
+			world.reset();
+			resources.reset();
+		}
+
+		// What the family exposes, checked against the entities' own components
+		void checkFamily(Family& family, const Vector<EntityId>& expected)
+		{
+			ASSERT_EQ(family.count(), expected.size());
+			for (size_t i = 0; i < family.count(); ++i) {
+				auto& elem = *static_cast<MovingFamily*>(family.getElement(i));
+				EXPECT_NE(std::find(expected.begin(), expected.end(), elem.entityId), expected.end());
+
+				auto e = world->getEntity(elem.entityId);
+				EXPECT_EQ(&elem.position, &e.getComponent<PositionComponent>());
+				EXPECT_EQ(&elem.velocity, &e.getComponent<VelocityComponent>());
+			}
+		}
+	};
+}
+
+TEST_P(EntityTest, FamiliesFollowComponentChurn)
+{
+	auto& family = world->getFamily<MovingFamily>();
+
+	Vector<EntityId> ids;
+	for (int i = 0; i < 50; ++i) {
+		auto e = world->createEntity("e" + toString(i));
+		e.addComponent(PositionComponent(Vector2f(float(i), 0)));
+		if (i % 2 == 0) {
+			e.addComponent(VelocityComponent(Vector2f(0, float(i))));
+			ids.push_back(e.getEntityId());
+		}
+	}
+	world->spawnPending();
+	checkFamily(family, ids);
+
+	// Remove and re-add within the same update, leaving the mask as it was
+	for (auto id: ids) {
+		auto e = world->getEntity(id);
+		const auto velocity = e.getComponent<VelocityComponent>().velocity;
+		e.removeComponent<VelocityComponent>();
+		e.addComponent(VelocityComponent(velocity * 2));
+	}
+	world->spawnPending();
+	checkFamily(family, ids);
+	for (size_t i = 0; i < family.count(); ++i) {
+		auto& elem = *static_cast<MovingFamily*>(family.getElement(i));
+		EXPECT_FLOAT_EQ(elem.velocity.velocity.y, elem.position.position.x * 2);
+	}
+
+	// Move entities in and out of the family, and destroy some
+	Vector<EntityId> newIds;
+	for (auto& e: world->getEntities()) {
+		const int i = int(e.getComponent<PositionComponent>().position.x);
+		if (i % 3 == 0) {
+			world->destroyEntity(e);
+		} else if (e.hasComponent<VelocityComponent>()) {
+			e.removeComponent<VelocityComponent>();
+		} else {
+			e.addComponent(VelocityComponent());
+			newIds.push_back(e.getEntityId());
+		}
+	}
+	world->spawnPending();
+	checkFamily(family, newIds);
+}
+
+TEST_P(EntityTest, ReloadIsDeliveredOnce)
+{
+	ReloadRecorder recorder(*world);
+
+	// Reloaded before it spawned
+	auto e = world->createEntity("e");
+	e.addComponent(PositionComponent());
+	e.addComponent(VelocityComponent());
+	e.setReloaded();
+	world->spawnPending();
+	EXPECT_EQ(recorder.reloaded, Vector<EntityId>({ e.getEntityId() }));
+	EXPECT_FALSE(e.wasReloaded());
+
+	world->spawnPending();
+	EXPECT_EQ(recorder.reloaded.size(), size_t(1));
+
+	// Reloaded twice in the same update
+	e.setReloaded();
+	e.setReloaded();
+	world->spawnPending();
+	EXPECT_EQ(recorder.reloaded, Vector<EntityId>({ e.getEntityId(), e.getEntityId() }));
+}
+
+TEST_P(EntityTest, FindEntityWithSharedUUID)
+{
+	const auto uuid = UUID::generate();
+	const auto older = world->createEntity(uuid, "older").getEntityId();
+	const auto newer = world->createEntity(uuid, "newer").getEntityId();
+	world->spawnPending();
+	EXPECT_EQ(world->findEntity(uuid)->getEntityId(), newer);
+
+	// The older one must still be found while the newer one is dying and once it's gone
+	world->destroyEntity(newer);
+	EXPECT_EQ(world->findEntity(uuid)->getEntityId(), older);
+	world->spawnPending();
+	EXPECT_EQ(world->findEntity(uuid)->getEntityId(), older);
+
+	world->destroyEntity(older);
+	world->spawnPending();
+	EXPECT_FALSE(world->findEntity(uuid).has_value());
+}
+
+TEST_P(EntityTest, CommandBufferPlayback)
+{
+	auto& family = world->getFamily<MovingFamily>();
+	const auto gains = world->createEntity("gains").addComponent(PositionComponent(Vector2f(-1, 0))).getEntityId();
+	const auto loses = world->createEntity("loses").addComponent(PositionComponent(Vector2f(-2, 0))).addComponent(VelocityComponent()).getEntityId();
+	const auto doomed = world->createEntity("doomed").addComponent(PositionComponent(Vector2f(-3, 0))).getEntityId();
+	world->spawnPending();
+	checkFamily(family, { loses });
+
+	// Recorded from worker threads, keyed by index so that playback doesn't depend on scheduling
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 4, makeThread());
+	Concurrent::parallelFor(queue, 0, 20, [&] (size_t i)
+	{
+		auto& buffer = world->getCommandBuffer();
+		buffer.setSortKey(i);
+		const auto e = buffer.createEntity("spawned" + toString(i));
+		buffer.addComponent(e, PositionComponent(Vector2f(float(i), 0)));
+		buffer.addComponent(e, VelocityComponent(Vector2f(0, float(i))));
+	});
+
+	auto& buffer = world->getCommandBuffer();
+	buffer.setSortKey(100);
+	buffer.addComponent(gains, VelocityComponent(Vector2f(0, -1)));
+	buffer.removeComponent<VelocityComponent>(loses);
+	buffer.destroyEntity(doomed);
+	buffer.destroyEntity(doomed); // Already dead by then, so ignored
+
+	// Nothing happens until playback
+	EXPECT_EQ(world->numEntities(), size_t(3));
+	world->playbackCommandBuffers();
+	world->spawnPending();
+
+	EXPECT_EQ(world->tryGetRawEntity(doomed), nullptr);
+	Vector<EntityId> expected = { gains };
+	std::set<String> spawned;
+	for (auto& e: world->getEntities()) {
+		if (e.getName().startsWith("spawned")) {
+			spawned.insert(e.getName());
+			expected.push_back(e.getEntityId());
+		}
+	}
+	EXPECT_EQ(spawned.size(), size_t(20));
+	checkFamily(family, expected);
+	for (size_t i = 0; i < family.count(); ++i) {
+		auto& elem = *static_cast<MovingFamily*>(family.getElement(i));
+		EXPECT_FLOAT_EQ(elem.velocity.velocity.y, elem.position.position.x);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(HalleyEntity, EntityTest, ::testing::Values(false, true));
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include "dummy/dummy_video.h"
+using namespace Halley;
+
+namespace {
+	std::shared_ptr<MaterialDefinition> makeTextMaterial()
+	{
+		ConfigNode::MapType texture;
+		texture["name"] = ConfigNode(String("tex0"));
+		ConfigNode::SequenceType textures;
+		textures.emplace_back(std::move(texture));
+
+		ConfigNode::MapType root;
+		root["name"] = ConfigNode(String("Test/Text"));
+		root["textures"] = ConfigNode(std::move(textures));
+
+		auto definition = std::make_shared<MaterialDefinition>();
+		definition->load(ConfigNode(std::move(root)));
+		return definition;
+	}
+
+	std::unique_ptr<Image> makeGlyph(Vector2i size)
+	{
+		auto image = std::make_unique<Image>(Image::Format::SingleChannel, size);
+		image->clear(255);
+		return image;
+	}
+
+	Rect4i toPixels(const FontAtlas::Location& location, Vector2i pageSize)
+	{
+		const auto p0 = Vector2i((location.area.getTopLeft() * Vector2f(pageSize)).round());
+		const auto p1 = Vector2i((location.area.getBottomRight() * Vector2f(pageSize)).round());
+		return Rect4i(p0, p1);
+	}
+}
+
+TEST(HalleyFontAtlas, ShelfPacking)
+{
+	DummyVideoAPI video;
+	const auto pageSize = Vector2i(128, 128);
+	FontAtlas atlas(video, makeTextMaterial(), FontAtlas::Settings{ pageSize, 4, 1 });
+
+	std::vector<Rect4i> placed;
+	Random rng(uint32_t(42));
+	for (int i = 0; i < 60; ++i) {
+		const auto size = Vector2i(rng.getInt(int32_t(4), int32_t(20)), rng.getInt(int32_t(4), int32_t(20)));
+		const auto location = atlas.add(*makeGlyph(size), {});
+		EXPECT_EQ(location.page, 0);
+
+		const auto rect = toPixels(location, pageSize);
+		EXPECT_EQ(rect.getSize(), size);
+		EXPECT_TRUE(rect.getLeft() >= 0 && rect.getTop() >= 0 && rect.getRight() <= pageSize.x && rect.getBottom() <= pageSize.y);
+		for (const auto& other: placed) {
+			EXPECT_FALSE(rect.overlaps(other)) << rect << " overlaps " << other;
+		}
+		placed.push_back(rect);
+	}
+
+	EXPECT_EQ(atlas.getNumPages(), size_t(1));
+	EXPECT_EQ(atlas.getGeneration(), 0u);
+}
+
+TEST(HalleyFontAtlas, EvictsLeastRecentlyUsedPage)
+{
+	DummyVideoAPI video;
+	const auto pageSize = Vector2i(32, 32);
+	FontAtlas atlas(video, makeTextMaterial(), FontAtlas::Settings{ pageSize, 2, 0 });
+
+	std::vector<int> evicted;
+	const auto onEvict = [&] (int page) { evicted.push_back(page); };
+	const auto glyph = makeGlyph(pageSize); // Fills a page
+
+	FrameArena::beginFrame();
+	EXPECT_EQ(atlas.add(*glyph, onEvict).page, 0);
+	FrameArena::beginFrame();
+	EXPECT_EQ(atlas.add(*glyph, onEvict).page, 1);
+	FrameArena::beginFrame();
+	atlas.markUsed(0);
+	FrameArena::beginFrame();
+
+	// Page 1 hasn't been used since before page 0
+	EXPECT_EQ(atlas.add(*glyph, onEvict).page, 1);
+	EXPECT_EQ(evicted, std::vector<int>({ 1 }));
+	EXPECT_EQ(atlas.getGeneration(), 1u);
+
+	// Then page 0, as page 1 was just used
+	EXPECT_EQ(atlas.add(*glyph, onEvict).page, 0);
+	EXPECT_EQ(evicted, std::vector<int>({ 1, 0 }));
+
+	// Every page has been used this frame, so none can be evicted
+	EXPECT_EQ(atlas.add(*glyph, onEvict).page, 2);
+	EXPECT_EQ(atlas.getNumPages(), size_t(3));
+	EXPECT_EQ(evicted.size(), size_t(2));
+}
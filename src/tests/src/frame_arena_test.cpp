@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+using namespace Halley;
+
+TEST(HalleyFrameArena, Alignment)
+{
+	FrameArena arena(256);
+
+	arena.allocate(1, 1);
+	auto* p = arena.allocate(16, 16);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+
+	// Doesn't fit in the first block
+	auto* big = arena.allocate(1000, 8);
+	EXPECT_NE(big, nullptr);
+	EXPECT_EQ(arena.getBlockAllocations(), 2u);
+}
+
+TEST(HalleyFrameArena, SteadyStateDoesNotAllocate)
+{
+	FrameArena arena(128);
+
+	auto runFrame = [&] ()
+	{
+		arena.reset();
+		std::vector<int, FrameAllocator<int>> values{ FrameAllocator<int>(arena) };
+		for (int i = 0; i < 1000; ++i) {
+			values.push_back(i);
+		}
+		std::vector<double, FrameAllocator<double>> others(500, 1.0, FrameAllocator<double>(arena));
+		EXPECT_EQ(values[999], 999);
+	};
+
+	// The first frame grows the arena, after which it settles on a single block
+	runFrame();
+	runFrame();
+	const size_t blocks = arena.getBlockAllocations();
+	for (int i = 0; i < 10; ++i) {
+		runFrame();
+	}
+	EXPECT_EQ(arena.getBlockAllocations(), blocks);
+}
+
+TEST(HalleyFrameArena, ThreadArenaResetsEachFrame)
+{
+	FrameArena::beginFrame();
+	{
+		// Frame containers must be gone by the end of the frame
+		FrameVector<int> values(100, 1);
+		EXPECT_GT(FrameArena::getThreadArena().getBytesUsed(), 0u);
+		EXPECT_TRUE(values.get_allocator().isCurrent());
+	}
+
+	FrameArena::beginFrame();
+	EXPECT_EQ(FrameArena::getThreadArena().getBytesUsed(), 0u);
+}
+
+TEST(HalleyFrameArena, AllocatorKnowsWhenFrameIsOver)
+{
+	FrameArena arena(256);
+	const FrameAllocator<int> allocator(arena);
+	EXPECT_TRUE(allocator.isCurrent());
+	arena.reset();
+	EXPECT_FALSE(allocator.isCurrent());
+
+	FrameArena::beginFrame();
+	const FrameAllocator<int> threadAllocator;
+	EXPECT_TRUE(threadAllocator.isCurrent());
+	FrameArena::beginFrame();
+	EXPECT_FALSE(threadAllocator.isCurrent());
+}
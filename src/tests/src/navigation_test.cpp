@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+using namespace Halley;
+
+namespace {
+	ThreadPool::MakeThread makeThread()
+	{
+		return [] (String name, std::function<void()> f) { return std::thread(std::move(f)); };
+	}
+
+	NavmeshBounds makeBounds()
+	{
+		return NavmeshBounds(Vector2f(0, 0), Vector2f(400, 0), Vector2f(0, 400), 4, 4, Vector2f(1, 1));
+	}
+
+	std::vector<Polygon> makeObstacles()
+	{
+		return {
+			Polygon::makePolygon(Vector2f(80, 40), 40, 250),
+			Polygon::makePolygon(Vector2f(200, 150), 50, 250),
+			Polygon::makePolygon(Vector2f(300, 20), 30, 200)
+		};
+	}
+
+	NavmeshSet makeNavmeshSet()
+	{
+		ExecutionQueue serial;
+		auto set = NavmeshGenerator::generate(makeBounds(), makeObstacles(), {}, 0, 4.0f, serial);
+		set.linkNavmeshes();
+		return set;
+	}
+
+	std::vector<NavigationQuery> makeQueries()
+	{
+		std::vector<NavigationQuery> queries;
+		Random rng(uint32_t(1234));
+		for (int i = 0; i < 100; ++i) {
+			const auto from = Vector2f(rng.getFloat(5, 395), rng.getFloat(5, 395));
+			const auto to = Vector2f(rng.getFloat(5, 395), rng.getFloat(5, 395));
+			queries.emplace_back(from, 0, to, 0, NavigationQuery::PostProcessingType::Simple);
+		}
+		return queries;
+	}
+}
+
+TEST(HalleyNavigation, PathfindingServiceMatchesDirectQueries)
+{
+	const auto navmeshSet = makeNavmeshSet();
+	const auto queries = makeQueries();
+
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 4, makeThread());
+	PathfindingService service(navmeshSet, queue, 7);
+	auto futures = service.pathfind(Vector<NavigationQuery>(queries.begin(), queries.end()));
+	ASSERT_EQ(futures.size(), queries.size());
+
+	size_t found = 0;
+	for (size_t i = 0; i < queries.size(); ++i) {
+		const auto expected = navmeshSet.pathfind(queries[i]);
+		const auto result = futures[i].get();
+		ASSERT_EQ(result.has_value(), expected.has_value());
+		if (expected) {
+			EXPECT_EQ(result.value(), expected.value());
+			++found;
+		}
+	}
+	EXPECT_GT(found, size_t(0));
+}
+
+TEST(HalleyNavigation, GenerateWithoutExecutorsMatchesParallel)
+{
+	ASSERT_FALSE(Executors::hasInstance());
+	const auto obstacles = makeObstacles();
+	const auto serial = NavmeshGenerator::generate(makeBounds(), obstacles, {}, 0, 4.0f);
+
+	ExecutionQueue queue;
+	ThreadPool pool("test", queue, 4, makeThread());
+	const auto parallel = NavmeshGenerator::generate(makeBounds(), obstacles, {}, 0, 4.0f, queue);
+
+	ASSERT_EQ(serial.getNavmeshes().size(), parallel.getNavmeshes().size());
+	for (size_t i = 0; i < serial.getNavmeshes().size(); ++i) {
+		EXPECT_EQ(serial.getNavmeshes()[i].getPolygons().size(), parallel.getNavmeshes()[i].getPolygons().size());
+	}
+}
+
+TEST(HalleyNavigation, UpdateChunksRebuildsOnlyChanges)
+{
+	auto makeChunk = [] (int x)
+	{
+		NavmeshGenerator::ChunkInput chunk(Vector2i(x, 0), Vector2f(400.0f * x, 0), makeBounds(), 0, 4.0f);
+		chunk.obstacles = makeObstacles();
+		return chunk;
+	};
+	auto countAt = [] (const NavmeshSet& set, Vector2i gridPos)
+	{
+		const auto navmeshes = set.getNavmeshes();
+		return std::count_if(navmeshes.begin(), navmeshes.end(), [&] (const Navmesh& nav) { return nav.getWorldGridPos() == gridPos; });
+	};
+
+	std::vector<NavmeshGenerator::ChunkInput> chunks = { makeChunk(0), makeChunk(1), makeChunk(2) };
+	ExecutionQueue serial;
+	NavmeshSet world;
+	NavmeshGenerator::ChunkCache cache;
+	EXPECT_EQ(NavmeshGenerator::updateChunks(world, chunks, cache, serial), size_t(3));
+	EXPECT_EQ(NavmeshGenerator::updateChunks(world, chunks, cache, serial), size_t(0));
+
+	const auto version = world.getConnectivityVersion();
+	chunks[1].obstacles.pop_back();
+	EXPECT_EQ(NavmeshGenerator::updateChunks(world, chunks, cache, serial), size_t(1));
+	EXPECT_NE(world.getConnectivityVersion(), version);
+
+	// Chunks left out of the update are removed from the world, and regenerated when they come back
+	chunks.pop_back();
+	EXPECT_EQ(NavmeshGenerator::updateChunks(world, chunks, cache, serial), size_t(1));
+	EXPECT_EQ(countAt(world, Vector2i(2, 0)), 0);
+
+	chunks.push_back(makeChunk(2));
+	EXPECT_EQ(NavmeshGenerator::updateChunks(world, chunks, cache, serial), size_t(1));
+	EXPECT_GT(countAt(world, Vector2i(2, 0)), 0);
+
+	// Same as building it from scratch
+	NavmeshSet fresh;
+	NavmeshGenerator::ChunkCache freshCache;
+	NavmeshGenerator::updateChunks(fresh, chunks, freshCache, serial);
+	for (int x = 0; x < 3; ++x) {
+		EXPECT_EQ(countAt(world, Vector2i(x, 0)), countAt(fresh, Vector2i(x, 0)));
+	}
+}
+
+TEST(HalleyNavigation, FlowFieldReachesWhatPathfindingReaches)
+{
+	const auto navmeshSet = makeNavmeshSet();
+	const auto queries = makeQueries();
+	const auto destination = queries[0].to;
+	const NavigationFlowField field(navmeshSet, destination, 0);
+
+	size_t reachable = 0;
+	for (const auto& q: queries) {
+		const auto path = navmeshSet.pathfind(NavigationQuery(q.from, 0, destination, 0, NavigationQuery::PostProcessingType::Simple));
+		const auto distance = field.getDistance(q.from, 0);
+		EXPECT_EQ(path.has_value(), distance.has_value());
+		EXPECT_EQ(path.has_value(), field.sample(q.from, 0).has_value());
+		if (distance) {
+			EXPECT_GE(*distance + 0.01f, (destination - q.from).length());
+			++reachable;
+		}
+	}
+	EXPECT_GT(reachable, size_t(0));
+}
+
+TEST(HalleyNavigation, FlowFieldSamplesConcurrently)
+{
+	const auto navmeshSet = makeNavmeshSet();
+	const auto queries = makeQueries();
+	const auto destination = queries[0].to;
+
+	const NavigationFlowField serialField(navmeshSet, destination, 0);
+	std::vector<std::optional<Vector2f>> expected;
+	for (const auto& q: queries) {
+		expected.push_back(serialField.sample(q.from, 0, 5.0f));
+	}
+
+	// Every thread builds regions the others might be reading
+	const NavigationFlowField sharedField(navmeshSet, destination, 0);
+	std::vector<std::vector<std::optional<Vector2f>>> results(4);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < results.size(); ++t) {
+		threads.emplace_back([&, t] ()
+		{
+			for (size_t i = 0; i < queries.size(); ++i) {
+				const auto& q = queries[(i + t * 25) % queries.size()];
+				results[t].push_back(sharedField.sample(q.from, 0, 5.0f));
+			}
+		});
+	}
+	for (auto& thread: threads) {
+		thread.join();
+	}
+
+	for (size_t t = 0; t < results.size(); ++t) {
+		for (size_t i = 0; i < queries.size(); ++i) {
+			EXPECT_EQ(results[t][i], expected[(i + t * 25) % queries.size()]);
+		}
+	}
+}
+
+TEST(HalleyNavigation, FlowFieldFollowsAssignedSet)
+{
+	auto navmeshSet = makeNavmeshSet();
+	const auto destination = Vector2f(10, 10);
+	const NavigationFlowField field(navmeshSet, destination, 0);
+	const auto from = Vector2f(390, 390);
+	ASSERT_TRUE(field.getDistance(from, 0).has_value());
+
+	// Same history as the first one, so the same version, but with the destination blocked off
+	ExecutionQueue serial;
+	const std::vector<Polygon> obstacles = { Polygon::makePolygon(Vector2f(0, 0), 100, 100) };
+	auto other = NavmeshGenerator::generate(makeBounds(), obstacles, {}, 0, 4.0f, serial);
+	other.linkNavmeshes();
+	ASSERT_EQ(other.getConnectivityVersion(), navmeshSet.getConnectivityVersion());
+
+	const auto version = navmeshSet.getConnectivityVersion();
+	navmeshSet = other;
+	EXPECT_NE(navmeshSet.getConnectivityVersion(), version);
+	EXPECT_FALSE(field.getDistance(from, 0).has_value());
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include "dummy/dummy_video.h"
+#include <numeric>
+using namespace Halley;
+
+namespace {
+	std::shared_ptr<MaterialDefinition> makeDefinition(const std::string& yaml)
+	{
+		const auto config = YAMLConvert::parseConfig(gsl::as_bytes(gsl::span<const char>(yaml.data(), yaml.size())));
+		auto definition = std::make_shared<MaterialDefinition>();
+		definition->load(config.getRoot());
+		return definition;
+	}
+
+	std::shared_ptr<MaterialDefinition> makeDefinition(const String& name)
+	{
+		return makeDefinition(R"(
+name: )" + name.cppStr() + R"(
+attributes:
+  - name: a_tag
+    type: vec4
+    semantic: POSITION
+textures:
+  - name: tex0
+)");
+	}
+
+	std::shared_ptr<MaterialDefinition> makeBaseDefinition()
+	{
+		// Same uniforms as Halley/MaterialBase, which the painter sets on bind
+		return makeDefinition(std::string(R"(
+name: Halley/MaterialBase
+uniforms:
+  - HalleyBlock:
+    - u_mvp: mat4
+    - u_viewPortSize: vec2
+)"));
+	}
+
+	// Records what reaches the backend, one entry per batch
+	class RecordingPainter final : public DummyPainter {
+	public:
+		struct Batch {
+			const MaterialDefinition* definition;
+			Vector<int> draws; // Tags of the quads in it, in order
+		};
+		Vector<Batch> batches;
+
+		using DummyPainter::DummyPainter;
+
+		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly) override
+		{
+			auto& batch = batches.emplace_back(Batch{ &material, {} });
+			const auto* vertices = static_cast<const Vector4f*>(vertexData);
+			for (size_t i = 0; i < numVertices; i += 4) {
+				batch.draws.push_back(int(vertices[i].x));
+			}
+		}
+	};
+
+	class PainterTest : public ::testing::Test {
+	protected:
+		HalleyAPI api{};
+		DummyVideoAPI video;
+		std::unique_ptr<Resources> resources;
+		std::shared_ptr<MaterialDefinition> defA;
+		std::shared_ptr<MaterialDefinition> defB;
+		std::shared_ptr<Texture> tex1;
+		std::shared_ptr<Texture> tex2;
+		std::unique_ptr<ScreenRenderTarget> renderTarget;
+		Camera camera;
+
+		void SetUp() override
+		{
+			resources = std::make_unique<Resources>(nullptr, api, Resources::Options());
+			resources->init<MaterialDefinition>();
+			defA = makeDefinition(String("A"));
+			defB = makeDefinition(String("B"));
+			resources->of<MaterialDefinition>().setResource(0, "Halley/MaterialBase", makeBaseDefinition());
+			resources->of<MaterialDefinition>().setResource(0, "Halley/SolidLine", defA);
+			resources->of<MaterialDefinition>().setResource(0, "Halley/SolidPolygon", defA);
+			renderTarget = std::make_unique<ScreenRenderTarget>(Rect4i(0, 0, 64, 64));
+			tex1 = video.createTexture(Vector2i(1, 1));
+			tex2 = video.createTexture(Vector2i(1, 1));
+		}
+
+		std::shared_ptr<Material> makeMaterial(const std::shared_ptr<MaterialDefinition>& definition, const std::shared_ptr<Texture>& texture)
+		{
+			auto material = std::make_shared<Material>(definition);
+			material->set("tex0", texture);
+			return material;
+		}
+
+		static void drawTagged(Painter& painter, const std::shared_ptr<Material>& material, int tag)
+		{
+			std::array<Vector4f, 4> vertices;
+			vertices.fill(Vector4f(float(tag), 0, 0, 0));
+			painter.drawQuads(material, vertices.size(), vertices.data());
+		}
+	};
+}
+
+TEST_F(PainterTest, DeferredDrawsAreGroupedByMaterial)
+{
+	RecordingPainter painter(*resources);
+	const auto a1 = makeMaterial(defA, tex1);
+	const auto a2 = makeMaterial(defA, tex2);
+	const auto b1 = makeMaterial(defB, tex1);
+
+	RenderContext(painter, camera, *renderTarget).bind([&] (Painter& painter)
+	{
+		painter.setDeferred(true);
+		const std::array<std::shared_ptr<Material>, 8> recorded = { a1, b1, a2, a1, b1, a2, a1, b1 };
+		for (size_t i = 0; i < recorded.size(); ++i) {
+			drawTagged(painter, recorded[i], int(i));
+		}
+
+		// Sorted within the layer, but never mixed with the one before
+		painter.setDeferredLayer(1);
+		drawTagged(painter, b1, 100);
+		drawTagged(painter, a1, 101);
+	});
+	EXPECT_EQ(painter.getNumDeferredDraws(), size_t(10));
+
+	// Three batches for layer 0, with definitions in creation order and each batch's draws in recorded order
+	ASSERT_EQ(painter.batches.size(), size_t(5));
+	EXPECT_EQ(painter.batches[0].definition, defA.get());
+	EXPECT_EQ(painter.batches[1].definition, defA.get());
+	EXPECT_EQ(painter.batches[2].definition, defB.get());
+
+	const Vector<int> a1Draws = { 0, 3, 6 };
+	const Vector<int> a2Draws = { 2, 5 };
+	EXPECT_TRUE((painter.batches[0].draws == a1Draws && painter.batches[1].draws == a2Draws) || (painter.batches[0].draws == a2Draws && painter.batches[1].draws == a1Draws));
+	EXPECT_EQ(painter.batches[2].draws, Vector<int>({ 1, 4, 7 }));
+
+	EXPECT_EQ(painter.batches[3].draws, Vector<int>({ 101 }));
+	EXPECT_EQ(painter.batches[4].draws, Vector<int>({ 100 }));
+
+	// In recorded order, only the two b1 draws across the layer change would have merged
+	EXPECT_EQ(painter.getNumDrawCallsSaved(), size_t(9 - 5));
+}
+
+TEST_F(PainterTest, DefinitionIdsAreUnique)
+{
+	EXPECT_NE(defA->getId(), defB->getId());
+	EXPECT_LT(defA->getId(), defB->getId());
+
+	// Reloading keeps the id
+	const auto id = defA->getId();
+	defA->reload(std::move(*makeDefinition(String("A2"))));
+	EXPECT_EQ(defA->getId(), id);
+}
+
+TEST_F(PainterTest, SpritePainterSortsLikeComparisonSort)
+{
+	struct Entry {
+		int layer;
+		float tieBreaker;
+	};
+
+	// Few distinct keys, so most entries are only ordered by when they were added
+	Random rng(uint32_t(42));
+	const std::array<float, 5> tieBreakers = { -1.5f, -0.0f, 0.0f, 0.5f, 1e9f };
+	Vector<Entry> entries;
+	for (int i = 0; i < 2000; ++i) {
+		entries.push_back(Entry{ rng.getInt(-3, 3), tieBreakers[rng.getSizeT(0, tieBreakers.size() - 1)] });
+	}
+	entries.push_back(Entry{ std::numeric_limits<int>::min(), 0.0f });
+	entries.push_back(Entry{ std::numeric_limits<int>::max(), -1e9f });
+
+	SpritePainter spritePainter;
+	spritePainter.start();
+	Vector<int> drawn;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		spritePainter.add([&drawn, i] (Painter&) { drawn.push_back(int(i)); }, 1, entries[i].layer, entries[i].tieBreaker);
+	}
+
+	// Without a material it gets culled, but still goes through building vertices, which has no Executors to run on here
+	spritePainter.addCopy(Sprite(), 1, 0, 0.0f);
+
+	RecordingPainter painter(*resources);
+	RenderContext(painter, camera, *renderTarget).bind([&] (Painter& painter)
+	{
+		spritePainter.draw(1, painter);
+	});
+
+	Vector<int> expected(entries.size());
+	std::iota(expected.begin(), expected.end(), 0);
+	std::sort(expected.begin(), expected.end(), [&] (int a, int b)
+	{
+		const auto& ea = entries[a];
+		const auto& eb = entries[b];
+		if (ea.layer != eb.layer) {
+			return ea.layer < eb.layer;
+		} else if (ea.tieBreaker != eb.tieBreaker) {
+			return ea.tieBreaker < eb.tieBreaker;
+		} else {
+			return a < b;
+		}
+	});
+	EXPECT_EQ(drawn, expected);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+#include "dummy/dummy_system.h"
+#include "resources/asset_database.h"
+using namespace Halley;
+
+namespace {
+	// Serves text assets from memory
+	class MemoryProvider final : public IResourceLocatorProvider {
+	public:
+		HashMap<String, std::string> contents;
+
+		void addText(const String& name, std::string text)
+		{
+			db.addAsset(name, AssetType::TextFile, AssetDatabase::Entry(name, Metadata()));
+			contents[name] = std::move(text);
+		}
+
+		std::unique_ptr<ResourceData> getData(const String& path, AssetType type, bool stream) override
+		{
+			const auto& text = contents.at(path);
+			return std::make_unique<ResourceDataStatic>(text.data(), text.size(), path, false);
+		}
+
+		const AssetDatabase& getAssetDatabase() override { return db; }
+		void purge(SystemAPI& system) override {}
+
+	private:
+		AssetDatabase db;
+	};
+
+	class ResourcesTest : public ::testing::Test {
+	protected:
+		DummySystemAPI system;
+		HalleyAPI api{};
+		std::unique_ptr<Resources> resources;
+
+		void SetUp() override
+		{
+			auto provider = std::make_unique<MemoryProvider>();
+			for (const auto* name: { "a", "b", "c" }) {
+				provider->addText(name, std::string(100, name[0]));
+			}
+			auto locator = std::make_unique<ResourceLocator>(system);
+			locator->addProvider(std::move(provider), "memory");
+
+			resources = std::make_unique<Resources>(std::move(locator), api, Resources::Options());
+			resources->init<TextFile>();
+		}
+
+		ResourceCollectionStats getStats() const
+		{
+			return resources->ofType(AssetType::TextFile).getStats();
+		}
+	};
+}
+
+TEST_F(ResourcesTest, EvictsLeastRecentlyUsed)
+{
+	resources->setMemoryBudget<TextFile>(250);
+	resources->get<TextFile>("a");
+	resources->get<TextFile>("b");
+	resources->get<TextFile>("a");
+	EXPECT_EQ(getStats().residentBytes, size_t(200));
+
+	// b is the oldest now
+	resources->get<TextFile>("c");
+	EXPECT_EQ(getStats().residentBytes, size_t(200));
+	EXPECT_EQ(getStats().evictions, uint64_t(1));
+
+	const auto misses = getStats().misses;
+	resources->get<TextFile>("a");
+	resources->get<TextFile>("c");
+	EXPECT_EQ(getStats().misses, misses);
+
+	// Transparently reloaded
+	EXPECT_EQ(resources->get<TextFile>("b")->getData(), String(std::string(100, 'b')));
+	EXPECT_EQ(getStats().misses, misses + 1);
+}
+
+TEST_F(ResourcesTest, KeepsResourcesInUse)
+{
+	resources->setMemoryBudget<TextFile>(100);
+	const auto a = resources->get<TextFile>("a");
+	const auto b = resources->get<TextFile>("b");
+	EXPECT_EQ(getStats().residentBytes, size_t(200));
+	EXPECT_EQ(getStats().evictions, uint64_t(0));
+
+	// Still in use while it's being loaded
+	resources->get<TextFile>("c");
+	EXPECT_EQ(getStats().residentBytes, size_t(300));
+	EXPECT_EQ(getStats().evictions, uint64_t(0));
+
+	// Only what nobody else holds on to goes
+	EXPECT_EQ(resources->trimMemory(size_t(0)), size_t(100));
+	EXPECT_EQ(getStats().residentBytes, size_t(200));
+}
+
+TEST_F(ResourcesTest, TotalBudget)
+{
+	resources->setTotalMemoryBudget(250);
+	resources->get<TextFile>("a");
+	resources->get<TextFile>("b");
+	resources->get<TextFile>("c");
+	EXPECT_EQ(resources->getResidentBytes(), size_t(200));
+	EXPECT_EQ(getStats().evictions, uint64_t(1));
+
+	// Without a budget, trimming evicts everything unused
+	resources->setTotalMemoryBudget({});
+	EXPECT_EQ(resources->trimMemory(), size_t(200));
+	EXPECT_EQ(resources->getResidentBytes(), size_t(0));
+}
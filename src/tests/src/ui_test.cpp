@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <halley.hpp>
+using namespace Halley;
+
+namespace {
+	class CountingWidget final : public UIWidget {
+	public:
+		int updates = 0;
+		int layouts = 0;
+
+		using UIWidget::UIWidget;
+
+	protected:
+		void update(Time t, bool moved) override
+		{
+			++updates;
+		}
+
+		void onLayout() override
+		{
+			++layouts;
+		}
+	};
+
+	void runFrame(UIWidget& widget)
+	{
+		widget.doUpdate(UIWidgetUpdateType::Full, 0.016, UIInputType::Mouse, JoystickType::Generic);
+		widget.layout();
+	}
+}
+
+TEST(HalleyUI, StaticPanelOnlyUpdatesWhenAsked)
+{
+	auto panel = std::make_shared<UIWidget>("panel", Vector2f(100, 100), UISizer(UISizerType::Vertical));
+	auto child = std::make_shared<CountingWidget>("child", Vector2f(10, 10));
+	panel->add(child);
+	panel->setStatic(true);
+	runFrame(*panel);
+	runFrame(*panel);
+
+	// Nothing changed, so neither the panel nor anything inside it updates
+	const int updates = child->updates;
+	for (int i = 0; i < 5; ++i) {
+		runFrame(*panel);
+	}
+	EXPECT_EQ(child->updates, updates);
+
+	// An event bubbling up to a handler in the panel
+	bool clicked = false;
+	panel->setHandle(UIEventType::ButtonClicked, [&] (const UIEvent&) { clicked = true; });
+	child->sendEvent(UIEvent(UIEventType::ButtonClicked, "child"));
+	runFrame(*panel);
+	EXPECT_TRUE(clicked);
+	EXPECT_EQ(child->updates, updates + 1);
+	runFrame(*panel);
+	EXPECT_EQ(child->updates, updates + 1);
+
+	// A layout change inside it, then once more to see where it was moved to
+	child->setMinSize(Vector2f(20, 20));
+	runFrame(*panel);
+	EXPECT_EQ(child->updates, updates + 2);
+	runFrame(*panel);
+	EXPECT_EQ(child->updates, updates + 3);
+	runFrame(*panel);
+	EXPECT_EQ(child->updates, updates + 3);
+}
+
+TEST(HalleyUI, UnchangedSubtreeKeepsItsLayout)
+{
+	auto panel = std::make_shared<UIWidget>("panel", Vector2f(100, 100), UISizer(UISizerType::Vertical));
+	auto top = std::make_shared<UIWidget>("top", Vector2f(10, 10));
+	auto bottom = std::make_shared<UIWidget>("bottom", Vector2f(10, 10));
+	auto topContents = std::make_shared<CountingWidget>("topContents", Vector2f(5, 5));
+	auto bottomContents = std::make_shared<CountingWidget>("bottomContents", Vector2f(5, 5));
+	panel->add(top);
+	panel->add(bottom);
+	top->addChild(topContents);
+	bottom->addChild(bottomContents);
+	runFrame(*panel);
+	runFrame(*panel);
+
+	const auto topRect = top->getRect();
+	const auto topContentsRect = topContents->getRect();
+	const int topLayouts = topContents->layouts;
+	const int bottomLayouts = bottomContents->layouts;
+
+	// Nothing changed
+	panel->layout();
+	EXPECT_EQ(topContents->layouts, topLayouts);
+	EXPECT_EQ(bottomContents->layouts, bottomLayouts);
+
+	// Growing the bottom one moves nothing above it
+	bottom->setMinSize(Vector2f(10, 30));
+	panel->layout();
+	EXPECT_EQ(top->getRect(), topRect);
+	EXPECT_EQ(topContents->getRect(), topContentsRect);
+	EXPECT_EQ(topContents->layouts, topLayouts);
+	EXPECT_EQ(bottomContents->layouts, bottomLayouts + 1);
+}
+
+TEST(HalleyUI, SizerEntrySettersMarkLayout)
+{
+	auto panel = std::make_shared<UIWidget>("panel", Vector2f(100, 100), UISizer(UISizerType::Vertical));
+	panel->add(std::make_shared<UIWidget>("child", Vector2f(10, 10)));
+	runFrame(*panel);
+	ASSERT_FALSE(panel->needsLayout());
+
+	// Just looking at an entry, or setting what it already has, changes nothing
+	auto& entry = panel->getSizer()[0];
+	entry.setBorder(entry.getBorder());
+	EXPECT_FALSE(panel->needsLayout());
+
+	entry.setBorder(Vector4f(1, 2, 3, 4));
+	EXPECT_TRUE(panel->needsLayout());
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "font_face.h"
+#include <halley/core/graphics/text/font_atlas.h>
+#include <halley/utils/utils.h>
+
+namespace Halley
+{
+	// Rasterizes glyphs for Font::makeDynamic the same way FontGenerator bakes them, one at a time
+	class FontFaceGlyphRasterizer : public GlyphRasterizer
+	{
+	public:
+		// sizePoints is the size of the resulting font, glyphs are rendered at superSample times that and then downsampled into a distance field
+		FontFaceGlyphRasterizer(Bytes fontFile, float sizePoints, float radius, int superSample = 8);
+
+		Metrics getMetrics() const override;
+		bool hasGlyph(int charcode) const override;
+		Glyph rasterize(int charcode) override;
+
+	private:
+		Bytes fontFile; // FreeType reads from it for as long as the face exists
+		std::unique_ptr<FontFace> face;
+		Vector<int> charCodes;
+		float radius;
+		int superSample;
+	};
+}
@@ -24,15 +24,16 @@ namespace Halley {
 			int assetType;
 			uint64_t hash;
 			String key;
+			size_t pos;
+			size_t size;
 			AssetDatabase::Entry entry;
 
-			Entry(int assetType, uint64_t hash, String key, AssetDatabase::Entry entry);
+			Entry(int assetType, uint64_t hash, String key, size_t pos, size_t size, AssetDatabase::Entry entry);
 		};
 		std::vector<Entry> entries;
 		std::vector<int> sortedEntries;
 
 		void parseTable(Deserializer s, const Bytes& packBytes);
-	    void parseTypedDB(Deserializer& s, const Bytes& packBytes);
 		void computeHash();
     };
 
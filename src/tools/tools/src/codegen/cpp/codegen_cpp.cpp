@@ -609,11 +609,49 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system, const Hash
 			}, "canHandleSystemMessage", true, false, true, true), canReceiveBody);
 	}
 
+	// Dependencies, so the world can schedule non-conflicting systems in parallel
+	Vector<String> componentsRead;
+	Vector<String> componentsWritten;
+	for (auto& fam : system.families) {
+		for (auto& comp : fam.components) {
+			const String index = comp.name + "Component::componentIndex";
+			if (comp.write) {
+				componentsRead.erase(std::remove(componentsRead.begin(), componentsRead.end(), index), componentsRead.end());
+				if (std::find(componentsWritten.begin(), componentsWritten.end(), index) == componentsWritten.end()) {
+					componentsWritten.push_back(index);
+				}
+			} else if (std::find(componentsWritten.begin(), componentsWritten.end(), index) == componentsWritten.end() && std::find(componentsRead.begin(), componentsRead.end(), index) == componentsRead.end()) {
+				componentsRead.push_back(index);
+			}
+		}
+	}
+	auto services = convert<ServiceSchema, String>(system.services, [](auto& service) { return "\"" + service.name + "\""; });
+	Vector<String> dependencyFlags;
+	if ((int(system.access) & int(SystemAccess::API)) != 0) {
+		dependencyFlags.push_back("API");
+	}
+	if ((int(system.access) & int(SystemAccess::World)) != 0) {
+		dependencyFlags.push_back("World");
+	}
+	if ((int(system.access) & int(SystemAccess::Resources)) != 0) {
+		dependencyFlags.push_back("Resources");
+	}
+	if (!system.messages.empty() || !system.systemMessages.empty()) {
+		dependencyFlags.push_back("Messages");
+	}
+	if (dependencyFlags.empty()) {
+		dependencyFlags.push_back("None");
+	}
+	const auto dependencyFlagsExpr = String::concatList(convert<String, String>(dependencyFlags, [](auto& flag) { return "int(Halley::SystemDependencyFlags::" + flag + ")"; }), " | ");
+
 	sysClassGen
 		.setAccessLevel(MemberAccess::Public)
 		.addCustomConstructor({}, {
 			VariableSchema(TypeSchema(""), "System", "{" + String::concatList(convert<FamilySchema, String>(system.families, [](auto& fam) { return "&" + fam.name + "Family"; }), ", ") + "}, {" + String::concatList(entityMsgsReceived, ", ") + "}")
-		}, { "static_assert(std::is_final_v<T>, \"System must be final.\");" })
+		}, {
+			"static_assert(std::is_final_v<T>, \"System must be final.\");",
+			"declareDependencies({" + String::concatList(componentsRead, ", ") + "}, {" + String::concatList(componentsWritten, ", ") + "}, {" + String::concatList(services, ", ") + "}, " + dependencyFlagsExpr + ");"
+		})
 		.finish()
 		.writeTo(contents);
 
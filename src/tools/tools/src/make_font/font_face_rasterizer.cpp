@@ -0,0 +1,63 @@
+#include "halley/tools/make_font/font_face_rasterizer.h"
+#include "halley/tools/distance_field/distance_field_generator.h"
+#include <halley/file_formats/image.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace Halley;
+
+FontFaceGlyphRasterizer::FontFaceGlyphRasterizer(Bytes bytes, float sizePoints, float radius, int superSample)
+	: fontFile(std::move(bytes))
+	, radius(radius)
+	, superSample(superSample)
+{
+	face = std::make_unique<FontFace>(gsl::as_bytes(gsl::span<const Byte>(fontFile)));
+	face->setSize(sizePoints * superSample);
+
+	// Sorted, so hasGlyph doesn't need to touch FreeType, which isn't thread-safe
+	charCodes = face->getCharCodes();
+	std::sort(charCodes.begin(), charCodes.end());
+}
+
+GlyphRasterizer::Metrics FontFaceGlyphRasterizer::getMetrics() const
+{
+	const float scale = 1.0f / superSample;
+
+	Metrics result;
+	result.ascender = float(lround(face->getAscender() * scale));
+	result.height = float(lround(face->getHeight() * scale));
+	result.sizePoints = float(lround(face->getSize() * scale));
+	result.smoothRadius = radius;
+	return result;
+}
+
+bool FontFaceGlyphRasterizer::hasGlyph(int charcode) const
+{
+	return std::binary_search(charCodes.begin(), charCodes.end(), charcode);
+}
+
+GlyphRasterizer::Glyph FontFaceGlyphRasterizer::rasterize(int charcode)
+{
+	// Same layout as FontGenerator, see generateFont and generateFontMapBinary
+	const float scale = 1.0f / superSample;
+	const float borderSuperSample = std::ceil(radius) * superSample;
+
+	const Vector2i glyphSize = face->getGlyphSize(charcode);
+	const int padding = int(2 * borderSuperSample);
+	const Vector2i superSampleSize = glyphSize + Vector2i(padding, padding);
+	const Vector2i finalSize(Vector2f(superSampleSize) * scale + Vector2f(1, 1));
+
+	auto tmpImg = std::make_unique<Image>(Image::Format::RGBA, finalSize * superSample);
+	tmpImg->clear(0);
+	face->drawGlyph(*tmpImg, charcode, Vector2i(lround(borderSuperSample), lround(borderSuperSample)));
+
+	const auto metrics = face->getMetrics(charcode, scale);
+	const int finalPadding = lround(radius);
+
+	Glyph result;
+	result.image = DistanceFieldGenerator::generate(*tmpImg, finalSize, radius);
+	result.horizontalBearing = metrics.bearingHorizontal + Vector2f(float(-finalPadding), float(finalPadding));
+	result.verticalBearing = metrics.bearingVertical + Vector2f(float(-finalPadding), float(finalPadding));
+	result.advance = metrics.advance;
+	return result;
+}
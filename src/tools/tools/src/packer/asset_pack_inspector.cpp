@@ -7,6 +7,7 @@
 #include "halley/support/console.h"
 #include "halley/core/resources/asset_database.h"
 #include "halley/utils/hash.h"
+#include "halley/resources/resource.h"
 
 using namespace Halley;
 
@@ -48,35 +49,31 @@ void AssetPackInspector::parse(const Bytes& bytes)
 
 void AssetPackInspector::parseTable(Deserializer s, const Bytes& packBytes)
 {
-	unsigned int numTypedDbs;
-	s >> numTypedDbs;
+	AssetDatabase db;
+	s >> db;
 
-	for (unsigned int i = 0; i < numTypedDbs; ++i) {
-		parseTypedDB(s, packBytes);
-	}
-}
-
-void AssetPackInspector::parseTypedDB(Deserializer& s, const Bytes& packBytes)
-{
-	int curAssetType;
-	s >> curAssetType;
-
-	unsigned int numEntries;
-	s >> numEntries;
-
-	entries.reserve(entries.size() + numEntries);
-
-	for (unsigned int i = 0; i < numEntries; ++i) {
-		String key;
-		AssetDatabase::Entry entry;
-		s >> key >> entry;
+	for (auto typeName: EnumNames<AssetType>()()) {
+		const auto type = fromString<AssetType>(typeName);
+		if (!db.hasDatabase(type)) {
+			continue;
+		}
 
-		auto splitPath = entry.path.split(':');
-		size_t pos = splitPath.at(0).toInteger64();
-		size_t size = splitPath.at(1).toInteger64();
-		auto hash = Hash::hash(gsl::as_bytes(gsl::span<const Byte>(packBytes.data() + pos + dataStartPos, size)));
+		for (auto& [key, entry]: db.getDatabase(type).getAssets()) {
+			size_t pos;
+			size_t size;
+			if (const auto* packEntry = db.findPackEntry(AssetDatabase::getKey(type, key))) {
+				pos = size_t(packEntry->pos);
+				size = size_t(packEntry->size);
+			} else {
+				// Packs built before the index existed
+				auto ps = entry.path.split(':');
+				pos = size_t(ps.at(0).toInteger());
+				size = size_t(ps.at(1).toInteger());
+			}
+			auto hash = Hash::hash(gsl::as_bytes(gsl::span<const Byte>(packBytes.data() + pos + dataStartPos, size)));
 
-		entries.emplace_back(curAssetType, hash, std::move(key), std::move(entry));
+			entries.emplace_back(int(type), hash, key, pos, size, entry);
+		}
 	}
 }
 
@@ -110,8 +107,7 @@ void AssetPackInspector::printData() const
 			std::cout << "  Assets of type " << infoCol << lastType << stdCol << ":\n";
 		}
 
-		auto splitPath = entry.entry.path.split(':');
-		std::cout << "    [" << i << "] " << strCol << entry.key << stdCol << " [" << infoCol << toString(entry.hash, 16) << stdCol << "]: at " << infoCol << splitPath.at(0) << stdCol << ", " << infoCol << splitPath.at(1) << stdCol << " bytes, " << strCol << toString(entry.entry.meta) <<  stdCol << "\n";
+		std::cout << "    [" << i << "] " << strCol << entry.key << stdCol << " [" << infoCol << toString(entry.hash, 16) << stdCol << "]: at " << infoCol << entry.pos << stdCol << ", " << infoCol << entry.size << stdCol << " bytes, " << strCol << toString(entry.entry.meta) <<  stdCol << "\n";
 
 		++i;
 	}
@@ -121,10 +117,12 @@ void AssetPackInspector::printData() const
 	std::cout << std::endl;
 }
 
-AssetPackInspector::Entry::Entry(int assetType, uint64_t hash, String key, AssetDatabase::Entry entry)
+AssetPackInspector::Entry::Entry(int assetType, uint64_t hash, String key, size_t pos, size_t size, AssetDatabase::Entry entry)
 	: assetType(assetType)
 	, hash(hash)
 	, key(std::move(key))
+	, pos(pos)
+	, size(size)
 	, entry(std::move(entry))
 {
 }
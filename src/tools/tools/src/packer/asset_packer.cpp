@@ -186,7 +186,7 @@ void AssetPacker::generatePack(const String& packId, const AssetPackListing& pac
 		data.resize(pos + size);
 		memcpy(data.data() + pos, fileData.data(), size);
 
-		db.addAsset(entry.name, entry.type, AssetDatabase::Entry(toString(pos) + ":" + toString(size), entry.metadata));
+		db.addPackedAsset(entry.name, entry.type, pos, size, entry.metadata);
 	}
 
 	if (!packListing.getEncryptionKey().isEmpty()) {